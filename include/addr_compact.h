@@ -0,0 +1,127 @@
+#ifndef HEADER_ADDR_COMPACT_H
+#define HEADER_ADDR_COMPACT_H
+
+#include <stddef.h>
+#include <net/xia.h>
+
+/* Compact encoding of XIA addresses
+ *
+ * An encoded address only has the rows before its first XIDTYPE_NAT row:
+ *	__u8	number of rows, up to XIA_NODES_MAX.
+ *	For each row:
+ *	varint	principal type in host order, 7 bits per byte, least
+ *		significant first, and the high bit set on all bytes but
+ *		the last one.
+ *	__u8	ID[XIA_XID_MAX].
+ *	__u8	edge descriptor:
+ *		bits 0-2: number k of edges kept; the edges after them are
+ *			XIA_EMPTY_EDGE, and not chosen.
+ *		bit 3: a byte with the chosen bits of the k edges follows,
+ *			bit i for edge i.
+ *		bit 4: the k edges are kept as bytes; otherwise they are
+ *			kept as nibbles, the first edge in the low nibble,
+ *			and 15 stands for XIA_EMPTY_EDGE.
+ *		bits 5-7: zero.
+ *	The chosen byte and the k edges, without their chosen bits.
+ *
+ * A typical row of a valid address takes 23 bytes instead of 28, and
+ * the unused rows take nothing, so addresses of 2-3 rows shrink 3-5 times.
+ * The encoding is the same on all machines.
+ */
+
+/* Bytes that the encoding of any address fits in. */
+#define XIA_COMPACT_ADDR_MAX	(1 + XIA_NODES_MAX * \
+	(5 + XIA_XID_MAX + 2 + XIA_OUTDEGREE_MAX))
+
+/* xia_addr_encode - encode @addr into @dst.
+ *
+ * RETURN
+ *	Number of bytes written on success; -ENOSPC if @dstlen is too small.
+ */
+int xia_addr_encode(const struct xia_addr *addr, __u8 *dst, size_t dstlen);
+
+/* xia_addr_decode - decode the address at @src into @addr.
+ *
+ * RETURN
+ *	Number of bytes read on success. Otherwise, -EAGAIN if @src ends
+ *	before the address does, and -EINVAL if @src is not a valid encoding.
+ *
+ * NOTES
+ *	The rows of @addr after the rows of the address are zeroed.
+ *	@addr is undefined if the function fails.
+ *	Decoding does not test the address; see xia_test_addr.
+ */
+int xia_addr_decode(const __u8 *src, size_t srclen, struct xia_addr *addr);
+
+/*
+ * Streams
+ *
+ * Files of compact addresses start with a header that identifies them,
+ * followed by encoded addresses back to back. Streams buffer their I/O,
+ * so they take and return many addresses per system call.
+ */
+
+struct xia_addr_writer;
+struct xia_addr_reader;
+
+/* xia_addr_writer_open - start a file of compact addresses on @fd.
+ *
+ * RETURN
+ *	The new writer, or NULL if there is not enough memory.
+ *
+ * NOTES
+ *	The header is written with the first flush. @fd is not closed by
+ *	xia_addr_writer_close.
+ */
+struct xia_addr_writer *xia_addr_writer_open(int fd);
+
+/* xia_addr_write - write @n addresses of @addrs to @w.
+ *
+ * RETURN
+ *	Zero on success; otherwise a negative errno of the write.
+ */
+int xia_addr_write(struct xia_addr_writer *w, const struct xia_addr *addrs,
+	int n);
+
+/* xia_addr_writer_flush - write the buffered addresses of @w out.
+ *
+ * RETURN
+ *	Zero on success; otherwise a negative errno of the write, or -EIO
+ *	if the write did not progress.
+ *
+ * NOTES
+ *	After an error, @w drops addresses, and keeps returning the error.
+ */
+int xia_addr_writer_flush(struct xia_addr_writer *w);
+
+/* xia_addr_writer_close - flush and free @w.
+ *
+ * RETURN
+ *	Zero on success; otherwise a negative errno of the last write.
+ */
+int xia_addr_writer_close(struct xia_addr_writer *w);
+
+/* xia_addr_reader_open - read a file of compact addresses from @fd.
+ *
+ * RETURN
+ *	The new reader, or NULL if there is not enough memory.
+ *
+ * NOTES
+ *	The header is read with the first addresses. @fd is not closed by
+ *	xia_addr_reader_close.
+ */
+struct xia_addr_reader *xia_addr_reader_open(int fd);
+
+/* xia_addr_read - read up to @n addresses from @r into @addrs.
+ *
+ * RETURN
+ *	Number of addresses read, and zero at the end of the file.
+ *	Otherwise, a negative errno of the read, or -EINVAL if the file
+ *	is not a file of compact addresses, or it is corrupted or truncated.
+ */
+int xia_addr_read(struct xia_addr_reader *r, struct xia_addr *addrs, int n);
+
+/* xia_addr_reader_close - free @r. */
+void xia_addr_reader_close(struct xia_addr_reader *r);
+
+#endif /* HEADER_ADDR_COMPACT_H */
@@ -0,0 +1,82 @@
+#ifndef HEADER_ADDR_SET_H
+#define HEADER_ADDR_SET_H
+
+#include <stddef.h>
+#include <net/xia.h>
+
+/* Hash map keyed by XIA addresses, or a set of addresses when values are
+ * empty.
+ *
+ * Addresses are keyed as xia_are_addrs_equal<net/xia_dag.h> compares
+ * them: only the rows before the first XIDTYPE_NAT row count, and chosen
+ * edges count as not chosen. The table only holds the fingerprints of
+ * the addresses, so a lookup compares whole addresses only when their
+ * fingerprints match.
+ * Entries are kept in a dense array, so pointers to values are valid
+ * until the next insert or erase.
+ * A set is not thread-safe, but concurrent lookups are fine.
+ */
+struct xia_addr_set;
+
+/* xia_addr_set_new - create an empty set whose values have @value_size
+ *	bytes; zero makes a plain set.
+ *
+ * RETURN
+ *	The new set, or NULL if there is not enough memory.
+ */
+struct xia_addr_set *xia_addr_set_new(size_t value_size);
+
+/* xia_addr_set_free - free @set and its entries. @set may be NULL. */
+void xia_addr_set_free(struct xia_addr_set *set);
+
+/* xia_addr_set_count - return the number of entries in @set. */
+size_t xia_addr_set_count(const struct xia_addr_set *set);
+
+/* xia_addr_set_find - look @addr up in @set.
+ *
+ * RETURN
+ *	A pointer to the value of @addr, or NULL if @addr is not in @set.
+ *	The pointer of an entry of a plain set is not NULL, but it must not
+ *	be dereferenced.
+ */
+void *xia_addr_set_find(const struct xia_addr_set *set,
+	const struct xia_addr *addr);
+
+/* xia_addr_set_insert - add @addr to @set unless it is already there.
+ *
+ * RETURN
+ *	One if @addr was added, zero if it was already in @set, and -ENOMEM
+ *	if there is not enough memory.
+ *
+ * NOTES
+ *	If @pvalue is not NULL, *@pvalue receives a pointer to the value of
+ *	@addr. The value of a new entry is zeroed.
+ *	@set keeps the canonical form of @addr; see xia_canonical_addr.
+ */
+int xia_addr_set_insert(struct xia_addr_set *set,
+	const struct xia_addr *addr, void **pvalue);
+
+/* xia_addr_set_erase - remove @addr from @set.
+ *
+ * RETURN
+ *	One if @addr was removed; zero if it was not in @set.
+ */
+int xia_addr_set_erase(struct xia_addr_set *set,
+	const struct xia_addr *addr);
+
+/* xia_addr_set_next - iterate over the entries of @set.
+ *
+ * RETURN
+ *	The canonical address of the next entry at or after position
+ *	*@ppos, or NULL if there is none.
+ *
+ * NOTES
+ *	*@ppos must be zero to start, and it is moved beyond the entry
+ *	returned. If @pvalue is not NULL, it receives the value of the entry.
+ *	Entries come in no particular order, and @set must not be changed
+ *	during the iteration.
+ */
+const struct xia_addr *xia_addr_set_next(const struct xia_addr_set *set,
+	size_t *ppos, void **pvalue);
+
+#endif /* HEADER_ADDR_SET_H */
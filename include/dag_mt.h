@@ -0,0 +1,18 @@
+#ifndef HEADER_DAG_MT_H
+#define HEADER_DAG_MT_H
+
+#include <net/xia.h>
+
+/* xia_test_addrs_mt - works as xia_test_addrs<net/xia_dag.h>, but splits
+ *	@addrs among up to @nthreads threads, the calling thread included.
+ * Small batches are tested in the calling thread since starting threads
+ *	would cost more than it saves. If a thread cannot be started,
+ *	its share is tested in the calling thread.
+ *
+ * RETURN
+ *	Number of addresses with an error.
+ */
+int xia_test_addrs_mt(const struct xia_addr *addrs, int *results, int n,
+	int nthreads);
+
+#endif /* HEADER_DAG_MT_H */
@@ -7,12 +7,37 @@
  *
  * NOTE
  *	If @ppal_file is NULL, a default file will be used.
+ *	The map is only loaded on its first use, so warnings about
+ *	the content of @ppal_file show up then.
+ *	If the environment variable XIA_PPAL_CACHE_DIR names a directory,
+ *	the compiled map is cached there, and later loads map the cache
+ *	instead of parsing @ppal_file while @ppal_file is unchanged.
+ *	Only trusted users must be able to write to that directory.
  *
  * RETURN
- *	Return zero on success, and a negative number on failure.
+ *	Return zero on success, and a negative number if @ppal_file
+ *	cannot be read.
  */
 int init_ppal_map(const char *ppal_file);
 
+/* reload_ppal_map - Replace the principal map in memory with
+ *	the content of @ppal_file.
+ *
+ * NOTE
+ *	If @ppal_file is NULL, a default file will be used.
+ *	Nothing is done if @ppal_file has the same inode, size, and
+ *	modification time as the last file loaded.
+ *	Lookups may run concurrently with the reload; they see either
+ *	the old map or the new one. Reloads must not run concurrently.
+ *	The old map is kept if there is no memory for the new one; a new
+ *	map that cannot be compiled is loaded, but its lookups are slower.
+ *	init_ppal_map calls this function when a map is already loaded.
+ *
+ * RETURN
+ *	Return zero on success, and a negative number on failure.
+ */
+int reload_ppal_map(const char *ppal_file);
+
 /* Simple function to print out an XIA address. */
 void print_xia_addr(const struct xia_addr *addr);
 
@@ -0,0 +1,168 @@
+#ifndef HEADER_XIACONF_H
+#define HEADER_XIACONF_H
+
+#include <stddef.h>
+#include <linux/netlink.h>
+#include <net/xia.h>
+
+/* libxiaconf - the routes of xip as a library.
+ *
+ * Programs that manage XIA routes link this library instead of running
+ * xip and parsing its output. Entries of every principal go through the
+ * same calls; the principal is the type of the destination XID, which
+ * ppal_name_to_type<ppal_map.h> gives from its name.
+ *
+ * Functions do not print anything nor exit; they return negative error
+ * numbers, and errors of the kernel come back as they are.
+ * A handle is not thread-safe; threads should each open their own.
+ */
+struct xiaconf;
+
+/* Protocol-specific information of entries, for example, the length of
+ * the prefix of LPM entries, or struct local_u4id_info<net/xia_u4id.h>.
+ */
+#define XIACONF_PROTOINFO_MAX	16
+
+struct xiaconf_route {
+	__u32		tbl_id;		/* XRTABLE_*_INDEX<net/xia_fib.h>.	*/
+	struct xia_xid	dst;
+	struct xia_xid	gw;		/* Only routes of the main table.	*/
+	__u8		has_gw;
+	__u8		protocol;	/* RTPROT_*; from the kernel only.	*/
+	__u8		protoinfo_len;	/* Zero if there is none.		*/
+	__u8		protoinfo[XIACONF_PROTOINFO_MAX];
+	__u32		flags;		/* RTM_F_*; from the kernel only.	*/
+};
+
+/* xiaconf_open - open a handle in *@pxc.
+ *
+ * RETURN
+ *	Zero on success; otherwise a negative error number.
+ */
+int xiaconf_open(struct xiaconf **pxc);
+
+/* xiaconf_close - close @xc. @xc may be NULL. */
+void xiaconf_close(struct xiaconf *xc);
+
+/* xiaconf_add - add the entry @rt.
+ *
+ * RETURN
+ *	Zero on success; -EEXIST if the entry is already there; otherwise
+ *	a negative error number.
+ *
+ * NOTES
+ *	@rt->tbl_id selects between a local entry and a route; only routes
+ *	have gateways. @rt->protocol and @rt->flags are ignored.
+ */
+int xiaconf_add(struct xiaconf *xc, const struct xiaconf_route *rt);
+
+/* xiaconf_replace - replace the entry @rt already in the kernel.
+ *
+ * RETURN
+ *	Same as xiaconf_add(), but the entry must already be there.
+ */
+int xiaconf_replace(struct xiaconf *xc, const struct xiaconf_route *rt);
+
+/* xiaconf_del - remove the entry whose table and destination are those
+ *	of @rt.
+ *
+ * RETURN
+ *	Zero on success; -ENOENT if there is no such entry; otherwise
+ *	a negative error number.
+ *
+ * NOTES
+ *	Some principals need @rt->protoinfo to find the entry; the gateway
+ *	is ignored.
+ */
+int xiaconf_del(struct xiaconf *xc, const struct xiaconf_route *rt);
+
+/* xiaconf_get - look the entry of table @tbl_id whose destination is @dst
+ *	up in *@rt, without listing the table.
+ *
+ * RETURN
+ *	Zero on success; -ENOENT if there is no such entry; otherwise
+ *	a negative error number.
+ *
+ * NOTES
+ *	The kernel picks the entry that answers, so principals that
+ *	match destinations by prefix, as LPM does, answer with the entry
+ *	that covers @dst.
+ */
+int xiaconf_get(struct xiaconf *xc, __u32 tbl_id, const struct xia_xid *dst,
+	struct xiaconf_route *rt);
+
+/* Memory provided by the caller for results; see xiaconf_list(). */
+struct xiaconf_arena {
+	void		*buf;
+	size_t		size;
+	size_t		used;		/* Bytes of @buf already taken.	*/
+};
+
+/* xiaconf_list - list the entries of table @tbl_id whose destinations are
+ *	of principal @ppal_ty.
+ *
+ * RETURN
+ *	The number of entries on success, and *@proutes points to them;
+ *	-ENOSPC if @arena is too small for the entries; -EAGAIN if
+ *	the table changed during the listing; otherwise a negative error
+ *	number.
+ *
+ * NOTES
+ *	If @arena is not NULL, the entries are taken from it, and
+ *	@arena->used grows by what they take. Otherwise, they are allocated
+ *	with malloc(3), and the caller must free(3) *@proutes.
+ *	On failure, @arena is left as it was, and *@proutes is not set.
+ *	Information longer than XIACONF_PROTOINFO_MAX bytes is cut.
+ */
+int xiaconf_list(struct xiaconf *xc, xid_type_t ppal_ty, __u32 tbl_id,
+	struct xiaconf_arena *arena, struct xiaconf_route **proutes);
+
+/*
+ *	Messages
+ *
+ * The functions above build and decode the messages below, and
+ * programs that talk rtnetlink themselves can too.
+ */
+
+/* Operations of xiaconf_request(). */
+enum xiaconf_op {
+	XIACONF_ADD,
+	XIACONF_REPLACE,
+	XIACONF_DEL,
+};
+
+/* xiaconf_request - build in @n, a buffer of @size bytes, the request of
+ *	operation @op on entry @rt.
+ *
+ * RETURN
+ *	Zero on success; -EMSGSIZE if @size is too small.
+ *
+ * NOTES
+ *	The request does not ask for an acknowledgment, and its sequence
+ *	number is zero. XIACONF_REQ_SIZE bytes are always enough.
+ */
+#define XIACONF_REQ_SIZE	256
+int xiaconf_request(struct nlmsghdr *n, size_t size, enum xiaconf_op op,
+	const struct xiaconf_route *rt);
+
+/* xiaconf_get_request - build in @n, a buffer of @size bytes, the request
+ *	that asks for the entry of table @tbl_id whose destination is @dst.
+ *
+ * RETURN
+ *	Same as xiaconf_request().
+ *
+ * NOTES
+ *	The kernel answers with a route message, or with an error.
+ */
+int xiaconf_get_request(struct nlmsghdr *n, size_t size, __u32 tbl_id,
+	const struct xia_xid *dst);
+
+/* xiaconf_parse_route - decode the route message @n into @rt.
+ *
+ * RETURN
+ *	One if @n is an XIA route, and @rt holds it; zero if @n is not
+ *	an XIA route, or a cached one; -EINVAL if @n is malformed.
+ */
+int xiaconf_parse_route(const struct nlmsghdr *n, struct xiaconf_route *rt);
+
+#endif /* HEADER_XIACONF_H */
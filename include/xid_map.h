@@ -0,0 +1,126 @@
+#ifndef HEADER_XID_MAP_H
+#define HEADER_XID_MAP_H
+
+#include <stddef.h>
+#include <net/xia.h>
+
+/* Hash map keyed by XIDs, or a set of XIDs when values are empty.
+ *
+ * Entries live in a single open-addressing table whose slots are probed
+ * sixteen at a time through a byte of control per slot, so that most
+ * lookups touch a single control group and a single slot.
+ * Pointers to values are valid until the next insert or reserve.
+ * A map is not thread-safe, but concurrent lookups are fine.
+ */
+struct xia_xid_map;
+
+/* xia_xid_map_new - create an empty map whose values have @value_size
+ *	bytes; zero makes a set.
+ *
+ * RETURN
+ *	The new map, or NULL if there is not enough memory.
+ */
+struct xia_xid_map *xia_xid_map_new(size_t value_size);
+
+/* xia_xid_map_free - free @map and its entries. @map may be NULL. */
+void xia_xid_map_free(struct xia_xid_map *map);
+
+/* xia_xid_map_count - return the number of entries in @map. */
+size_t xia_xid_map_count(const struct xia_xid_map *map);
+
+/* xia_xid_map_clear - remove all entries of @map, but keep its memory. */
+void xia_xid_map_clear(struct xia_xid_map *map);
+
+/* xia_xid_map_reserve - make room for @n entries in @map, so that
+ *	inserts up to @n entries don't grow the map.
+ *
+ * RETURN
+ *	Zero on success; -ENOMEM if there is not enough memory.
+ */
+int xia_xid_map_reserve(struct xia_xid_map *map, size_t n);
+
+/* xia_xid_map_find - look @xid up in @map.
+ *
+ * RETURN
+ *	A pointer to the value of @xid, or NULL if @xid is not in @map.
+ *	The pointer of an entry of a set is not NULL, but it must not be
+ *	dereferenced.
+ */
+void *xia_xid_map_find(const struct xia_xid_map *map,
+	const struct xia_xid *xid);
+
+/* xia_xid_map_insert - add @xid to @map unless it is already there.
+ *
+ * RETURN
+ *	One if @xid was added, zero if it was already in @map, and -ENOMEM
+ *	if there is not enough memory.
+ *
+ * NOTES
+ *	If @pvalue is not NULL, *@pvalue receives a pointer to the value of
+ *	@xid. The value of a new entry is zeroed.
+ */
+int xia_xid_map_insert(struct xia_xid_map *map, const struct xia_xid *xid,
+	void **pvalue);
+
+/* xia_xid_map_erase - remove @xid from @map.
+ *
+ * RETURN
+ *	One if @xid was removed; zero if it was not in @map.
+ */
+int xia_xid_map_erase(struct xia_xid_map *map, const struct xia_xid *xid);
+
+/* xia_xid_map_find_many - look the @n XIDs of @xids up in @map.
+ *
+ * RETURN
+ *	Number of XIDs found.
+ *
+ * NOTES
+ *	@values[i] receives what xia_xid_map_find would return for @xids[i].
+ *	@values may be NULL when only the count matters.
+ *	Lookups of a batch overlap their memory accesses, so batches run
+ *	faster than a loop of xia_xid_map_find on large maps.
+ */
+int xia_xid_map_find_many(const struct xia_xid_map *map,
+	const struct xia_xid *xids, int n, void **values);
+
+/* xia_xid_map_insert_many - add the @n XIDs of @xids to @map.
+ *
+ * RETURN
+ *	Number of XIDs added, or -ENOMEM if there is not enough memory;
+ *	nothing is added in that case.
+ *
+ * NOTES
+ *	If @values is not NULL, it holds @n values of the size of
+ *	the values of @map, and each new entry receives its value;
+ *	entries already in @map keep theirs.
+ *	If @results is not NULL, @results[i] receives what
+ *	xia_xid_map_insert would return for @xids[i]. Duplicates within
+ *	@xids are only added once.
+ */
+int xia_xid_map_insert_many(struct xia_xid_map *map,
+	const struct xia_xid *xids, const void *values, int n, int *results);
+
+/* xia_xid_map_erase_many - remove the @n XIDs of @xids from @map.
+ *
+ * RETURN
+ *	Number of XIDs removed.
+ */
+int xia_xid_map_erase_many(struct xia_xid_map *map,
+	const struct xia_xid *xids, int n);
+
+/* xia_xid_map_next - iterate over the entries of @map.
+ *
+ * RETURN
+ *	The XID of the next entry at or after position *@ppos, or NULL if
+ *	there is none.
+ *
+ * NOTES
+ *	*@ppos must be zero to start, and it is moved beyond the entry
+ *	returned. If @pvalue is not NULL, it receives the value of the entry.
+ *	Entries come in no particular order, and the map must not be changed
+ *	during the iteration; removing the entry just returned is fine.
+ */
+const struct xia_xid *xia_xid_map_next(const struct xia_xid_map *map,
+	size_t *ppos, void **pvalue);
+
+#endif /* HEADER_XID_MAP_H */
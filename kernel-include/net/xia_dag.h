@@ -18,9 +18,8 @@
  *	Zero for success, otherwise a negative number.
  *
  * NOTES
- *	In Kernel, it can be called concurrently with calls of
- *	ppal_add_map and ppal_del_map.
- *	In userland, the caller must manage a lock.
+ *	It can be called concurrently with calls of ppal_add_map,
+ *	ppal_del_map, and ppal_replace_map.
  *	If @name is not in the map, it returns -ESRCH; otherwise zero.
  */
 extern int ppal_name_to_type(const char *name, xid_type_t *pty);
@@ -31,9 +30,8 @@ extern int ppal_name_to_type(const char *name, xid_type_t *pty);
  *	Zero for success, otherwise a negative number.
  *
  * NOTES
- *	In Kernel, it can be called concurrently with calls of
- *	ppal_add_map and ppal_del_map.
- *	In userland, the caller must manage a lock.
+ *	It can be called concurrently with calls of ppal_add_map,
+ *	ppal_del_map, and ppal_replace_map.
  *	@name must be at least MAX_PPAL_NAME_SIZE large.
  *	If @type is not in the map, it returns -ESRCH; otherwise zero.
  */
@@ -45,9 +43,8 @@ extern int ppal_type_to_name(xid_type_t type, char *name);
  *	Zero for success, otherwise a negative number.
  *
  * NOTES
- *	In Kernel, ppal_add_map and ppal_del_map share a lock to make
- *	current changes safe.
- *	In userland, the caller must manage a lock.
+ *	ppal_add_map, ppal_del_map, and ppal_replace_map share a lock to
+ *	make concurrent changes safe.
  *	@name and @type must be unique.
  */
 extern int ppal_add_map(const char *name, xid_type_t type);
@@ -58,13 +55,82 @@ extern int ppal_add_map(const char *name, xid_type_t type);
  *	Zero for success, otherwise a negative number.
  *
  * NOTES
- *	In Kernel, ppal_add_map and ppal_del_map share a lock to make
- *	current changes safe.
- *	In userland, the caller must manage a lock.
- *	Caller must have a lock that guarantees multual exclusion.
+ *	ppal_add_map, ppal_del_map, and ppal_replace_map share a lock to
+ *	make concurrent changes safe.
  */
 extern int ppal_del_map(xid_type_t type);
 
+/* ppal_compile_map - Build a collision-free copy of the map to speed up
+ *	ppal_name_to_type and ppal_type_to_name.
+ *
+ * RETURN
+ *	Zero for success, otherwise a negative number:
+ *	-ERANGE if a type is too large to be indexed, or there are too
+ *		many principals,
+ *	-ENOSPC if no perfect hash was found for the names, and
+ *	-EAGAIN if the map changed while it was compiled.
+ *
+ * NOTES
+ *	Lookups use the lists of the map when there is no compiled copy,
+ *	so a failure only makes lookups slower.
+ *	ppal_add_map and ppal_del_map drop the compiled copy, so it should
+ *	be rebuilt after the map is changed.
+ *	It takes the lock of ppal_add_map and ppal_del_map only to copy
+ *	the map, and to publish the compiled copy; the copy is compiled
+ *	without the lock.
+ */
+extern int ppal_compile_map(void);
+
+/* ppal_replace_map - Replace the whole map with the @n maps of @names and
+ *	@types, and compile it.
+ *
+ * RETURN
+ *	Zero for success, otherwise a negative number:
+ *	-ENOMEM if there is not enough memory for the new map.
+ *
+ * NOTES
+ *	@status[i] receives what ppal_add_map would have returned for
+ *	the i-th map; maps with errors are left out of the new map.
+ *	Lookups see either the old map or the new one, never a mix of both.
+ *	If the new map cannot be compiled, it is installed anyway, and its
+ *	lookups are slower; see ppal_compile_map.
+ *	It takes the same lock as ppal_add_map and ppal_del_map, and
+ *	waits for lookups of the old map before freeing it.
+ */
+extern int ppal_replace_map(const char * const *names,
+	const xid_type_t *types, int n, int *status);
+
+/* ppal_export_map - Compile the map, and copy the compiled map into a new
+ *	buffer, so that it can be saved and later passed to ppal_import_map.
+ *
+ * RETURN
+ *	Zero for success, otherwise a negative number; see ppal_compile_map.
+ *	-ENOMEM if there is not enough memory for the copy.
+ *
+ * NOTES
+ *	*@pbuf receives the buffer, and *@plen its length. The caller must
+ *	free the buffer.
+ *	The format of the buffer depends on the machine and on this file.
+ */
+extern int ppal_export_map(void **pbuf, size_t *plen);
+
+/* ppal_import_map - Use the compiled map of @buf as the map.
+ *
+ * RETURN
+ *	Zero for success, otherwise a negative number:
+ *	-EINVAL if @buf does not hold a valid map, or it is not aligned
+ *		to 4 bytes, and
+ *	-EBUSY if the map is not empty.
+ *
+ * NOTES
+ *	No map is copied or allocated; @buf must remain valid and unchanged
+ *	for the life of the map, and it is never freed.
+ *	If the map is later changed, the maps in @buf are copied into
+ *	the lists of the map.
+ *	It takes the same lock as ppal_add_map and ppal_del_map.
+ */
+extern int ppal_import_map(const void *buf, size_t len);
+
 enum xia_addr_error {
 	/* There's a non-XIDTYPE_NAT node after an XIDTYPE_NAT node. */
 	XIAEADDR_NAT_MISPLACED = 1,
@@ -102,6 +168,40 @@ extern int xia_are_edges_valid(const struct xia_row *row,
  */
 extern int xia_test_addr(const struct xia_addr *addr);
 
+/** xia_test_addrs - test @addrs[0..n-1] as xia_test_addr would do, and
+ *	save each result in @results.
+ * It tests the edges of a row at once with mask arithmetic, so it is
+ *	faster than calling xia_test_addr for each address.
+ *
+ * RETURN
+ *	Number of addresses with an error.
+ */
+extern int xia_test_addrs(const struct xia_addr *addrs, int *results, int n);
+
+/** xia_addr_fingerprint - hash @addr into 64 bits.
+ * Only the rows before the first XIDTYPE_NAT row are hashed, and chosen
+ *	edges are hashed as if they were not chosen, so addresses that
+ *	xia_are_addrs_equal finds equal have the same fingerprint.
+ */
+extern __u64 xia_addr_fingerprint(const struct xia_addr *addr);
+
+/** xia_are_addrs_equal - test that @a and @b have the same rows before
+ *	their first XIDTYPE_NAT row, ignoring whether edges are chosen.
+ *
+ * RETURN
+ *	One if they are equal; otherwise zero.
+ */
+extern int xia_are_addrs_equal(const struct xia_addr *a,
+	const struct xia_addr *b);
+
+/** xia_canonical_addr - copy @src into @dst without chosen edges, and
+ *	with zeroed rows after the rows of @src.
+ * Addresses that xia_are_addrs_equal finds equal have the same canonical
+ *	form, so canonical addresses can be compared with memcmp.
+ */
+extern void xia_canonical_addr(struct xia_addr *dst,
+	const struct xia_addr *src);
+
 /* xia_tytop - convert @ty to a string (@dst).
  * @dstlen is the size of buffer @dst, it must be at least MAX_PPAL_NAME_SIZE.
  * The string will be a name if it is available, otherwise a number following
@@ -161,6 +261,16 @@ extern int xia_xidtop(const struct xia_xid *src, char *dst, size_t dstlen);
 extern int xia_ntop(const struct xia_addr *src, char *dst, size_t dstlen,
 		int include_nl);
 
+/** xia_ntop_trusted - works as xia_ntop, but @src is assumed to be valid
+ *	according to xia_test_addr, so the test is skipped.
+ * It is meant for callers that have already validated @src, for example,
+ * when printing addresses that the kernel dumps.
+ * NOTE
+ *	If @src is not valid, the returned string may not represent @src.
+ */
+extern int xia_ntop_trusted(const struct xia_addr *src, char *dst,
+		size_t dstlen, int include_nl);
+
 /** xia_pton - Convert a string that represents an XIA addressesng into
  *	binary (network) form.
  * It doesn't not require the string @src to be terminated by '\0'.
@@ -192,4 +302,68 @@ extern int xia_ptoxid(const char *src, size_t srclen, struct xia_xid *dst);
  */
 extern int xia_ptoid(const char *src, size_t srclen, struct xia_xid *dst);
 
+/* Framing of the records of batch conversions. */
+enum xia_rec_fmt {
+	/* Records end with '\n', but the last one may lack it.
+	 * A '\n' that follows a node separator (i.e. ":\n") is part of
+	 * the address, so addresses may span lines as xia_ntop writes them
+	 * when include_nl is true.
+	 */
+	XIA_REC_NEWLINE = 0,
+	/* Records are preceded by their length in two bytes in network order,
+	 * and have no delimiter.
+	 */
+	XIA_REC_LEN16,
+};
+
+/** xia_pton_many - convert up to @n records of @src into @dst[0..n-1]
+ *	as xia_pton would do.
+ * @status[i] receives -1 if record i can't be converted, otherwise
+ *	the invalid flag of record i (see xia_pton). A bad record doesn't
+ *	stop the conversion of the following ones.
+ * If @pused isn't NULL, it receives the number of consumed chars.
+ * A truncated record at the end of @src is not consumed if @fmt is
+ *	XIA_REC_LEN16, so streams can refill @src and carry on.
+ *
+ * RETURN
+ *	-EINVAL - @fmt is not valid.
+ *	Number of records read, converted or not.
+ *
+ * NOTES
+ *	Principals are looked up once per run of equal principals,
+ *	so the batch may not see changes to the principal map made while
+ *	it runs.
+ */
+extern int xia_pton_many(const char *src, size_t srclen,
+		enum xia_rec_fmt fmt, struct xia_addr *dst, int *status, int n,
+		int ignore_ce, size_t *pused);
+
+/** xia_ptoxid_many - works as xia_pton_many, but records are XIDs
+ *	converted as xia_ptoxid would do. @status[i] is either zero or -1.
+ */
+extern int xia_ptoxid_many(const char *src, size_t srclen,
+		enum xia_rec_fmt fmt, struct xia_xid *dst, int *status, int n,
+		size_t *pused);
+
+/** xia_ntop_many - convert @src[0..n-1] into records written to @dst
+ *	as xia_ntop would do.
+ * Conversion stops at the first record that doesn't fit in @dst;
+ *	a record only fits if there is a spare char after it.
+ * If @pused isn't NULL, it receives the number of written chars.
+ *	No '\0' is added after the last record.
+ *
+ * RETURN
+ *	-EINVAL - @fmt is not valid.
+ *	Number of written records.
+ */
+extern int xia_ntop_many(const struct xia_addr *src, int n,
+		enum xia_rec_fmt fmt, char *dst, size_t dstlen, int include_nl,
+		size_t *pused);
+
+/** xia_xidtop_many - works as xia_ntop_many, but converts XIDs
+ *	as xia_xidtop would do.
+ */
+extern int xia_xidtop_many(const struct xia_xid *src, int n,
+		enum xia_rec_fmt fmt, char *dst, size_t dstlen, size_t *pused);
+
 #endif	/* _XIA_DAG_H	*/
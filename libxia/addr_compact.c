@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <net/xia_dag.h>
+
+#include "addr_compact.h"
+
+#define DESC_KEPT_MASK	0x07
+#define DESC_CHOSEN	0x08
+#define DESC_BYTES	0x10
+#define DESC_RESERVED	0xe0
+
+/* Largest edge that fits in a nibble; the next one is XIA_EMPTY_EDGE. */
+#define NIBBLE_EDGE_MAX	14
+#define NIBBLE_EMPTY	15
+
+static inline int put_varint(__u8 *dst, __u32 v)
+{
+	int i = 0;
+
+	while (v >= 0x80) {
+		dst[i++] = v | 0x80;
+		v >>= 7;
+	}
+	dst[i++] = v;
+	return i;
+}
+
+/* Encode a row into @dst, which has room for any row. */
+static int encode_row(const struct xia_row *row, __u8 *dst)
+{
+	__u8 edges[XIA_OUTDEGREE_MAX], chosen = 0, desc;
+	int len, kept = 0, bytes = 0, i;
+
+	len = put_varint(dst, __be32_to_cpu(row->s_xid.xid_type));
+	memcpy(dst + len, row->s_xid.xid_id, XIA_XID_MAX);
+	len += XIA_XID_MAX;
+
+	for (i = 0; i < XIA_OUTDEGREE_MAX; i++) {
+		const __u8 e = row->s_edge.a[i];
+		edges[i] = e & ~XIA_CHOSEN_EDGE;
+		if (is_edge_chosen(e))
+			chosen |= 1 << i;
+		if (e != XIA_EMPTY_EDGE)
+			kept = i + 1;
+		if (edges[i] > NIBBLE_EDGE_MAX && edges[i] != XIA_EMPTY_EDGE)
+			bytes = 1;
+	}
+
+	desc = kept | (chosen ? DESC_CHOSEN : 0) | (bytes ? DESC_BYTES : 0);
+	dst[len++] = desc;
+	if (chosen)
+		dst[len++] = chosen;
+	if (bytes) {
+		memcpy(dst + len, edges, kept);
+		return len + kept;
+	}
+	for (i = 0; i < kept; i += 2) {
+		__u8 lo = edges[i] == XIA_EMPTY_EDGE ? NIBBLE_EMPTY : edges[i];
+		__u8 hi = NIBBLE_EMPTY;
+		if (i + 1 < kept)
+			hi = edges[i + 1] == XIA_EMPTY_EDGE ? NIBBLE_EMPTY :
+				edges[i + 1];
+		dst[len++] = lo | hi << 4;
+	}
+	return len;
+}
+
+/* The largest encoding of a row. */
+#define ROW_MAX	((XIA_COMPACT_ADDR_MAX - 1) / XIA_NODES_MAX)
+
+int xia_addr_encode(const struct xia_addr *addr, __u8 *dst, size_t dstlen)
+{
+	__u8 row[ROW_MAX];
+	size_t len = 1;
+	int i;
+
+	if (dstlen < 1)
+		return -ENOSPC;
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		int row_len;
+
+		if (xia_is_nat(addr->s_row[i].s_xid.xid_type))
+			break;
+		/* Most rows fit, so only the last rows go through @row. */
+		if (dstlen - len >= ROW_MAX) {
+			len += encode_row(&addr->s_row[i], dst + len);
+			continue;
+		}
+		row_len = encode_row(&addr->s_row[i], row);
+		if (dstlen - len < (size_t)row_len)
+			return -ENOSPC;
+		memcpy(dst + len, row, row_len);
+		len += row_len;
+	}
+	dst[0] = i;
+	return len;
+}
+
+/* Decode a row from @src, and return the number of bytes read. */
+static int decode_row(const __u8 *src, size_t srclen, struct xia_row *row)
+{
+	__u32 type = 0;
+	size_t len = 0;
+	__u8 desc, chosen = 0;
+	int kept, i;
+
+	for (i = 0; ; i += 7) {
+		if (len >= srclen)
+			return -EAGAIN;
+		/* Types have 32 bits. */
+		if (i > 28 || (i == 28 && src[len] > 0x0f))
+			return -EINVAL;
+		type |= (__u32)(src[len] & 0x7f) << i;
+		if (!(src[len++] & 0x80))
+			break;
+	}
+	/* XIDTYPE_NAT ends addresses, so it cannot be in a row. */
+	if (type == XIDTYPE_NAT)
+		return -EINVAL;
+	row->s_xid.xid_type = __cpu_to_be32(type);
+
+	if (srclen - len < XIA_XID_MAX + 1)
+		return -EAGAIN;
+	memcpy(row->s_xid.xid_id, src + len, XIA_XID_MAX);
+	len += XIA_XID_MAX;
+
+	desc = src[len++];
+	kept = desc & DESC_KEPT_MASK;
+	if ((desc & DESC_RESERVED) || kept > XIA_OUTDEGREE_MAX)
+		return -EINVAL;
+	if (desc & DESC_CHOSEN) {
+		if (len >= srclen)
+			return -EAGAIN;
+		chosen = src[len++];
+		if (chosen >> kept)
+			return -EINVAL;
+	}
+
+	row->s_edge.i = __cpu_to_be32(XIA_EMPTY_EDGES);
+	if (desc & DESC_BYTES) {
+		if (srclen - len < (size_t)kept)
+			return -EAGAIN;
+		for (i = 0; i < kept; i++) {
+			if (src[len] & XIA_CHOSEN_EDGE)
+				return -EINVAL;
+			row->s_edge.a[i] = src[len++];
+		}
+	} else {
+		if (srclen - len < (size_t)(kept + 1) / 2)
+			return -EAGAIN;
+		for (i = 0; i < kept; i++) {
+			__u8 e = i & 1 ? src[len++] >> 4 : src[len] & 0x0f;
+			row->s_edge.a[i] = e == NIBBLE_EMPTY ?
+				XIA_EMPTY_EDGE : e;
+		}
+		if (kept & 1)
+			len++;
+	}
+	for (i = 0; i < kept; i++)
+		if (chosen & (1 << i))
+			xia_mark_edge(&row->s_edge.a[i]);
+	return len;
+}
+
+int xia_addr_decode(const __u8 *src, size_t srclen, struct xia_addr *addr)
+{
+	size_t len = 1;
+	int n, i;
+
+	if (srclen < 1)
+		return -EAGAIN;
+	n = src[0];
+	if (n > XIA_NODES_MAX)
+		return -EINVAL;
+	for (i = 0; i < n; i++) {
+		int rc = decode_row(src + len, srclen - len, &addr->s_row[i]);
+		if (rc < 0)
+			return rc;
+		len += rc;
+	}
+	memset(&addr->s_row[n], 0, (XIA_NODES_MAX - n) * sizeof(addr->s_row[0]));
+	return len;
+}
+
+/*
+ * Streams
+ */
+
+#define STREAM_MAGIC	"XIAA"
+#define STREAM_VERSION	1
+#define STREAM_HDR_LEN	8
+#define STREAM_BUF_SIZE	(64 * 1024)
+
+struct xia_addr_writer {
+	int	fd;
+	int	error;
+	size_t	len;
+	__u8	buf[STREAM_BUF_SIZE];
+};
+
+struct xia_addr_reader {
+	int	fd;
+	int	has_hdr;
+	int	eof;
+	size_t	start;
+	size_t	end;
+	__u8	buf[STREAM_BUF_SIZE];
+};
+
+static void put_stream_hdr(__u8 *hdr)
+{
+	memset(hdr, 0, STREAM_HDR_LEN);
+	memcpy(hdr, STREAM_MAGIC, 4);
+	hdr[4] = STREAM_VERSION;
+}
+
+struct xia_addr_writer *xia_addr_writer_open(int fd)
+{
+	struct xia_addr_writer *w = malloc(sizeof(*w));
+
+	if (!w)
+		return NULL;
+	w->fd = fd;
+	w->error = 0;
+	put_stream_hdr(w->buf);
+	w->len = STREAM_HDR_LEN;
+	return w;
+}
+
+int xia_addr_writer_flush(struct xia_addr_writer *w)
+{
+	size_t done = 0;
+
+	/* Nothing is written after the first error. */
+	while (!w->error && done < w->len) {
+		ssize_t rc = write(w->fd, w->buf + done, w->len - done);
+		if (rc > 0)
+			done += rc;
+		else if (!rc)
+			w->error = -EIO;
+		else if (errno != EINTR)
+			w->error = -errno;
+	}
+	w->len = 0;
+	return w->error;
+}
+
+int xia_addr_write(struct xia_addr_writer *w, const struct xia_addr *addrs,
+	int n)
+{
+	int i;
+
+	for (i = 0; i < n && !w->error; i++) {
+		if (STREAM_BUF_SIZE - w->len < XIA_COMPACT_ADDR_MAX)
+			xia_addr_writer_flush(w);
+		w->len += xia_addr_encode(&addrs[i], w->buf + w->len,
+			STREAM_BUF_SIZE - w->len);
+	}
+	return w->error;
+}
+
+int xia_addr_writer_close(struct xia_addr_writer *w)
+{
+	int rc = xia_addr_writer_flush(w);
+	free(w);
+	return rc;
+}
+
+struct xia_addr_reader *xia_addr_reader_open(int fd)
+{
+	struct xia_addr_reader *r = malloc(sizeof(*r));
+
+	if (!r)
+		return NULL;
+	r->fd = fd;
+	r->has_hdr = 0;
+	r->eof = 0;
+	r->start = r->end = 0;
+	return r;
+}
+
+/* Move the unread bytes to the start of the buffer, and read more. */
+static int refill(struct xia_addr_reader *r)
+{
+	ssize_t rc;
+
+	memmove(r->buf, r->buf + r->start, r->end - r->start);
+	r->end -= r->start;
+	r->start = 0;
+	do {
+		rc = read(r->fd, r->buf + r->end, STREAM_BUF_SIZE - r->end);
+	} while (rc < 0 && errno == EINTR);
+	if (rc < 0)
+		return -errno;
+	if (!rc)
+		r->eof = 1;
+	r->end += rc;
+	return 0;
+}
+
+static int read_stream_hdr(struct xia_addr_reader *r)
+{
+	__u8 hdr[STREAM_HDR_LEN];
+
+	while (r->end - r->start < STREAM_HDR_LEN && !r->eof) {
+		int rc = refill(r);
+		if (rc)
+			return rc;
+	}
+	put_stream_hdr(hdr);
+	if (r->end - r->start < STREAM_HDR_LEN ||
+		memcmp(r->buf + r->start, hdr, STREAM_HDR_LEN))
+		return -EINVAL;
+	r->start += STREAM_HDR_LEN;
+	r->has_hdr = 1;
+	return 0;
+}
+
+int xia_addr_read(struct xia_addr_reader *r, struct xia_addr *addrs, int n)
+{
+	int i = 0;
+
+	if (!r->has_hdr) {
+		int rc = read_stream_hdr(r);
+		if (rc)
+			return rc;
+	}
+
+	while (i < n) {
+		int rc = xia_addr_decode(r->buf + r->start,
+			r->end - r->start, &addrs[i]);
+		if (rc > 0) {
+			r->start += rc;
+			i++;
+			continue;
+		}
+		if (rc != -EAGAIN)
+			return rc;
+
+		/* Return what was read before blocking on more. */
+		if (i)
+			break;
+		if (r->eof)
+			return r->start == r->end ? 0 : -EINVAL;
+		rc = refill(r);
+		if (rc)
+			return rc;
+	}
+	return i;
+}
+
+void xia_addr_reader_close(struct xia_addr_reader *r)
+{
+	free(r);
+}
@@ -0,0 +1,268 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <asm-generic/errno-base.h>
+#include <net/xia_dag.h>
+
+#include "addr_set.h"
+
+/*
+ * Layout
+ *
+ * Entries are kept in a dense array, and a table of a power of two
+ * number of slots maps fingerprints to entries with linear probing.
+ * A slot only holds a fingerprint and the index of its entry, so probes
+ * walk a compact table, and load an entry only when a fingerprint
+ * matches. Erasing an entry shifts the following slots of its cluster
+ * back, so there are no deleted slots, and moves the last entry into
+ * the hole to keep the array dense.
+ */
+
+#define NO_ENTRY	0xffffffffU
+#define MIN_CAPACITY	16
+
+struct set_slot {
+	__u64		fp;
+	__u32		entry;
+};
+
+struct set_entry {
+	__u64		fp;
+	struct xia_addr	addr;
+	/* Followed by the value. */
+};
+
+struct xia_addr_set {
+	struct set_slot	*table;
+	/* Zero, or a power of two no smaller than MIN_CAPACITY. */
+	size_t		capacity;
+	__u8		*entries;
+	size_t		entries_size;
+	size_t		entry_size;
+	size_t		value_size;
+	size_t		count;
+};
+
+/* Tables are rehashed when more than 3/4 of their slots are taken. */
+static inline size_t max_load(size_t capacity)
+{
+	return capacity - capacity / 4;
+}
+
+static inline struct set_entry *entry_at(const struct xia_addr_set *set,
+	size_t i)
+{
+	return (struct set_entry *)(set->entries + i * set->entry_size);
+}
+
+static inline void *entry_value(struct set_entry *entry)
+{
+	return entry + 1;
+}
+
+/* Return the slot of @addr, whose fingerprint is @fp, or -1 if @addr is
+ * not in @set.
+ */
+static ssize_t find_slot(const struct xia_addr_set *set,
+	const struct xia_addr *addr, __u64 fp)
+{
+	const size_t mask = set->capacity - 1;
+	size_t i;
+
+	if (!set->capacity)
+		return -1;
+	for (i = fp & mask; ; i = (i + 1) & mask) {
+		const struct set_slot *slot = &set->table[i];
+		if (slot->entry == NO_ENTRY)
+			return -1;
+		if (slot->fp == fp && xia_are_addrs_equal(
+			&entry_at(set, slot->entry)->addr, addr))
+			return i;
+	}
+}
+
+/* Return the first free slot for @fp. @set must have a free slot. */
+static size_t free_slot(const struct xia_addr_set *set, __u64 fp)
+{
+	const size_t mask = set->capacity - 1;
+	size_t i;
+
+	for (i = fp & mask; set->table[i].entry != NO_ENTRY;
+		i = (i + 1) & mask)
+		;
+	return i;
+}
+
+static int rehash(struct xia_addr_set *set, size_t capacity)
+{
+	struct xia_addr_set new_set = *set;
+	size_t i;
+
+	new_set.table = malloc(capacity * sizeof(*new_set.table));
+	if (!new_set.table)
+		return -ENOMEM;
+	for (i = 0; i < capacity; i++)
+		new_set.table[i].entry = NO_ENTRY;
+	new_set.capacity = capacity;
+
+	/* The entries hold their fingerprints, so no address is hashed. */
+	for (i = 0; i < set->count; i++) {
+		const __u64 fp = entry_at(set, i)->fp;
+		struct set_slot *slot = &new_set.table[free_slot(&new_set, fp)];
+		slot->fp = fp;
+		slot->entry = i;
+	}
+
+	free(set->table);
+	*set = new_set;
+	return 0;
+}
+
+struct xia_addr_set *xia_addr_set_new(size_t value_size)
+{
+	struct xia_addr_set *set = calloc(1, sizeof(*set));
+
+	if (!set)
+		return NULL;
+	set->value_size = value_size;
+	set->entry_size = (sizeof(struct set_entry) + value_size + 7) & ~7UL;
+	return set;
+}
+
+void xia_addr_set_free(struct xia_addr_set *set)
+{
+	if (!set)
+		return;
+	free(set->table);
+	free(set->entries);
+	free(set);
+}
+
+size_t xia_addr_set_count(const struct xia_addr_set *set)
+{
+	return set->count;
+}
+
+void *xia_addr_set_find(const struct xia_addr_set *set,
+	const struct xia_addr *addr)
+{
+	ssize_t i = find_slot(set, addr, xia_addr_fingerprint(addr));
+	return i < 0 ? NULL : entry_value(entry_at(set, set->table[i].entry));
+}
+
+/* Make room for one more entry. */
+static int make_room(struct xia_addr_set *set)
+{
+	if (set->count >= NO_ENTRY - 1)
+		return -ENOMEM;
+
+	if (set->count == set->entries_size) {
+		size_t size = set->entries_size ? set->entries_size * 2 :
+			MIN_CAPACITY;
+		__u8 *entries = realloc(set->entries, size * set->entry_size);
+		if (!entries)
+			return -ENOMEM;
+		set->entries = entries;
+		set->entries_size = size;
+	}
+
+	if (set->count + 1 > max_load(set->capacity))
+		return rehash(set, set->capacity ? set->capacity * 2 :
+			MIN_CAPACITY);
+	return 0;
+}
+
+int xia_addr_set_insert(struct xia_addr_set *set,
+	const struct xia_addr *addr, void **pvalue)
+{
+	const __u64 fp = xia_addr_fingerprint(addr);
+	ssize_t i = find_slot(set, addr, fp);
+	struct set_entry *entry;
+	struct set_slot *slot;
+
+	if (i >= 0) {
+		if (pvalue)
+			*pvalue = entry_value(entry_at(set,
+				set->table[i].entry));
+		return 0;
+	}
+	if (make_room(set))
+		return -ENOMEM;
+
+	entry = entry_at(set, set->count);
+	entry->fp = fp;
+	xia_canonical_addr(&entry->addr, addr);
+	memset(entry_value(entry), 0, set->value_size);
+	slot = &set->table[free_slot(set, fp)];
+	slot->fp = fp;
+	slot->entry = set->count++;
+	if (pvalue)
+		*pvalue = entry_value(entry);
+	return 1;
+}
+
+/* Free slot @i, and shift back the slots after it that would not be
+ * found otherwise.
+ */
+static void clear_slot(struct xia_addr_set *set, size_t i)
+{
+	const size_t mask = set->capacity - 1;
+	size_t j = i;
+
+	while (1) {
+		size_t home;
+
+		j = (j + 1) & mask;
+		if (set->table[j].entry == NO_ENTRY)
+			break;
+		home = set->table[j].fp & mask;
+		/* Slot j can move back to slot i unless its home lies
+		 * cyclically in (i, j].
+		 */
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			set->table[i] = set->table[j];
+			i = j;
+		}
+	}
+	set->table[i].entry = NO_ENTRY;
+}
+
+int xia_addr_set_erase(struct xia_addr_set *set,
+	const struct xia_addr *addr)
+{
+	ssize_t i = find_slot(set, addr, xia_addr_fingerprint(addr));
+	size_t hole, last;
+
+	if (i < 0)
+		return 0;
+	hole = set->table[i].entry;
+	clear_slot(set, i);
+
+	/* Move the last entry into the hole. */
+	last = --set->count;
+	if (hole != last) {
+		const __u64 fp = entry_at(set, last)->fp;
+		const size_t mask = set->capacity - 1;
+
+		for (i = fp & mask; set->table[i].entry != last;
+			i = (i + 1) & mask)
+			;
+		set->table[i].entry = hole;
+		memcpy(entry_at(set, hole), entry_at(set, last),
+			set->entry_size);
+	}
+	return 1;
+}
+
+const struct xia_addr *xia_addr_set_next(const struct xia_addr_set *set,
+	size_t *ppos, void **pvalue)
+{
+	struct set_entry *entry;
+
+	if (*ppos >= set->count)
+		return NULL;
+	entry = entry_at(set, (*ppos)++);
+	if (pvalue)
+		*pvalue = entry_value(entry);
+	return &entry->addr;
+}
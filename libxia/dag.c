@@ -26,15 +26,15 @@ struct ppal_node {
 	struct hlist_node	lst_per_name;
 	struct hlist_node	lst_per_type;
 	char			name[MAX_PPAL_NAME_SIZE];
+	/* Length of @name; it saves a strlen() per printed row. */
+	int			name_len;
 	xid_type_t		type;
 };
 
 /* This constant must be a power of 2. */
 #define PPAL_MAP_SIZE	128
 
-#ifdef __KERNEL__
 static DEFINE_SPINLOCK(map_lock);
-#endif
 static struct hlist_head ppal_head_per_name[PPAL_MAP_SIZE];
 static struct hlist_head ppal_head_per_type[PPAL_MAP_SIZE];
 
@@ -64,12 +64,230 @@ static inline struct hlist_head *head_per_type(xid_type_t type)
 	return &ppal_head_per_type[__be32_to_cpu(type) & (PPAL_MAP_SIZE - 1)];
 }
 
+/*
+ * Compiled map
+ *
+ * ppal_compile_map() builds a read-only copy of the lists above that
+ * answers lookups without collisions: types index a dense array, and names
+ * go through a minimal perfect hash (hash and displace) whose slots hold
+ * lowercase names tagged with their length.
+ * Any change to the lists drops the compiled map, and lookups fall back to
+ * the lists until the map is compiled again.
+ *
+ * The compiled map is a single block without pointers, so it could be
+ * stored and reused as is.
+ */
+
+/* Types must be below this number to be compiled. */
+#define PPAL_TABLE_TYPES_MAX	4096
+
+struct ppal_entry {
+	xid_type_t	type;
+	__u8		name_len;
+	/* Lowercase, and terminated with '\0'. */
+	char		name[MAX_PPAL_NAME_SIZE];
+};
+
+struct ppal_table {
+	/* Number of entries; it is also the number of slots and buckets
+	 * of the perfect hash.
+	 */
+	__u32		entries_n;
+	/* Seed of the hash of names. */
+	__u32		seed;
+	/* Types in [0, types_n) are indexed. */
+	__u32		types_n;
+	__u32		flags;
+
+	/* Followed by:
+	 * struct ppal_entry	entries[entries_n];	Indexed by slot.
+	 * __u32		disp[entries_n];	Indexed by bucket.
+	 * __u16		by_type[types_n];	Slot plus one, or zero.
+	 */
+};
+
+/* The table is not owned by the map (e.g. it is mapped from a file), so it
+ * is never freed. See ppal_import_map.
+ */
+#define PPAL_TABLE_BORROWED	0x1
+
+/* A displacement with this bit set holds the slot of the single name in
+ * its bucket.
+ */
+#define PPAL_DISP_SLOT	0x80000000U
+
+static inline struct ppal_entry *table_entries(const struct ppal_table *t)
+{
+	return (struct ppal_entry *)(t + 1);
+}
+
+static inline __u32 *table_disp(const struct ppal_table *t)
+{
+	return (__u32 *)(table_entries(t) + t->entries_n);
+}
+
+static inline __u16 *table_by_type(const struct ppal_table *t)
+{
+	return (__u16 *)(table_disp(t) + t->entries_n);
+}
+
+static inline size_t table_size(__u32 entries_n, __u32 types_n)
+{
+	return sizeof(struct ppal_table) +
+		entries_n * (sizeof(struct ppal_entry) + sizeof(__u32)) +
+		types_n * sizeof(__u16);
+}
+
+static struct ppal_table __rcu *ppal_table;
+/* The lists are empty and the table holds the map; see ppal_import_map. */
+static int table_only;
+/* Changes of the map, so that a table built without map_lock is only
+ * published if the map is still the one it was built from.
+ */
+static __u32 map_gen;
+
+/* Names only have ASCII chars, see isname(). */
+static inline char ascii_tolower(char ch)
+{
+	return ch >= 'A' && ch <= 'Z' ? ch + ('a' - 'A') : ch;
+}
+
+/* FNV-1a of lowercase names. */
+static inline __u32 ppal_hash_init(__u32 seed)
+{
+	return 2166136261U ^ seed;
+}
+
+static inline __u32 ppal_hash_step(__u32 hash, char ch)
+{
+	return (hash ^ (__u8)ch) * 16777619U;
+}
+
+static inline __u32 ppal_hash(__u32 seed, const char *name, int len)
+{
+	__u32 hash = ppal_hash_init(seed);
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = ppal_hash_step(hash, name[i]);
+	return hash;
+}
+
+/* Map @x into [0, @n) without a division. */
+static inline __u32 reduce(__u32 x, __u32 n)
+{
+	return ((__u64)x * n) >> 32;
+}
+
+static inline __u32 ppal_bucket(__u32 hash, __u32 buckets_n)
+{
+	return reduce(hash, buckets_n);
+}
+
+/* Scramble @hash and a displacement into a slot. */
+static inline __u32 ppal_slot(__u32 hash, __u32 disp, __u32 slots_n)
+{
+	__u32 x = hash ^ (disp * 0x9e3779b9U);
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return reduce(x, slots_n);
+}
+
+static inline __u32 table_find_slot(const struct ppal_table *t, __u32 hash)
+{
+	const __u32 disp = table_disp(t)[ppal_bucket(hash, t->entries_n)];
+	if (disp & PPAL_DISP_SLOT)
+		return disp & ~PPAL_DISP_SLOT;
+	return ppal_slot(hash, disp, t->entries_n);
+}
+
+static int table_name_to_type(const struct ppal_table *t, const char *name,
+	xid_type_t *pty)
+{
+	const struct ppal_entry *entry;
+	__u32 hash = ppal_hash_init(t->seed);
+	int len, i;
+
+	for (len = 0; name[len]; len++) {
+		if (len >= MAX_PPAL_NAME_SIZE - 1)
+			return -ENOENT;
+		hash = ppal_hash_step(hash, ascii_tolower(name[len]));
+	}
+	if (!t->entries_n)
+		return -ENOENT;
+
+	entry = &table_entries(t)[table_find_slot(t, hash)];
+	if (entry->name_len != len)
+		return -ENOENT;
+	for (i = 0; i < len; i++)
+		if (entry->name[i] != ascii_tolower(name[i]))
+			return -ENOENT;
+	*pty = entry->type;
+	return 0;
+}
+
+static inline const struct ppal_entry *table_type_to_entry(
+	const struct ppal_table *t, xid_type_t type)
+{
+	const __u32 ty = __be32_to_cpu(type);
+	__u16 slot;
+
+	if (ty >= t->types_n)
+		return NULL;
+	slot = table_by_type(t)[ty];
+	return slot ? &table_entries(t)[slot - 1] : NULL;
+}
+
+/* Unpublish the compiled map, and return it so that the caller can free it
+ * after a grace period. The caller must hold map_lock.
+ */
+static struct ppal_table *drop_table(void)
+{
+	struct ppal_table *t = rcu_dereference_protected(ppal_table,
+		lockdep_is_held(&map_lock));
+	RCU_INIT_POINTER(ppal_table, NULL);
+	return t;
+}
+
+/* Free @t unless it is borrowed. Readers must be done with @t. */
+static void put_table(struct ppal_table *t)
+{
+	if (t && !(t->flags & PPAL_TABLE_BORROWED))
+		myfree(t);
+}
+
+static void free_table(struct ppal_table *t)
+{
+	if (!t)
+		return;
+	synchronize_rcu();
+	put_table(t);
+}
+
+/* ppal_lazy_load - load the map if its loading was deferred. */
+#ifndef HAVE_ARCH_PPAL_LAZY_LOAD
+static inline void ppal_lazy_load(void)
+{
+}
+#endif
+
 int ppal_name_to_type(const char *name, xid_type_t *pty)
 {
+	const struct ppal_table *t;
 	const struct ppal_node *map;
 	int rc = -ENOENT;
 
+	ppal_lazy_load();
 	rcu_read_lock();
+	t = rcu_dereference(ppal_table);
+	if (likely(t)) {
+		rc = table_name_to_type(t, name, pty);
+		goto out;
+	}
+
 	hlist_for_each_entry_rcu(map, head_per_name(name), lst_per_name)
 		if (!strcasecmp(map->name, name)) {
 			*pty = map->type;
@@ -83,16 +301,29 @@ out:
 }
 EXPORT_SYMBOL(ppal_name_to_type);
 
-int ppal_type_to_name(xid_type_t type, char *name)
+/* Copy the name of @type into @name, and return the length of the name. */
+static int __ppal_type_to_name(xid_type_t type, char *name)
 {
+	const struct ppal_table *t;
 	const struct ppal_node *map;
 	int rc = -ENOENT;
 
+	ppal_lazy_load();
 	rcu_read_lock();
+	t = rcu_dereference(ppal_table);
+	if (likely(t)) {
+		const struct ppal_entry *entry = table_type_to_entry(t, type);
+		if (entry) {
+			memcpy(name, entry->name, entry->name_len + 1);
+			rc = entry->name_len;
+		}
+		goto out;
+	}
+
 	hlist_for_each_entry_rcu(map, head_per_type(type), lst_per_type)
 		if (map->type == type) {
-			strcpy(name, map->name);
-			rc = 0;
+			memcpy(name, map->name, map->name_len + 1);
+			rc = map->name_len;
 			goto out;
 		}
 
@@ -100,6 +331,12 @@ out:
 	rcu_read_unlock();
 	return rc;
 }
+
+int ppal_type_to_name(xid_type_t type, char *name)
+{
+	int rc = __ppal_type_to_name(type, name);
+	return rc < 0 ? rc : 0;
+}
 EXPORT_SYMBOL(ppal_type_to_name);
 
 static inline int isname(char ch)
@@ -134,9 +371,54 @@ static inline void lowerstr(char *s)
 	}
 }
 
+/* Fill the lists with the entries of the table if only the table holds
+ * the map. The caller must hold map_lock.
+ */
+static int materialize_table(void)
+{
+	const struct ppal_table *t;
+	__u32 i;
+
+	if (!table_only)
+		return 0;
+
+	t = rcu_dereference_protected(ppal_table, lockdep_is_held(&map_lock));
+	for (i = 0; i < t->entries_n; i++) {
+		const struct ppal_entry *entry = &table_entries(t)[i];
+		struct ppal_node *map = mymalloc(sizeof(*map));
+		if (!map)
+			goto nomem;
+		memcpy(map->name, entry->name, entry->name_len + 1);
+		map->name_len = entry->name_len;
+		map->type = entry->type;
+		hlist_add_head_rcu(&map->lst_per_name,
+			head_per_name(map->name));
+		hlist_add_head_rcu(&map->lst_per_type,
+			head_per_type(map->type));
+	}
+	table_only = 0;
+	return 0;
+
+nomem:
+	/* Lookups use the table, so they don't see the partial lists. */
+	for (i = 0; i < PPAL_MAP_SIZE; i++) {
+		struct hlist_node *pos = ppal_head_per_type[i].first;
+		RCU_INIT_POINTER(ppal_head_per_type[i].first, NULL);
+		RCU_INIT_POINTER(ppal_head_per_name[i].first, NULL);
+		while (pos) {
+			struct ppal_node *map = hlist_entry(pos,
+				struct ppal_node, lst_per_type);
+			pos = pos->next;
+			myfree(map);
+		}
+	}
+	return -ENOMEM;
+}
+
 int ppal_add_map(const char *name, xid_type_t type)
 {
 	struct hlist_head *h_per_name, *h_per_type;
+	struct ppal_table *old_table = NULL;
 	struct ppal_node *map;
 	int rc;
 
@@ -149,8 +431,13 @@ int ppal_add_map(const char *name, xid_type_t type)
 	h_per_name = head_per_name(name);
 	h_per_type = head_per_type(type);
 
+	ppal_lazy_load();
 	spin_lock(&map_lock);
 
+	rc = materialize_table();
+	if (rc)
+		goto out;
+
 	/* Avoid duplicates. */
 	rc = -EEXIST;
 	hlist_for_each_entry(map, h_per_name, lst_per_name)
@@ -168,15 +455,19 @@ int ppal_add_map(const char *name, xid_type_t type)
 	/* It is safe to call strcpy because we validated name before. */
 	strcpy(map->name, name);
 	lowerstr(map->name);
+	map->name_len = strlen(map->name);
 	map->type = type;
 
 	/* Add entry to lists. */
 	hlist_add_head_rcu(&map->lst_per_name, h_per_name);
 	hlist_add_head_rcu(&map->lst_per_type, h_per_type);
+	old_table = drop_table();
+	map_gen++;
 	rc = 0;
 
 out:
 	spin_unlock(&map_lock);
+	free_table(old_table);
 	return rc;
 }
 EXPORT_SYMBOL(ppal_add_map);
@@ -184,26 +475,540 @@ EXPORT_SYMBOL(ppal_add_map);
 int ppal_del_map(xid_type_t type)
 {
 	struct ppal_node *map;
+	int rc;
 
+	ppal_lazy_load();
 	spin_lock(&map_lock);
 
+	rc = materialize_table();
+	if (rc)
+		goto out;
+
+	rc = -ENOENT;
 	hlist_for_each_entry(map, head_per_type(type), lst_per_type)
 		if (map->type == type) {
+			struct ppal_table *old_table = drop_table();
+
 			hlist_del_rcu(&map->lst_per_name);
 			hlist_del_rcu(&map->lst_per_type);
+			map_gen++;
 
 			spin_unlock(&map_lock);
 
 			synchronize_rcu();
+			put_table(old_table);
 			myfree(map);
 			return 0;
 		}
 
+out:
 	spin_unlock(&map_lock);
-	return -ENOENT;
+	return rc;
 }
 EXPORT_SYMBOL(ppal_del_map);
 
+/* Find a displacement for each bucket of @t so that no two names share
+ * a slot. @hashes holds the hash of each of the names in @nodes.
+ *
+ * RETURN
+ *	Zero for success; -1 if two names cannot be told apart with this
+ *	seed.
+ */
+static int build_perfect_hash(struct ppal_table *t,
+	const struct ppal_node **nodes, const __u32 *hashes, __u32 *buckets,
+	__u8 *taken)
+{
+	const __u32 n = t->entries_n;
+	struct ppal_entry *entries = table_entries(t);
+	__u32 *disp = table_disp(t);
+	__u32 i, j, size, max_size = 0, free_slot = 0;
+
+	memset(disp, 0, n * sizeof(*disp));
+	memset(taken, 0, n);
+	/* Count the names per bucket in @buckets. */
+	memset(buckets, 0, n * sizeof(*buckets));
+	for (i = 0; i < n; i++) {
+		__u32 b = ppal_bucket(hashes[i], n);
+		buckets[b]++;
+		if (buckets[b] > max_size)
+			max_size = buckets[b];
+	}
+
+	/* Place the largest buckets first, while most slots are free. */
+	for (size = max_size; size >= 2; size--) {
+		for (j = 0; j < n; j++) {
+			__u32 d, slots[8];
+
+			if (buckets[j] != size)
+				continue;
+			if (size > ARRAY_SIZE(slots))
+				return -1;
+
+			for (d = 1; d < (1U << 16); d++) {
+				__u32 k = 0;
+				for (i = 0; i < n && k < size; i++) {
+					__u32 slot, m;
+					if (ppal_bucket(hashes[i], n) != j)
+						continue;
+					slot = ppal_slot(hashes[i], d, n);
+					if (taken[slot])
+						break;
+					for (m = 0; m < k; m++)
+						if (slots[m] == slot)
+							break;
+					if (m < k)
+						break;
+					slots[k++] = slot;
+				}
+				if (k == size)
+					break;
+			}
+			if (d >= (1U << 16))
+				return -1;
+
+			disp[j] = d;
+			for (i = 0; i < n; i++)
+				if (ppal_bucket(hashes[i], n) == j)
+					taken[ppal_slot(hashes[i], d, n)] = 1;
+		}
+	}
+
+	/* Buckets with a single name take any free slot. */
+	for (j = 0; j < n; j++) {
+		if (buckets[j] != 1)
+			continue;
+		while (taken[free_slot])
+			free_slot++;
+		taken[free_slot] = 1;
+		disp[j] = PPAL_DISP_SLOT | free_slot;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct ppal_entry *entry =
+			&entries[table_find_slot(t, hashes[i])];
+		entry->type = nodes[i]->type;
+		entry->name_len = nodes[i]->name_len;
+		memcpy(entry->name, nodes[i]->name, sizeof(entry->name));
+	}
+	return 0;
+}
+
+/* Seeds to try before giving up on a perfect hash. */
+#define PPAL_SEEDS_MAX	64
+
+/* build_table - compile the @n maps in @nodes into *@pt.
+ *
+ * RETURN
+ *	Zero for success, otherwise a negative number; see ppal_compile_map.
+ */
+static int build_table(const struct ppal_node **nodes, __u32 n,
+	struct ppal_table **pt)
+{
+	struct ppal_table *t = NULL;
+	__u32 *hashes = NULL, *buckets = NULL;
+	__u8 *taken = NULL;
+	__u32 types_n = 0, i, seed;
+	int rc;
+
+	rc = -ERANGE;
+	/* Slots must fit in by_type. */
+	if (n >= 0xffff)
+		goto out;
+	for (i = 0; i < n; i++) {
+		__u32 ty = __be32_to_cpu(nodes[i]->type);
+		if (ty >= PPAL_TABLE_TYPES_MAX)
+			goto out;
+		if (ty >= types_n)
+			types_n = ty + 1;
+	}
+
+	rc = -ENOMEM;
+	t = mymalloc(table_size(n, types_n));
+	hashes = mymalloc((n + 1) * sizeof(*hashes));
+	buckets = mymalloc((n + 1) * sizeof(*buckets));
+	taken = mymalloc(n + 1);
+	if (!t || !hashes || !buckets || !taken)
+		goto out;
+	memset(t, 0, table_size(n, types_n));
+	t->entries_n = n;
+	t->types_n = types_n;
+
+	rc = -ENOSPC;
+	for (seed = 0; seed < PPAL_SEEDS_MAX; seed++) {
+		t->seed = seed;
+		for (i = 0; i < n; i++)
+			hashes[i] = ppal_hash(seed, nodes[i]->name,
+				nodes[i]->name_len);
+		if (!build_perfect_hash(t, nodes, hashes, buckets, taken))
+			break;
+	}
+	if (seed >= PPAL_SEEDS_MAX)
+		goto out;
+
+	for (i = 0; i < n; i++)
+		table_by_type(t)[__be32_to_cpu(nodes[i]->type)] =
+			table_find_slot(t, hashes[i]) + 1;
+
+	*pt = t;
+	t = NULL;
+	rc = 0;
+
+out:
+	myfree(t);
+	myfree(hashes);
+	myfree(buckets);
+	myfree(taken);
+	return rc;
+}
+
+int ppal_compile_map(void)
+{
+	const struct ppal_node **nodes = NULL;
+	struct ppal_node *copies = NULL;
+	struct ppal_table *t, *old_table = NULL;
+	const struct ppal_node *map;
+	__u32 n, size = 0, gen, i;
+	int rc;
+
+	ppal_lazy_load();
+
+	/* The maps are copied under the lock, and the table is built from
+	 * the copies without it.
+	 */
+again:
+	spin_lock(&map_lock);
+
+	/* The table of a table-only map is already compiled. */
+	if (table_only) {
+		spin_unlock(&map_lock);
+		rc = 0;
+		goto out;
+	}
+
+	n = 0;
+	for (i = 0; i < PPAL_MAP_SIZE; i++)
+		hlist_for_each_entry(map, &ppal_head_per_type[i],
+			lst_per_type)
+			n++;
+	if (n > size || !copies) {
+		/* Allocate without the lock, and count again. */
+		spin_unlock(&map_lock);
+		myfree(nodes);
+		myfree(copies);
+		size = n;
+		nodes = mymalloc((size + 1) * sizeof(*nodes));
+		copies = mymalloc((size + 1) * sizeof(*copies));
+		rc = -ENOMEM;
+		if (!nodes || !copies)
+			goto out;
+		goto again;
+	}
+
+	n = 0;
+	for (i = 0; i < PPAL_MAP_SIZE; i++)
+		hlist_for_each_entry(map, &ppal_head_per_type[i],
+			lst_per_type) {
+			copies[n] = *map;
+			nodes[n] = &copies[n];
+			n++;
+		}
+	gen = map_gen;
+	spin_unlock(&map_lock);
+
+	rc = build_table(nodes, n, &t);
+	if (rc)
+		goto out;
+
+	spin_lock(&map_lock);
+	if (map_gen != gen) {
+		/* The map changed while the table was built. */
+		spin_unlock(&map_lock);
+		myfree(t);
+		rc = -EAGAIN;
+		goto out;
+	}
+	old_table = drop_table();
+	rcu_assign_pointer(ppal_table, t);
+	spin_unlock(&map_lock);
+	free_table(old_table);
+
+out:
+	myfree(nodes);
+	myfree(copies);
+	return rc;
+}
+EXPORT_SYMBOL(ppal_compile_map);
+
+/* Return zero if @node can join the first @n nodes of @nodes; otherwise
+ * the error ppal_add_map would return.
+ */
+static int check_new_node(const struct ppal_node *node,
+	const struct ppal_node **nodes, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (nodes[i]->type == node->type ||
+			!strcmp(nodes[i]->name, node->name))
+			return -EEXIST;
+	return 0;
+}
+
+/* Make @new_head the list of @head, and return the old first node.
+ * The caller must hold map_lock.
+ */
+static struct hlist_node *swap_list(struct hlist_head *head,
+	struct hlist_head *new_head)
+{
+	struct hlist_node *old_first = head->first;
+	struct hlist_node *first = new_head->first;
+
+	/* Readers see either the whole old list or the whole new one. */
+	if (first)
+		first->pprev = &head->first;
+	rcu_assign_pointer(head->first, first);
+	return old_first;
+}
+
+int ppal_replace_map(const char * const *names, const xid_type_t *types,
+	int n, int *status)
+{
+	struct hlist_node **old_first;
+	struct hlist_head *heads;
+	const struct ppal_node **nodes;
+	struct ppal_table *t, *old_table;
+	struct ppal_node *map;
+	int i, accepted = 0;
+	int rc;
+
+	old_first = mymalloc(PPAL_MAP_SIZE * sizeof(*old_first));
+	heads = mymalloc(2 * PPAL_MAP_SIZE * sizeof(*heads));
+	nodes = mymalloc((n + 1) * sizeof(*nodes));
+	rc = -ENOMEM;
+	if (!old_first || !heads || !nodes)
+		goto free_nodes;
+
+	/* Build the new map aside. */
+	for (i = 0; i < n; i++) {
+		struct ppal_node *node;
+
+		status[i] = -EINVAL;
+		if (!is_name_valid(names[i]))
+			continue;
+		status[i] = -ENOMEM;
+		node = mymalloc(sizeof(*node));
+		if (!node)
+			continue;
+		strcpy(node->name, names[i]);
+		lowerstr(node->name);
+		node->name_len = strlen(node->name);
+		node->type = types[i];
+
+		status[i] = check_new_node(node, nodes, accepted);
+		if (status[i]) {
+			myfree(node);
+			continue;
+		}
+		nodes[accepted++] = node;
+	}
+
+	/* The lists of the new map go into @heads, which are laid out as
+	 * the heads per name followed by the heads per type.
+	 */
+	for (i = 0; i < 2 * PPAL_MAP_SIZE; i++)
+		INIT_HLIST_HEAD(&heads[i]);
+	for (i = 0; i < accepted; i++) {
+		map = (struct ppal_node *)nodes[i];
+		hlist_add_head(&map->lst_per_name, &heads[
+			head_per_name(map->name) - ppal_head_per_name]);
+		hlist_add_head(&map->lst_per_type, &heads[PPAL_MAP_SIZE +
+			(head_per_type(map->type) - ppal_head_per_type)]);
+	}
+
+	/* A map that cannot be compiled is still installed, and its
+	 * lookups go through its lists; see ppal_compile_map.
+	 */
+	rc = build_table(nodes, accepted, &t);
+	if (rc == -ERANGE || rc == -ENOSPC)
+		t = NULL;
+	else if (rc)
+		goto free_nodes;
+
+	spin_lock(&map_lock);
+
+	/* Lookups only go through the lists if there is no table, so
+	 * a new table makes the switch atomic. Otherwise, each lookup
+	 * walks a single list, which is switched at once.
+	 */
+	old_table = drop_table();
+	if (t)
+		rcu_assign_pointer(ppal_table, t);
+
+	/* Readers walking the old lists finish their walks safely,
+	 * and the old nodes are freed after a grace period.
+	 */
+	for (i = 0; i < PPAL_MAP_SIZE; i++) {
+		swap_list(&ppal_head_per_name[i], &heads[i]);
+		old_first[i] = swap_list(&ppal_head_per_type[i],
+			&heads[PPAL_MAP_SIZE + i]);
+	}
+	table_only = 0;
+	map_gen++;
+
+	spin_unlock(&map_lock);
+
+	synchronize_rcu();
+	put_table(old_table);
+	for (i = 0; i < PPAL_MAP_SIZE; i++) {
+		struct hlist_node *pos = old_first[i];
+		while (pos) {
+			map = hlist_entry(pos, struct ppal_node, lst_per_type);
+			pos = pos->next;
+			myfree(map);
+		}
+	}
+	myfree(old_first);
+	myfree(heads);
+	myfree(nodes);
+	return 0;
+
+free_nodes:
+	for (i = 0; i < accepted; i++)
+		myfree((struct ppal_node *)nodes[i]);
+	myfree(old_first);
+	myfree(heads);
+	myfree(nodes);
+	return rc;
+}
+EXPORT_SYMBOL(ppal_replace_map);
+
+int ppal_export_map(void **pbuf, size_t *plen)
+{
+	const struct ppal_table *t;
+	struct ppal_table *copy = NULL;
+	size_t len = 0, need;
+	int rc;
+
+	rc = ppal_compile_map();
+	if (rc)
+		return rc;
+
+	/* Published tables never change, so a table is copied under
+	 * the read lock alone; the copy is allocated outside of it.
+	 */
+again:
+	rcu_read_lock();
+	rc = -ENOENT;
+	t = rcu_dereference(ppal_table);
+	if (!t)
+		goto out;
+	need = table_size(t->entries_n, t->types_n);
+	if (need != len) {
+		rcu_read_unlock();
+		myfree(copy);
+		len = need;
+		copy = mymalloc(len);
+		if (!copy)
+			return -ENOMEM;
+		goto again;
+	}
+	memcpy(copy, t, len);
+	copy->flags = PPAL_TABLE_BORROWED;
+	*pbuf = copy;
+	*plen = len;
+	copy = NULL;
+	rc = 0;
+
+out:
+	rcu_read_unlock();
+	myfree(copy);
+	return rc;
+}
+EXPORT_SYMBOL(ppal_export_map);
+
+/* Return true if lookups of @t stay inside its @len bytes, and its entries
+ * are valid maps.
+ */
+static int is_table_valid(const struct ppal_table *t, size_t len)
+{
+	__u32 i;
+
+	if (len < sizeof(*t) || t->flags != PPAL_TABLE_BORROWED ||
+		t->entries_n >= 0xffff || t->types_n > PPAL_TABLE_TYPES_MAX ||
+		len != table_size(t->entries_n, t->types_n))
+		return 0;
+
+	for (i = 0; i < t->entries_n; i++) {
+		const struct ppal_entry *entry = &table_entries(t)[i];
+		const __u32 disp = table_disp(t)[i];
+		if (entry->name_len >= MAX_PPAL_NAME_SIZE ||
+			entry->name[entry->name_len] ||
+			!is_name_valid(entry->name) ||
+			__be32_to_cpu(entry->type) >= t->types_n)
+			return 0;
+		if ((disp & PPAL_DISP_SLOT) &&
+			(disp & ~PPAL_DISP_SLOT) >= t->entries_n)
+			return 0;
+	}
+	for (i = 0; i < t->types_n; i++)
+		if (table_by_type(t)[i] > t->entries_n)
+			return 0;
+	return 1;
+}
+
+int ppal_import_map(const void *buf, size_t len)
+{
+	const struct ppal_table *t = buf;
+	int rc, i;
+
+	if (((unsigned long)buf & (sizeof(__u32) - 1)) ||
+		!is_table_valid(t, len))
+		return -EINVAL;
+
+	spin_lock(&map_lock);
+	rc = -EBUSY;
+	if (rcu_dereference_protected(ppal_table, lockdep_is_held(&map_lock)))
+		goto out;
+	for (i = 0; i < PPAL_MAP_SIZE; i++)
+		if (ppal_head_per_type[i].first)
+			goto out;
+
+	rcu_assign_pointer(ppal_table, (struct ppal_table *)t);
+	table_only = 1;
+	map_gen++;
+	rc = 0;
+
+out:
+	spin_unlock(&map_lock);
+	return rc;
+}
+EXPORT_SYMBOL(ppal_import_map);
+
+/* Cache of the last principal looked up, so that batches of addresses,
+ * which tend to repeat principals, skip most lookups.
+ * Batches may not see changes to the map made while they run.
+ */
+struct ppal_cache {
+	xid_type_t	type;
+	/* Zero if the cache is empty. */
+	int		name_len;
+	char		name[MAX_PPAL_NAME_SIZE];
+};
+
+static inline void ppal_cache_init(struct ppal_cache *cache)
+{
+	cache->name_len = 0;
+}
+
+static inline void ppal_cache_set(struct ppal_cache *cache, xid_type_t type,
+	const char *name, int name_len)
+{
+	cache->type = type;
+	cache->name_len = name_len;
+	memcpy(cache->name, name, name_len);
+	cache->name[name_len] = '\0';
+}
+
 /*
  * Validating addresses
  */
@@ -252,52 +1057,273 @@ int xia_are_edges_valid(const struct xia_row *row,
 		bits >>= 8;
 		*pvisited |= 1 << e;
 	}
-	return 0;
+	return 0;
+}
+EXPORT_SYMBOL(xia_are_edges_valid);
+
+int xia_test_addr(const struct xia_addr *addr)
+{
+	int i, n;
+	int saw_nat = 0;
+	__u32 visited = 0;
+
+	/* Test that XIDTYPE_NAT is present only on last rows. */
+	n = XIA_NODES_MAX;
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		xid_type_t ty = addr->s_row[i].s_xid.xid_type;
+		if (saw_nat) {
+			if (!xia_is_nat(ty))
+				return -XIAEADDR_NAT_MISPLACED;
+		} else if (xia_is_nat(ty)) {
+			n = i;
+			saw_nat = 1;
+		}
+	}
+	/* n = number of nodes from here. */
+
+	/* Test edges are well formed. */
+	for (i = 0; i < n; i++) {
+		int rc = xia_are_edges_valid(&addr->s_row[i], i, n, &visited);
+		if (rc)
+			return rc;
+	}
+
+	if (n >= 1) {
+		/* Test entry point is present. Notice that it's just a
+		 * friendlier error since it's also XIAEADDR_MULTI_COMPONENTS.
+		 */
+		__be32 all_edges = addr->s_row[n - 1].s_edge.i;
+		if (__be32_to_raw_cpu(all_edges) == XIA_EMPTY_EDGES)
+			return -XIAEADDR_NO_ENTRY;
+
+		if (visited != ((1U << n) - 1))
+			return -XIAEADDR_MULTI_COMPONENTS;
+	}
+
+	return n;
+}
+EXPORT_SYMBOL(xia_test_addr);
+
+/*
+ * Validating addresses in bulk
+ *
+ * The functions below find the same errors as xia_test_addr(), but test
+ * the four edges of a row at once as the bytes of a 32-bit word instead of
+ * one edge at a time. Each test yields a word with the most significant bit
+ * of each byte set for the edges that fail it, and the error
+ * xia_test_addr() would report first is picked out of these words only
+ * when there is an error, so valid rows take no data-dependent branches
+ * but the loop over their edges in range.
+ *
+ * The words are in host order after __be32_to_cpu(), so the first edge is
+ * the most significant byte.
+ */
+
+#define BYTES_01	0x01010101U
+#define BYTES_7F	0x7f7f7f7fU
+#define BYTES_80	0x80808080U
+
+/* Return the bytes of @v that are zero. The bytes of @v must be < 0x80. */
+static inline __u32 zero_bytes(__u32 v)
+{
+	return ~(v + BYTES_7F) & BYTES_80;
+}
+
+/* Return the bytes of @v that are >= @k. The bytes of @v must be < 0x80,
+ * and @k <= 0x80.
+ */
+static inline __u32 ge_bytes(__u32 v, __u32 k)
+{
+	return (v + (0x80 - k) * BYTES_01) & BYTES_80;
+}
+
+/* Return what xia_are_edges_valid() returns for row @node of an address
+ * with @num_node nodes, and add to *@pvisited the nodes the row points to.
+ * *@pvisited is only meaningful if the row is valid.
+ */
+static inline int edges_error(const struct xia_row *row, int node,
+	int num_node, __u32 *pvisited)
+{
+	const __u32 all_edges = __be32_to_cpu(row->s_edge.i);
+	/* Chosen edges are caught apart, so ignore their bit below. */
+	const __u32 v = all_edges & BYTES_7F;
+	/* Only the last node may have edges pointing backward. */
+	const __u32 first_fwd = node < num_node - 1 ? node + 1 : 0;
+	const __u32 empty = zero_bytes(v ^ BYTES_7F);
+	const __u32 out = ge_bytes(v, num_node) & ~empty;
+	const __u32 in = ~empty & ~out & BYTES_80;
+	const __u32 back = ~ge_bytes(v, first_fwd) & in;
+	__u32 after_empty, errs, first, m, visited = 0;
+
+	/* Edges must point forward, and be in range up to the first empty
+	 * edge; all edges after it must be empty.
+	 */
+	after_empty = empty | (empty >> 8);
+	after_empty |= after_empty >> 16;
+	errs = (out | back) & ~after_empty;
+	if (after_empty != empty) {
+		/* Flag the first empty edge. */
+		errs |= after_empty & ~(after_empty >> 8);
+	}
+
+	/* Rows have few edges, so only visit the ones in range. */
+	for (m = in; m; m &= m - 1) {
+		const int shift = __builtin_ctz(m) - 7;
+		visited |= 1U << ((v >> shift) & 0x1f);
+	}
+	*pvisited |= visited;
+
+	if (unlikely(all_edges & XIA_CHOSEN_EDGES))
+		return -XIAEADDR_CHOSEN_EDGE;
+	if (likely(!errs))
+		return 0;
+	first = 0x80000000U >> __builtin_clz(errs);
+	if (first & out)
+		return -XIAEADDR_EDGE_OUT_RANGE;
+	if (first & back)
+		return -XIAEADDR_NOT_TOPOLOGICAL;
+	return -XIAEADDR_EE_MISPLACED;
+}
+
+static int test_addr_bulk(const struct xia_addr *addr)
+{
+	__u32 nat = 0, visited = 0;
+	int i, n;
+
+	for (i = 0; i < XIA_NODES_MAX; i++)
+		nat |= xia_is_nat(addr->s_row[i].s_xid.xid_type) << i;
+	/* n = number of nodes. */
+	n = __builtin_ctz(nat | (1U << XIA_NODES_MAX));
+	/* XIDTYPE_NAT must be present only on last rows. */
+	if (unlikely(nat != (((1U << XIA_NODES_MAX) - 1) & (~0U << n))))
+		return -XIAEADDR_NAT_MISPLACED;
+	if (unlikely(n < 1))
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		int rc = edges_error(&addr->s_row[i], i, n, &visited);
+		if (unlikely(rc))
+			return rc;
+	}
+
+	if (unlikely(__be32_to_raw_cpu(addr->s_row[n - 1].s_edge.i) ==
+		XIA_EMPTY_EDGES))
+		return -XIAEADDR_NO_ENTRY;
+	if (unlikely(visited != ((1U << n) - 1)))
+		return -XIAEADDR_MULTI_COMPONENTS;
+	return n;
+}
+
+int xia_test_addrs(const struct xia_addr *addrs, int *results, int n)
+{
+	int errors = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		results[i] = test_addr_bulk(&addrs[i]);
+		errors += results[i] < 0;
+	}
+	return errors;
+}
+EXPORT_SYMBOL(xia_test_addrs);
+
+/*
+ * Comparing addresses
+ *
+ * Only the rows before the first XIDTYPE_NAT row belong to an address, and
+ * chosen edges are state of packets in flight, so both are left out.
+ */
+
+/* Return the number of rows of @addr. */
+static inline int addr_rows(const struct xia_addr *addr)
+{
+	int i;
+
+	for (i = 0; i < XIA_NODES_MAX; i++)
+		if (xia_is_nat(addr->s_row[i].s_xid.xid_type))
+			break;
+	return i;
+}
+
+static inline __u32 row_edges(const struct xia_row *row)
+{
+	return __be32_to_raw_cpu(row->s_edge.i) & ~XIA_CHOSEN_EDGES;
+}
+
+static inline __u64 rotl64(__u64 x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+#define FP_K0	0x9e3779b97f4a7c15ULL
+#define FP_K1	0xc2b2ae3d27d4eb4fULL
+#define FP_K2	0x165667b19e3779f9ULL
+
+__u64 xia_addr_fingerprint(const struct xia_addr *addr)
+{
+	__u64 hash = FP_K2;
+	int i;
+
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		const struct xia_row *row = &addr->s_row[i];
+		__u64 w[3], r;
+
+		if (xia_is_nat(row->s_xid.xid_type))
+			break;
+		BUILD_BUG_ON(sizeof(row->s_xid) != sizeof(w));
+		memcpy(w, &row->s_xid, sizeof(w));
+		/* The words of a row are mixed independently, so that only
+		 * one multiply per row is in the dependency chain.
+		 */
+		r = w[0] * FP_K0 ^ rotl64(w[1] * FP_K1, 21) ^
+			rotl64((w[2] ^ row_edges(row)) * FP_K2, 42);
+		hash = rotl64((hash ^ r) * FP_K0, 31);
+	}
+
+	/* The number of rows tells apart addresses that are prefixes of
+	 * each other.
+	 */
+	hash ^= i;
+	hash ^= hash >> 33;
+	hash *= FP_K1;
+	hash ^= hash >> 29;
+	return hash;
 }
-EXPORT_SYMBOL(xia_are_edges_valid);
+EXPORT_SYMBOL(xia_addr_fingerprint);
 
-int xia_test_addr(const struct xia_addr *addr)
+int xia_are_addrs_equal(const struct xia_addr *a, const struct xia_addr *b)
 {
-	int i, n;
-	int saw_nat = 0;
-	__u32 visited = 0;
+	int i;
 
-	/* Test that XIDTYPE_NAT is present only on last rows. */
-	n = XIA_NODES_MAX;
 	for (i = 0; i < XIA_NODES_MAX; i++) {
-		xid_type_t ty = addr->s_row[i].s_xid.xid_type;
-		if (saw_nat) {
-			if (!xia_is_nat(ty))
-				return -XIAEADDR_NAT_MISPLACED;
-		} else if (xia_is_nat(ty)) {
-			n = i;
-			saw_nat = 1;
-		}
-	}
-	/* n = number of nodes from here. */
+		const struct xia_row *ra = &a->s_row[i];
+		const struct xia_row *rb = &b->s_row[i];
+		int nat = xia_is_nat(ra->s_xid.xid_type);
 
-	/* Test edges are well formed. */
-	for (i = 0; i < n; i++) {
-		int rc = xia_are_edges_valid(&addr->s_row[i], i, n, &visited);
-		if (rc)
-			return rc;
+		if (nat != xia_is_nat(rb->s_xid.xid_type))
+			return 0;
+		if (nat)
+			return 1;
+		if (!are_sxids_equal(&ra->s_xid, &rb->s_xid) ||
+			row_edges(ra) != row_edges(rb))
+			return 0;
 	}
+	return 1;
+}
+EXPORT_SYMBOL(xia_are_addrs_equal);
 
-	if (n >= 1) {
-		/* Test entry point is present. Notice that it's just a
-		 * friendlier error since it's also XIAEADDR_MULTI_COMPONENTS.
-		 */
-		__be32 all_edges = addr->s_row[n - 1].s_edge.i;
-		if (__be32_to_raw_cpu(all_edges) == XIA_EMPTY_EDGES)
-			return -XIAEADDR_NO_ENTRY;
+void xia_canonical_addr(struct xia_addr *dst, const struct xia_addr *src)
+{
+	int n = addr_rows(src), i;
 
-		if (visited != ((1U << n) - 1))
-			return -XIAEADDR_MULTI_COMPONENTS;
+	for (i = 0; i < n; i++) {
+		dst->s_row[i].s_xid = src->s_row[i].s_xid;
+		dst->s_row[i].s_edge.i =
+			__raw_cpu_to_be32(row_edges(&src->s_row[i]));
 	}
-
-	return n;
+	memset(&dst->s_row[n], 0, (XIA_NODES_MAX - n) * sizeof(dst->s_row[0]));
 }
-EXPORT_SYMBOL(xia_test_addr);
+EXPORT_SYMBOL(xia_canonical_addr);
 
 /*
  * Printing addresses out
@@ -326,167 +1352,203 @@ static inline int su_ge(signed int s, unsigned int u)
 	return (s >= 0) && ((unsigned int)s >= u);
 }
 
-static inline int add_str(char *dst, size_t dstlen, char *s)
+static inline void move_buf(char **dst, size_t *dstlen, int *tot, int step)
 {
-	int rc = snprintf(dst, dstlen, "%s", s);
-	if (su_ge(rc, dstlen))
-		return -ENOSPC;
-	return rc;
+	(*dst) += step;
+	(*dstlen) -= step;
+	(*tot) += step;
 }
 
-static inline int add_char(char *dst, size_t dstlen, char ch)
+/* id_to_hex - write the XIA_XID_MAX * 2 hexadecimal digits of @id into @dst.
+ * No '\0' is added.
+ */
+#ifdef HAVE_ARCH_ID_TO_HEX
+#define id_to_hex	arch_id_to_hex
+#else
+static void id_to_hex(const __u8 *id, char *dst)
 {
-	if (dstlen <= 1)
-		return -ENOSPC;
-	dst[0] = ch;
-	dst[1] = '\0';
-	return 1;
+	static const char hex_digits[] = "0123456789abcdef";
+	int i;
+
+	for (i = 0; i < XIA_XID_MAX; i++) {
+		*dst++ = hex_digits[id[i] >> 4];
+		*dst++ = hex_digits[id[i] & 0xf];
+	}
 }
+#endif
 
-static inline void move_buf(char **dst, size_t *dstlen, int *tot, int step)
+/* The functions below that don't take the size of @dst, write without
+ * checking for space, and don't add a '\0'. They return the number of
+ * written chars.
+ */
+
+/* @dst must be at least MAX_PPAL_NAME_SIZE large. @cache may be NULL. */
+static int tytop(xid_type_t ty, char *dst, struct ppal_cache *cache)
 {
-	(*dst) += step;
-	(*dstlen) -= step;
-	(*tot) += step;
+	int rc;
+
+	if (cache && cache->name_len && cache->type == ty) {
+		memcpy(dst, cache->name, cache->name_len + 1);
+		return cache->name_len;
+	}
+
+	rc = __ppal_type_to_name(ty, dst);
+	if (rc >= 0) {
+		if (cache)
+			ppal_cache_set(cache, ty, dst, rc);
+		return rc;
+	}
+
+	/* Number format. */
+	BUILD_BUG_ON(sizeof(xid_type_t) != 4);
+	return snprintf(dst, MAX_PPAL_NAME_SIZE, "0x%x", __be32_to_cpu(ty));
 }
 
-static int edges_to_str(int valid, char *dst, size_t dstlen, const __u8 *edges)
+/* @dst must be at least XIA_MAX_STRXID_SIZE large. */
+static int xidtop(const struct xia_xid *src, char *dst,
+	struct ppal_cache *cache)
 {
-	int tot = 0;
-	char *begin = dst;
-	int rc, i;
+	int n = tytop(src->xid_type, dst, cache);
+	dst[n++] = '-';
+	id_to_hex(src->xid_id, dst + n);
+	return n + XIA_XID_MAX * 2;
+}
 
-	rc = add_char(dst, dstlen, '-');
-	if (rc < 0)
-		return rc;
-	move_buf(&dst, &dstlen, &tot, rc);
+/* @dst must be at least 1 + XIA_OUTDEGREE_MAX * 2 large. */
+static int edges_to_str(int valid, char *dst, const __u8 *edges)
+{
+	char *p = dst;
+	int i;
+
+	if (valid && edges[0] == XIA_EMPTY_EDGE)
+		return 0;
 
+	*p++ = '-';
 	for (i = 0; i < XIA_OUTDEGREE_MAX; i++) {
-		if (valid && edges[i] == XIA_EMPTY_EDGE) {
-			if (i == 0) {
-				*begin = '\0';
-				return 0;
-			}
+		if (valid && edges[i] == XIA_EMPTY_EDGE)
 			break;
-		}
-
-		if (is_edge_chosen(edges[i])) {
-			rc = add_char(dst, dstlen, '>');
-			if (rc < 0)
-				return rc;
-			move_buf(&dst, &dstlen, &tot, rc);
-		}
-
-		rc = add_char(dst, dstlen, edge_to_char(edges[i]));
-		if (rc < 0)
-			return rc;
-		move_buf(&dst, &dstlen, &tot, rc);
+		if (is_edge_chosen(edges[i]))
+			*p++ = '>';
+		*p++ = edge_to_char(edges[i]);
 	}
-	return tot;
+	return p - dst;
 }
 
 int xia_tytop(xid_type_t ty, char *dst, size_t dstlen)
 {
 	if (dstlen < MAX_PPAL_NAME_SIZE)
 		return -ENOSPC;
-	if (ppal_type_to_name(ty, dst)) {
-		/* Number format. */
-		int rc = snprintf(dst, dstlen, "0x%x", __be32_to_cpu(ty));
-		BUILD_BUG_ON(sizeof(xid_type_t) != 4);
-		if (su_ge(rc, dstlen))
-			return -ENOSPC;
-		return rc;
-	} else
-		return strlen(dst);
+	return tytop(ty, dst, NULL);
 }
 EXPORT_SYMBOL(xia_tytop);
 
 int xia_idtop(const struct xia_xid *src, char *dst, size_t dstlen)
 {
-	const __be32 *pxid = (const __be32 *)src->xid_id;
-	__u32 a = __be32_to_cpu(pxid[0]);
-	__u32 b = __be32_to_cpu(pxid[1]);
-	__u32 c = __be32_to_cpu(pxid[2]);
-	__u32 d = __be32_to_cpu(pxid[3]);
-	__u32 e = __be32_to_cpu(pxid[4]);
-	int rc;
-
-	BUILD_BUG_ON(XIA_XID_MAX != 20);
-
-	rc = snprintf(dst, dstlen, "%08x%08x%08x%08x%08x", a, b, c, d, e);
-	if (su_ge(rc, dstlen))
+	const int len = XIA_MAX_STRID_SIZE - 1;
+
+	if (unlikely(dstlen < XIA_MAX_STRID_SIZE)) {
+		/* Truncate the string as snprintf() would do. */
+		char buf[XIA_MAX_STRID_SIZE];
+		if (dstlen > 0) {
+			id_to_hex(src->xid_id, buf);
+			memcpy(dst, buf, dstlen - 1);
+			dst[dstlen - 1] = '\0';
+		}
 		return -ENOSPC;
-	return rc;
+	}
+
+	id_to_hex(src->xid_id, dst);
+	dst[len] = '\0';
+	return len;
 }
 EXPORT_SYMBOL(xia_idtop);
 
 int xia_xidtop(const struct xia_xid *src, char *dst, size_t dstlen)
 {
-	int tot = 0;
-	int rc;
-
-	rc = xia_tytop(src->xid_type, dst, dstlen);
-	if (rc < 0)
-		return rc;
-	move_buf(&dst, &dstlen, &tot, rc);
-
-	rc = add_char(dst, dstlen, '-');
-	if (rc < 0)
-		return rc;
-	move_buf(&dst, &dstlen, &tot, rc);
+	char buf[XIA_MAX_STRXID_SIZE];
+	char *p;
+	int n;
 
-	rc = xia_idtop(src, dst, dstlen);
-	if (rc < 0)
-		return rc;
-	move_buf(&dst, &dstlen, &tot, rc);
+	if (dstlen < MAX_PPAL_NAME_SIZE)
+		return -ENOSPC;
 
-	return tot;
+	/* Only use @buf if @dst may be too short. */
+	p = dstlen >= XIA_MAX_STRXID_SIZE ? dst : buf;
+	n = xidtop(src, p, NULL);
+	if (su_ge(n, dstlen))
+		return -ENOSPC;
+	if (p != dst)
+		memcpy(dst, buf, n);
+	dst[n] = '\0';
+	return n;
 }
 EXPORT_SYMBOL(xia_xidtop);
 
-int xia_ntop(const struct xia_addr *src, char *dst, size_t dstlen,
-	int include_nl)
+/* Upper bound of the string of a row, including a node separator before it,
+ * but not the '\0'.
+ */
+#define ROW_STR_MAX (2 + XIA_MAX_STRXID_SIZE - 1 + 1 + XIA_OUTDEGREE_MAX * 2)
+
+static int __xia_ntop(const struct xia_addr *src, char *dst, size_t dstlen,
+	int include_nl, int valid, struct ppal_cache *cache)
 {
+	char buf[ROW_STR_MAX + 1];
 	int tot = 0;
-	char *node_sep = include_nl ? ":\n" : ":";
-	int valid = xia_test_addr(src) >= 1;
-	int rc, i;
+	int i;
+
+	if (dstlen <= 1)
+		return -ENOSPC;
 
 	if (!valid) {
-		rc = add_char(dst, dstlen, '!');
-		if (rc < 0)
-			return rc;
-		move_buf(&dst, &dstlen, &tot, rc);
+		*dst = '!';
+		move_buf(&dst, &dstlen, &tot, 1);
 	}
 
 	for (i = 0; i < XIA_NODES_MAX; i++) {
 		const struct xia_row *row = &src->s_row[i];
+		char *p;
+		int n = 0;
 
 		if (xia_is_nat(row->s_xid.xid_type))
 			break;
 
+		/* Write straight into @dst when any row fits in it. */
+		p = dstlen > ROW_STR_MAX ? dst : buf;
+
 		if (i > 0) {
-			rc = add_str(dst, dstlen, node_sep);
-			if (rc < 0)
-				return rc;
-			move_buf(&dst, &dstlen, &tot, rc);
+			p[n++] = ':';
+			if (include_nl)
+				p[n++] = '\n';
 		}
+		n += xidtop(&row->s_xid, p + n, cache);
+		n += edges_to_str(valid, p + n, row->s_edge.a);
 
-		rc = xia_xidtop(&row->s_xid, dst, dstlen);
-		if (rc < 0)
-			return rc;
-		move_buf(&dst, &dstlen, &tot, rc);
-
-		rc = edges_to_str(valid, dst, dstlen, row->s_edge.a);
-		if (rc < 0)
-			return rc;
-		move_buf(&dst, &dstlen, &tot, rc);
+		if (su_ge(n, dstlen))
+			return -ENOSPC;
+		if (p != dst)
+			memcpy(dst, buf, n);
+		move_buf(&dst, &dstlen, &tot, n);
 	}
 
+	*dst = '\0';
 	return tot;
 }
+
+int xia_ntop(const struct xia_addr *src, char *dst, size_t dstlen,
+	int include_nl)
+{
+	return __xia_ntop(src, dst, dstlen, include_nl,
+		xia_test_addr(src) >= 1, NULL);
+}
 EXPORT_SYMBOL(xia_ntop);
 
+int xia_ntop_trusted(const struct xia_addr *src, char *dst, size_t dstlen,
+	int include_nl)
+{
+	return __xia_ntop(src, dst, dstlen, include_nl, 1, NULL);
+}
+EXPORT_SYMBOL(xia_ntop_trusted);
+
 /*
  * xia_pton and its auxiliares functions
  */
@@ -581,18 +1643,28 @@ static int read_0x(const char **pp, size_t *pleft)
 	return 0;
 }
 
-static int read_type(const char **pp, size_t *pleft, xid_type_t *pty)
+/* @cache may be NULL. */
+static int read_type(const char **pp, size_t *pleft, xid_type_t *pty,
+	struct ppal_cache *cache)
 {
 	if (read_0x(pp, pleft) < 0) {
 		/* It must be a name. */
 		char name[MAX_PPAL_NAME_SIZE];
-		if (read_name(pp, pleft, name, sizeof(name)) < 0)
+		int len = read_name(pp, pleft, name, sizeof(name));
+		if (len < 0)
 			return -1;
+		if (cache && cache->name_len && cache->name_len == len &&
+			!memcmp(cache->name, name, len)) {
+			*pty = cache->type;
+			return 0;
+		}
 		/* One does not need to test if @name is valid here because
 		 * all mapped names are valid.
 		 */
 		if (ppal_name_to_type(name, pty) < 0)
 			return -1;
+		if (cache)
+			ppal_cache_set(cache, *pty, name, len);
 		return 0;
 	}
 
@@ -604,18 +1676,37 @@ static int read_type(const char **pp, size_t *pleft, xid_type_t *pty)
 	return 0;
 }
 
-static int read_xid(const char **pp, size_t *pleft, __u8 *xid)
+/* hex_to_id - decode the XIA_XID_MAX * 2 hexadecimal digits of @src
+ * into @id. It stops at the first invalid char, so it never reads
+ * beyond a '\0'.
+ */
+#ifdef HAVE_ARCH_HEX_TO_ID
+#define hex_to_id	arch_hex_to_id
+#else
+static int hex_to_id(const char *src, __u8 *id)
 {
 	int i;
-	__be32 *pxid = (__be32 *)xid;
-	BUILD_BUG_ON(XIA_XID_MAX != 20);
 
-	for (i = 0; i < 5; i++) {
-		if (read_be32(pp, pleft, pxid++) != 8)
+	for (i = 0; i < XIA_XID_MAX; i++, src += 2) {
+		if (!isxdigit(src[0]) || !isxdigit(src[1]))
 			return -1;
+		id[i] = (ascii_to_int(src[0]) << 4) | ascii_to_int(src[1]);
 	}
 	return 0;
 }
+#endif
+
+static int read_xid(const char **pp, size_t *pleft, __u8 *xid)
+{
+	/* An ID has exactly XIA_XID_MAX * 2 digits. Whatever follows them
+	 * is validated by the caller.
+	 */
+	if (*pleft < XIA_XID_MAX * 2 || hex_to_id(*pp, xid))
+		return -1;
+	(*pp) += XIA_XID_MAX * 2;
+	(*pleft) -= XIA_XID_MAX * 2;
+	return 0;
+}
 
 static int read_edges(const char **pp, size_t *pleft, __u8 *edges,
 	int ignore_ce)
@@ -656,9 +1747,9 @@ static int read_edges(const char **pp, size_t *pleft, __u8 *edges,
 }
 
 static int read_row(const char **pp, size_t *pleft, struct xia_row *row,
-	int ignore_ce)
+	int ignore_ce, struct ppal_cache *cache)
 {
-	if (read_type(pp, pleft, &row->s_xid.xid_type))
+	if (read_type(pp, pleft, &row->s_xid.xid_type, cache))
 		return -1;
 	if (read_sep(pp, pleft, '-'))
 		return -1;
@@ -677,8 +1768,8 @@ static int read_node_sep(const char **pp, size_t *pleft)
 	return 0;
 }
 
-int xia_pton(const char *src, size_t srclen, struct xia_addr *dst,
-	int ignore_ce, int *invalid_flag)
+static int __xia_pton(const char *src, size_t srclen, struct xia_addr *dst,
+	int ignore_ce, int *invalid_flag, struct ppal_cache *cache)
 {
 	const char *p = src;
 	size_t left = srclen;
@@ -690,7 +1781,7 @@ int xia_pton(const char *src, size_t srclen, struct xia_addr *dst,
 		return -1;
 
 	do {
-		if (read_row(&p, &left, &dst->s_row[i], ignore_ce))
+		if (read_row(&p, &left, &dst->s_row[i], ignore_ce, cache))
 			return -1;
 		if (++i >= XIA_NODES_MAX)
 			return -1;
@@ -704,14 +1795,21 @@ int xia_pton(const char *src, size_t srclen, struct xia_addr *dst,
 		return -1;
 	return srclen - left;
 }
+
+int xia_pton(const char *src, size_t srclen, struct xia_addr *dst,
+	int ignore_ce, int *invalid_flag)
+{
+	return __xia_pton(src, srclen, dst, ignore_ce, invalid_flag, NULL);
+}
 EXPORT_SYMBOL(xia_pton);
 
-int xia_ptoxid(const char *src, size_t srclen, struct xia_xid *dst)
+static int __xia_ptoxid(const char *src, size_t srclen, struct xia_xid *dst,
+	struct ppal_cache *cache)
 {
 	const char *p = src;
 	size_t left = srclen;
 
-	if (read_type(&p, &left, &dst->xid_type))
+	if (read_type(&p, &left, &dst->xid_type, cache))
 		return -1;
 	if (read_sep(&p, &left, '-'))
 		return -1;
@@ -723,6 +1821,11 @@ int xia_ptoxid(const char *src, size_t srclen, struct xia_xid *dst)
 		return -1;
 	return srclen - left;
 }
+
+int xia_ptoxid(const char *src, size_t srclen, struct xia_xid *dst)
+{
+	return __xia_ptoxid(src, srclen, dst, NULL);
+}
 EXPORT_SYMBOL(xia_ptoxid);
 
 int xia_ptoid(const char *src, size_t srclen, struct xia_xid *dst)
@@ -739,3 +1842,218 @@ int xia_ptoid(const char *src, size_t srclen, struct xia_xid *dst)
 	return srclen - left;
 }
 EXPORT_SYMBOL(xia_ptoid);
+
+/*
+ * Batch conversions
+ */
+
+static inline int is_rec_fmt_valid(enum xia_rec_fmt fmt)
+{
+	return fmt == XIA_REC_NEWLINE || fmt == XIA_REC_LEN16;
+}
+
+/* Size of the header of a record. */
+static inline size_t rec_hdr_size(enum xia_rec_fmt fmt)
+{
+	return fmt == XIA_REC_LEN16 ? 2 : 0;
+}
+
+/* next_record - find the record at *@pp, and move *@pp beyond the record
+ *	and its delimiter.
+ *
+ * RETURN
+ *	-1 if there is no complete record left.
+ *	Zero otherwise; the record is at *@prec, and has *@preclen chars.
+ */
+static int next_record(const char **pp, size_t *pleft, enum xia_rec_fmt fmt,
+	const char **prec, size_t *preclen)
+{
+	const char *begin = *pp;
+	const char *end = begin + *pleft;
+	const char *p = begin;
+	size_t len, step;
+
+	if (fmt == XIA_REC_LEN16) {
+		if (*pleft < 2)
+			return -1;
+		len = ((__u8)begin[0] << 8) | (__u8)begin[1];
+		if (*pleft - 2 < len)
+			return -1;
+		*prec = begin + 2;
+		step = len + 2;
+		goto out;
+	}
+
+	if (*pleft == 0)
+		return -1;
+	*prec = begin;
+	while (1) {
+		const char *nl = memchr(p, '\n', end - p);
+		if (!nl) {
+			/* The last record may lack its '\n'. */
+			len = step = *pleft;
+			break;
+		}
+		/* A '\n' after a node separator belongs to the address. */
+		if (nl == begin || nl[-1] != ':') {
+			len = nl - begin;
+			step = len + 1;
+			break;
+		}
+		p = nl + 1;
+	}
+
+out:
+	*preclen = len;
+	(*pp) += step;
+	(*pleft) -= step;
+	return 0;
+}
+
+/* end_record - finish the record of @len chars written after the header at
+ *	@dst. There must be room for a char after the record.
+ *
+ * RETURN
+ *	Size of the record, including its header and delimiter.
+ */
+static size_t end_record(char *dst, size_t len, enum xia_rec_fmt fmt)
+{
+	if (fmt == XIA_REC_LEN16) {
+		dst[0] = len >> 8;
+		dst[1] = len & 0xff;
+		return len + 2;
+	}
+	dst[len] = '\n';
+	return len + 1;
+}
+
+int xia_pton_many(const char *src, size_t srclen, enum xia_rec_fmt fmt,
+	struct xia_addr *dst, int *status, int n, int ignore_ce,
+	size_t *pused)
+{
+	struct ppal_cache cache;
+	const char *p = src;
+	size_t left = srclen;
+	int i;
+
+	if (!is_rec_fmt_valid(fmt))
+		return -EINVAL;
+
+	ppal_cache_init(&cache);
+	for (i = 0; i < n; i++) {
+		const char *rec;
+		size_t reclen;
+		int invalid_flag;
+
+		if (next_record(&p, &left, fmt, &rec, &reclen))
+			break;
+		if (__xia_pton(rec, reclen, &dst[i], ignore_ce, &invalid_flag,
+			&cache) < 0)
+			status[i] = -1;
+		else
+			status[i] = invalid_flag;
+	}
+
+	if (pused)
+		*pused = srclen - left;
+	return i;
+}
+EXPORT_SYMBOL(xia_pton_many);
+
+int xia_ptoxid_many(const char *src, size_t srclen, enum xia_rec_fmt fmt,
+	struct xia_xid *dst, int *status, int n, size_t *pused)
+{
+	struct ppal_cache cache;
+	const char *p = src;
+	size_t left = srclen;
+	int i;
+
+	if (!is_rec_fmt_valid(fmt))
+		return -EINVAL;
+
+	ppal_cache_init(&cache);
+	for (i = 0; i < n; i++) {
+		const char *rec;
+		size_t reclen;
+
+		if (next_record(&p, &left, fmt, &rec, &reclen))
+			break;
+		status[i] = __xia_ptoxid(rec, reclen, &dst[i], &cache) < 0 ?
+			-1 : 0;
+	}
+
+	if (pused)
+		*pused = srclen - left;
+	return i;
+}
+EXPORT_SYMBOL(xia_ptoxid_many);
+
+int xia_ntop_many(const struct xia_addr *src, int n, enum xia_rec_fmt fmt,
+	char *dst, size_t dstlen, int include_nl, size_t *pused)
+{
+	const size_t hdr = rec_hdr_size(fmt);
+	struct ppal_cache cache;
+	char *p = dst;
+	size_t left = dstlen;
+	int i;
+
+	if (!is_rec_fmt_valid(fmt))
+		return -EINVAL;
+
+	ppal_cache_init(&cache);
+	for (i = 0; i < n && left > hdr; i++) {
+		/* __xia_ntop() reserves room for a '\0' after the record,
+		 * which end_record() may use.
+		 */
+		int rc = __xia_ntop(&src[i], p + hdr, left - hdr, include_nl,
+			xia_test_addr(&src[i]) >= 1, &cache);
+		size_t step;
+
+		if (rc < 0)
+			break;
+		step = end_record(p, rc, fmt);
+		p += step;
+		left -= step;
+	}
+
+	if (pused)
+		*pused = dstlen - left;
+	return i;
+}
+EXPORT_SYMBOL(xia_ntop_many);
+
+int xia_xidtop_many(const struct xia_xid *src, int n, enum xia_rec_fmt fmt,
+	char *dst, size_t dstlen, size_t *pused)
+{
+	const size_t hdr = rec_hdr_size(fmt);
+	struct ppal_cache cache;
+	char buf[XIA_MAX_STRXID_SIZE];
+	char *p = dst;
+	size_t left = dstlen;
+	int i;
+
+	if (!is_rec_fmt_valid(fmt))
+		return -EINVAL;
+
+	ppal_cache_init(&cache);
+	for (i = 0; i < n && left > hdr; i++) {
+		/* Write straight into @dst when any XID fits in it. */
+		char *q = left - hdr >= XIA_MAX_STRXID_SIZE ? p + hdr : buf;
+		int rc = xidtop(&src[i], q, &cache);
+		size_t step;
+
+		/* Leave room for a char after the record as xia_ntop_many. */
+		if (su_ge(rc, left - hdr))
+			break;
+		if (q != p + hdr)
+			memcpy(p + hdr, buf, rc);
+		step = end_record(p, rc, fmt);
+		p += step;
+		left -= step;
+	}
+
+	if (pused)
+		*pused = dstlen - left;
+	return i;
+}
+EXPORT_SYMBOL(xia_xidtop_many);
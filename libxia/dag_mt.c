@@ -0,0 +1,67 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include <net/xia_dag.h>
+
+#include "dag_mt.h"
+
+/* Minimum number of addresses that makes a thread worthwhile. */
+#define MIN_ADDRS_PER_THREAD	4096
+
+struct test_job {
+	pthread_t			thread;
+	int				started;
+	const struct xia_addr		*addrs;
+	int				*results;
+	int				n;
+	int				errors;
+};
+
+static void *run_test_job(void *arg)
+{
+	struct test_job *job = arg;
+	job->errors = xia_test_addrs(job->addrs, job->results, job->n);
+	return NULL;
+}
+
+int xia_test_addrs_mt(const struct xia_addr *addrs, int *results, int n,
+	int nthreads)
+{
+	struct test_job *jobs;
+	int i, errors, per_job, first;
+
+	if (nthreads > n / MIN_ADDRS_PER_THREAD)
+		nthreads = n / MIN_ADDRS_PER_THREAD;
+	if (nthreads <= 1)
+		return xia_test_addrs(addrs, results, n);
+
+	jobs = calloc(nthreads, sizeof(*jobs));
+	if (!jobs)
+		return xia_test_addrs(addrs, results, n);
+
+	per_job = n / nthreads;
+	for (i = 0, first = 0; i < nthreads; i++, first += per_job) {
+		struct test_job *job = &jobs[i];
+		job->addrs = addrs + first;
+		job->results = results + first;
+		/* The last job takes the remainder. */
+		job->n = i < nthreads - 1 ? per_job : n - first;
+	}
+
+	/* The calling thread runs the first job. */
+	for (i = 1; i < nthreads; i++)
+		jobs[i].started = !pthread_create(&jobs[i].thread, NULL,
+			run_test_job, &jobs[i]);
+	run_test_job(&jobs[0]);
+
+	errors = jobs[0].errors;
+	for (i = 1; i < nthreads; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		else
+			run_test_job(&jobs[i]);
+		errors += jobs[i].errors;
+	}
+
+	free(jobs);
+	return errors;
+}
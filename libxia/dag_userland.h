@@ -13,8 +13,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <asm-generic/errno-base.h>
 
+#include "urcu.h"
+
+#define WRITE_ONCE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+#define __rcu
+#define rcu_dereference(p)	__atomic_load_n(&(p), __ATOMIC_CONSUME)
+#define rcu_dereference_protected(p, c)	(p)
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+#define RCU_INIT_POINTER(p, v)	WRITE_ONCE(p, v)
+
 struct hlist_head {
 	struct hlist_node *first;
 };
@@ -23,6 +34,8 @@ struct hlist_node {
 	struct hlist_node *next, **pprev;
 };
 
+#define INIT_HLIST_HEAD(ptr)	((ptr)->first = NULL)
+
 #undef offsetof
 #ifdef __compiler_offsetof
 #define offsetof(TYPE, MEMBER) __compiler_offsetof(TYPE, MEMBER)
@@ -45,7 +58,12 @@ struct hlist_node {
 	for (pos = hlist_entry_safe((head)->first, typeof(*(pos)), member);\
 	     pos;							\
 	     pos = hlist_entry_safe((pos)->member.next, typeof(*(pos)), member))
-#define hlist_for_each_entry_rcu	hlist_for_each_entry
+#define hlist_for_each_entry_rcu(pos, head, member)			\
+	for (pos = hlist_entry_safe(rcu_dereference((head)->first),	\
+		typeof(*(pos)), member);				\
+	     pos;							\
+	     pos = hlist_entry_safe(rcu_dereference((pos)->member.next),\
+		typeof(*(pos)), member))
 
 static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
 {
@@ -56,13 +74,23 @@ static inline void hlist_add_head(struct hlist_node *n, struct hlist_head *h)
 	h->first = n;
 	n->pprev = &h->first;
 }
-#define hlist_add_head_rcu	hlist_add_head
+
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+	struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+	n->next = first;
+	n->pprev = &h->first;
+	rcu_assign_pointer(h->first, n);
+	if (first)
+		first->pprev = &n->next;
+}
 
 static inline void __hlist_del(struct hlist_node *n)
 {
 	struct hlist_node *next = n->next;
 	struct hlist_node **pprev = n->pprev;
-	*pprev = next;
+	WRITE_ONCE(*pprev, next);
 	if (next)
 		next->pprev = pprev;
 }
@@ -75,7 +103,13 @@ static inline void hlist_del(struct hlist_node *n)
 	n->next = LIST_POISON1;
 	n->pprev = LIST_POISON2;
 }
-#define hlist_del_rcu		hlist_del
+
+/* Readers may still be on @n, so n->next is left alone. */
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+	__hlist_del(n);
+	n->pprev = LIST_POISON2;
+}
 
 #define mymalloc(n)	malloc(n)
 #define myfree(p)	free(p)
@@ -88,14 +122,37 @@ static inline void hlist_del(struct hlist_node *n)
 
 #define EXPORT_SYMBOL(x)
 
-#define spin_lock(x)
-#define spin_unlock(x)
+/* Writers serialize on a mutex. */
+#define DEFINE_SPINLOCK(x)	pthread_mutex_t x = PTHREAD_MUTEX_INITIALIZER
+#define spin_lock(x)		pthread_mutex_lock(x)
+#define spin_unlock(x)		pthread_mutex_unlock(x)
 
-static inline void rcu_read_lock(void)		{ }
-static inline void rcu_read_unlock(void)	{ }
-static inline void synchronize_rcu(void)	{ }
+/* Readers use the userland RCU of urcu.c. */
+#define rcu_read_lock		xia_rcu_read_lock
+#define rcu_read_unlock		xia_rcu_read_unlock
+#define synchronize_rcu		xia_synchronize_rcu
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
 #define likely(b) (b)
 #define unlikely(b) (b)
 
+/* Principal maps are loaded on their first use; see ppal_map.c. */
+extern char *xia_ppal_pending_file;
+void xia_ppal_load_pending(void);
+#define HAVE_ARCH_PPAL_LAZY_LOAD
+static inline void ppal_lazy_load(void)
+{
+	if (unlikely(__atomic_load_n(&xia_ppal_pending_file,
+		__ATOMIC_ACQUIRE)))
+		xia_ppal_load_pending();
+}
+
+/* Vectorized conversions of IDs. */
+#include "xid_hex.h"
+#define HAVE_ARCH_HEX_TO_ID
+#define arch_hex_to_id	xia_hex_to_id
+#define HAVE_ARCH_ID_TO_HEX
+#define arch_id_to_hex	xia_id_to_hex
+
 #endif /* __KERNEL__ */
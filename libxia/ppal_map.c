@@ -1,6 +1,15 @@
 #include <stdio.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <linux/types.h>
 #include <asm-generic/errno-base.h>
 #include <asm/byteorder.h>
@@ -8,15 +17,15 @@
 
 #include "ppal_map.h"
 
-static void add_map(const char *name, xid_type_t type)
+static void warn_map(const char *name, xid_type_t type, int rc)
 {
-	int rc = ppal_add_map(name, type);
 	switch (rc) {
 	case -EINVAL:
 		fprintf(stderr, "Warning: ignoring invalid principal name "
 			"or type '%s'(%x)\n", name, __be32_to_cpu(type));
 		break;
 	case -ESRCH:
+	case -EEXIST:
 		fprintf(stderr, "Warning: ignoring duplicated "
 			"principal '%s'(%x)\n",	name, type);
 		break;
@@ -32,6 +41,12 @@ static void add_map(const char *name, xid_type_t type)
 	}
 }
 
+static void add_map(const char *name, xid_type_t type, void *arg)
+{
+	(void)arg;
+	warn_map(name, type, ppal_add_map(name, type));
+}
+
 static int is_blank(const char *str)
 {
 	while (isspace(*str))
@@ -42,7 +57,10 @@ static int is_blank(const char *str)
 }
 
 #define BUF_SIZE 256
-static int load_ppal_map(const char *ppal_file)
+
+/* Call @fn for each principal in @ppal_file. */
+static int parse_ppal_map(const char *ppal_file,
+	void (*fn)(const char *name, xid_type_t type, void *arg), void *arg)
 {
 	FILE *f;
 	/* buf and name must have the same size to properly handle cases like
@@ -86,17 +104,356 @@ static int load_ppal_map(const char *ppal_file)
 			continue;
 		}
 
-		add_map(name, __cpu_to_be32(cpu_ty));
+		fn(name, __cpu_to_be32(cpu_ty), arg);
 	}
 	fclose(f);
 	return 0;
 }
 
+#define DEFAULT_PPAL_FILE	"/etc/xia/principals"
+
+/* Identity of the last file loaded, to skip reloads of unchanged files. */
+static int loaded;
+static struct stat loaded_st;
+
+static int is_file_loaded(const struct stat *st)
+{
+	return loaded && st->st_dev == loaded_st.st_dev &&
+		st->st_ino == loaded_st.st_ino &&
+		st->st_size == loaded_st.st_size &&
+		st->st_mtim.tv_sec == loaded_st.st_mtim.tv_sec &&
+		st->st_mtim.tv_nsec == loaded_st.st_mtim.tv_nsec;
+}
+
+/*
+ * Binary cache of the map
+ *
+ * When the environment variable XIA_PPAL_CACHE_DIR names a directory,
+ * the compiled map of a principal file is saved there, so that later
+ * processes map it instead of parsing the file and allocating the map.
+ * A cache only serves the file, identified by its inode, with the size
+ * and the modification and status change times that it was saved for;
+ * unlike the modification time, the status change time cannot be set
+ * back, so an edited file never passes for the old one.
+ */
+
+#define CACHE_DIR_ENV	"XIA_PPAL_CACHE_DIR"
+#define CACHE_MAGIC	0x43505058	/* "XPPC" in little endian. */
+#define CACHE_VERSION	2
+
+struct ppal_cache_hdr {
+	__u32	magic;
+	__u32	version;
+	__u64	file_dev;
+	__u64	file_ino;
+	__u64	file_size;
+	__s64	file_mtime_sec;
+	__s64	file_mtime_nsec;
+	__s64	file_ctime_sec;
+	__s64	file_ctime_nsec;
+	/* Length of the buffer of ppal_export_map that follows. */
+	__u64	map_len;
+};
+
+static __u64 fnv1a64(const char *str)
+{
+	__u64 hash = 14695981039346656037ULL;
+
+	for (; *str; str++)
+		hash = (hash ^ (__u8)*str) * 1099511628211ULL;
+	return hash;
+}
+
+static void init_cache_hdr(struct ppal_cache_hdr *hdr, const struct stat *st)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = CACHE_MAGIC;
+	hdr->version = CACHE_VERSION;
+	hdr->file_dev = st->st_dev;
+	hdr->file_ino = st->st_ino;
+	hdr->file_size = st->st_size;
+	hdr->file_mtime_sec = st->st_mtim.tv_sec;
+	hdr->file_mtime_nsec = st->st_mtim.tv_nsec;
+	hdr->file_ctime_sec = st->st_ctim.tv_sec;
+	hdr->file_ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+/* The cache of @ppal_file is named after the hash of its absolute path. */
+static int get_cache_name(const char *ppal_file, char *name, size_t size)
+{
+	const char *dir = getenv(CACHE_DIR_ENV);
+	char path[PATH_MAX];
+	int len;
+
+	if (!dir || !*dir)
+		return -1;
+	if (!realpath(ppal_file, path))
+		return -1;
+	len = snprintf(name, size, "%s/principals-%016llx.cache", dir,
+		(unsigned long long)fnv1a64(path));
+	return len < 0 || (size_t)len >= size ? -1 : 0;
+}
+
+/* Use the cache of @ppal_file as the map if it matches @expected. */
+static int load_cache(const char *ppal_file,
+	const struct ppal_cache_hdr *expected)
+{
+	const struct ppal_cache_hdr *hdr;
+	char cache_file[PATH_MAX];
+	struct stat st;
+	void *map;
+	int fd, rc;
+
+	if (get_cache_name(ppal_file, cache_file, sizeof(cache_file)))
+		return -1;
+	fd = open(cache_file, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -1;
+
+	hdr = map;
+	rc = -1;
+	if (memcmp(hdr, expected, offsetof(struct ppal_cache_hdr, map_len)) ||
+		hdr->map_len != st.st_size - sizeof(*hdr))
+		goto out;
+	/* On success, the map uses the mapping for the life of the process. */
+	rc = ppal_import_map(hdr + 1, hdr->map_len);
+
+out:
+	if (rc)
+		munmap(map, st.st_size);
+	return rc;
+}
+
+/* Save the compiled map as the cache of @ppal_file.
+ * Failures are silent since the cache directory may be read-only to
+ * the process; they only cost the next processes a parse.
+ */
+static void save_cache(const char *ppal_file, struct ppal_cache_hdr *hdr)
+{
+	char cache_file[PATH_MAX], tmp_file[PATH_MAX];
+	void *buf;
+	size_t len;
+	int fd, ok;
+
+	if (get_cache_name(ppal_file, cache_file, sizeof(cache_file)) ||
+		snprintf(tmp_file, sizeof(tmp_file), "%s.XXXXXX",
+			cache_file) >= (int)sizeof(tmp_file))
+		return;
+	if (ppal_export_map(&buf, &len))
+		return;
+	hdr->map_len = len;
+
+	/* Readers only ever see a complete cache. */
+	fd = mkstemp(tmp_file);
+	if (fd < 0) {
+		free(buf);
+		return;
+	}
+	ok = write(fd, hdr, sizeof(*hdr)) == sizeof(*hdr) &&
+		write(fd, buf, len) == (ssize_t)len &&
+		!fchmod(fd, 0644);
+	ok = !close(fd) && ok && !rename(tmp_file, cache_file);
+	if (!ok)
+		unlink(tmp_file);
+	free(buf);
+}
+
+static int load_ppal_map(const char *ppal_file)
+{
+	struct ppal_cache_hdr hdr;
+	struct stat st;
+	int rc;
+
+	if (stat(ppal_file, &st)) {
+		fprintf(stderr, "Warning: couldn't read file: %s\n", ppal_file);
+		return -1;
+	}
+	init_cache_hdr(&hdr, &st);
+	if (!load_cache(ppal_file, &hdr))
+		goto loaded;
+
+	rc = parse_ppal_map(ppal_file, add_map, NULL);
+	if (rc)
+		return rc;
+
+	/* Lookups fall back to the lists of the map if it fails. */
+	rc = ppal_compile_map();
+	if (rc)
+		fprintf(stderr, "Warning: couldn't compile principal map "
+			"of %s (%i)\n", ppal_file, rc);
+	else
+		save_cache(ppal_file, &hdr);
+
+loaded:
+	loaded = 1;
+	loaded_st = st;
+	return 0;
+}
+
+/*
+ * Deferred loading
+ *
+ * init_ppal_map only records the file, and the first use of the map loads
+ * it; see ppal_lazy_load() in dag_userland.h.
+ */
+
+char *xia_ppal_pending_file;
+static pthread_mutex_t pending_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Loading the pending file uses the map, which must not wait for itself. */
+static __thread int loading_pending;
+
+void xia_ppal_load_pending(void)
+{
+	char *file;
+
+	if (loading_pending)
+		return;
+
+	pthread_mutex_lock(&pending_lock);
+	file = xia_ppal_pending_file;
+	if (file) {
+		loading_pending = 1;
+		load_ppal_map(file);
+		loading_pending = 0;
+		__atomic_store_n(&xia_ppal_pending_file, NULL,
+			__ATOMIC_RELEASE);
+		free(file);
+	}
+	pthread_mutex_unlock(&pending_lock);
+}
+
+static void cancel_pending_load(void)
+{
+	char *file;
+
+	pthread_mutex_lock(&pending_lock);
+	file = xia_ppal_pending_file;
+	__atomic_store_n(&xia_ppal_pending_file, NULL, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&pending_lock);
+	free(file);
+}
+
+/* Principals read by reload_ppal_map. */
+struct ppal_list {
+	char	(*names)[MAX_PPAL_NAME_SIZE];
+	xid_type_t *types;
+	int	n;
+	int	size;
+	int	enomem;
+};
+
+static void list_map(const char *name, xid_type_t type, void *arg)
+{
+	struct ppal_list *list = arg;
+
+	if (list->n == list->size) {
+		int size = list->size ? list->size * 2 : 64;
+		void *names = realloc(list->names,
+			size * sizeof(*list->names));
+		void *types;
+		if (names)
+			list->names = names;
+		types = realloc(list->types, size * sizeof(*list->types));
+		if (types)
+			list->types = types;
+		if (!names || !types) {
+			list->enomem = 1;
+			return;
+		}
+		list->size = size;
+	}
+
+	/* Invalid names are reported by ppal_replace_map. */
+	if (strlen(name) >= MAX_PPAL_NAME_SIZE) {
+		warn_map(name, type, -EINVAL);
+		return;
+	}
+	strcpy(list->names[list->n], name);
+	list->types[list->n] = type;
+	list->n++;
+}
+
+int reload_ppal_map(const char *ppal_file)
+{
+	struct ppal_list list = {NULL, NULL, 0, 0, 0};
+	const char **names = NULL;
+	int *status = NULL;
+	struct stat st;
+	int i, rc;
+
+	if (!ppal_file)
+		ppal_file = DEFAULT_PPAL_FILE;
+	/* This reload supersedes any deferred load. */
+	cancel_pending_load();
+	if (stat(ppal_file, &st)) {
+		fprintf(stderr, "Warning: couldn't read file: %s\n", ppal_file);
+		return -1;
+	}
+	if (is_file_loaded(&st))
+		return 0;
+
+	rc = parse_ppal_map(ppal_file, list_map, &list);
+	if (rc)
+		goto out;
+	rc = -ENOMEM;
+	if (list.enomem)
+		goto out;
+	names = malloc((list.n + 1) * sizeof(*names));
+	status = malloc((list.n + 1) * sizeof(*status));
+	if (!names || !status)
+		goto out;
+	for (i = 0; i < list.n; i++)
+		names[i] = list.names[i];
+
+	rc = ppal_replace_map(names, list.types, list.n, status);
+	if (rc) {
+		fprintf(stderr, "Warning: couldn't reload principal map "
+			"of %s (%i)\n", ppal_file, rc);
+		goto out;
+	}
+	for (i = 0; i < list.n; i++)
+		warn_map(names[i], list.types[i], status[i]);
+	loaded = 1;
+	loaded_st = st;
+
+out:
+	free(names);
+	free(status);
+	free(list.names);
+	free(list.types);
+	return rc;
+}
+
 int init_ppal_map(const char *ppal_file)
 {
+	char *file;
+	int fd;
+
 	if (!ppal_file)
-		ppal_file = "/etc/xia/principals";
-	return load_ppal_map(ppal_file);
+		ppal_file = DEFAULT_PPAL_FILE;
+	if (loaded || xia_ppal_pending_file)
+		return reload_ppal_map(ppal_file);
+
+	/* Report now that the file cannot be loaded, as a load would. */
+	fd = open(ppal_file, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Warning: couldn't read file: %s\n", ppal_file);
+		return -1;
+	}
+	close(fd);
+	file = strdup(ppal_file);
+	if (!file)
+		return -ENOMEM;
+	__atomic_store_n(&xia_ppal_pending_file, file, __ATOMIC_RELEASE);
+	return 0;
 }
 
 void print_xia_addr(const struct xia_addr *addr)
@@ -0,0 +1,161 @@
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#ifdef __NR_membarrier
+#include <linux/membarrier.h>
+#endif
+
+#include "urcu.h"
+
+/*
+ * Each thread has a counter that is non-zero while the thread is in
+ * a read-side critical section. When a thread enters its outermost
+ * section, it copies the global counter, which carries the phase of
+ * the current grace period. A grace period flips the phase twice, and
+ * each time waits for the readers that still carry the old phase; readers
+ * that began afterwards don't hold it up.
+ *
+ * Ordering readers' accesses to their counters against their accesses to
+ * the protected data needs a full barrier on both sides. When the kernel
+ * supports membarrier(2), writers issue it on behalf of all threads, and
+ * readers only need a compiler barrier.
+ */
+
+#define NEST_MASK	0xffffUL
+#define NEST_ONE	1UL
+#define PHASE		(NEST_MASK + 1)
+
+struct rcu_reader {
+	unsigned long		ctr;
+	int			registered;
+	struct rcu_reader	*next;
+	struct rcu_reader	**pprev;
+};
+
+static unsigned long gp_ctr = NEST_ONE;
+/* Serializes grace periods, and protects @readers. */
+static pthread_mutex_t gp_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct rcu_reader *readers;
+
+static pthread_key_t reader_key;
+static pthread_once_t reader_key_once = PTHREAD_ONCE_INIT;
+static __thread struct rcu_reader self
+	__attribute__((tls_model("initial-exec")));
+
+static int has_membarrier;
+
+__attribute__((constructor))
+static void init_membarrier(void)
+{
+#ifdef __NR_membarrier
+	has_membarrier = !syscall(__NR_membarrier,
+		MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0);
+#endif
+}
+
+static inline void reader_barrier(void)
+{
+	if (has_membarrier)
+		__atomic_signal_fence(__ATOMIC_SEQ_CST);
+	else
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/* Act as a full barrier on all threads. */
+static void writer_barrier(void)
+{
+#ifdef __NR_membarrier
+	if (has_membarrier) {
+		syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+		return;
+	}
+#endif
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void unregister_reader(void *arg)
+{
+	struct rcu_reader *r = arg;
+
+	pthread_mutex_lock(&gp_lock);
+	*r->pprev = r->next;
+	if (r->next)
+		r->next->pprev = r->pprev;
+	pthread_mutex_unlock(&gp_lock);
+}
+
+static void create_reader_key(void)
+{
+	pthread_key_create(&reader_key, unregister_reader);
+}
+
+static void register_reader(void)
+{
+	/* The key unregisters the thread when it exits. */
+	pthread_once(&reader_key_once, create_reader_key);
+	pthread_setspecific(reader_key, &self);
+
+	pthread_mutex_lock(&gp_lock);
+	self.next = readers;
+	if (readers)
+		readers->pprev = &self.next;
+	readers = &self;
+	self.pprev = &readers;
+	pthread_mutex_unlock(&gp_lock);
+	self.registered = 1;
+}
+
+void xia_rcu_read_lock(void)
+{
+	unsigned long ctr;
+
+	if (__builtin_expect(!self.registered, 0))
+		register_reader();
+
+	ctr = self.ctr;
+	if (ctr & NEST_MASK) {
+		__atomic_store_n(&self.ctr, ctr + NEST_ONE, __ATOMIC_RELAXED);
+		return;
+	}
+	__atomic_store_n(&self.ctr, __atomic_load_n(&gp_ctr, __ATOMIC_RELAXED),
+		__ATOMIC_RELAXED);
+	reader_barrier();
+}
+
+void xia_rcu_read_unlock(void)
+{
+	reader_barrier();
+	__atomic_store_n(&self.ctr, self.ctr - NEST_ONE, __ATOMIC_RELAXED);
+}
+
+/* Is @r in a section that began before the last flip of the phase? */
+static int is_reader_old(const struct rcu_reader *r)
+{
+	unsigned long ctr = __atomic_load_n(&r->ctr, __ATOMIC_RELAXED);
+	return (ctr & NEST_MASK) && ((ctr ^ gp_ctr) & PHASE);
+}
+
+static void flip_and_wait(void)
+{
+	const struct rcu_reader *r;
+
+	__atomic_store_n(&gp_ctr, gp_ctr ^ PHASE, __ATOMIC_RELAXED);
+	writer_barrier();
+	for (r = readers; r; r = r->next)
+		while (is_reader_old(r))
+			sched_yield();
+}
+
+void xia_synchronize_rcu(void)
+{
+	pthread_mutex_lock(&gp_lock);
+	writer_barrier();
+	/* A single flip is not enough: a reader may have read the old
+	 * phase before the flip, but not have stored it yet.
+	 */
+	flip_and_wait();
+	flip_and_wait();
+	writer_barrier();
+	pthread_mutex_unlock(&gp_lock);
+}
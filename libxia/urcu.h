@@ -0,0 +1,25 @@
+#ifndef HEADER_URCU_H
+#define HEADER_URCU_H
+
+/* Userland read-copy-update for the principal map of dag.c.
+ *
+ * Readers never block nor spin, but for the first read-side critical
+ * section of each thread, which registers the thread. Read-side critical
+ * sections may nest.
+ */
+
+/* xia_rcu_read_lock - begin a read-side critical section. */
+void xia_rcu_read_lock(void);
+
+/* xia_rcu_read_unlock - end a read-side critical section. */
+void xia_rcu_read_unlock(void);
+
+/* xia_synchronize_rcu - wait until all read-side critical sections that
+ *	began before this call have ended.
+ *
+ * NOTES
+ *	It must not be called from a read-side critical section.
+ */
+void xia_synchronize_rcu(void);
+
+#endif /* HEADER_URCU_H */
@@ -0,0 +1,320 @@
+#include <stdint.h>
+#include <string.h>
+#include <asm-generic/errno-base.h>
+#include <net/xia.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XID_HEX_X86
+#endif
+
+#include "xid_hex.h"
+
+#define ID_DIGITS	(XIA_XID_MAX * 2)
+
+/* Loads of ID_DIGITS bytes that don't cross a page boundary cannot fault
+ * as long as the first byte is readable.
+ */
+#define MIN_PAGE_SIZE	4096
+static inline int is_load_safe(const char *src)
+{
+	return ((uintptr_t)src & (MIN_PAGE_SIZE - 1)) <=
+		MIN_PAGE_SIZE - ID_DIGITS;
+}
+
+/*
+ * Scalar implementation
+ */
+
+/* One plus the value of each hexadecimal digit; zero marks chars that are
+ * not digits.
+ */
+static const __u8 hex_value[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static int hex_to_id_scalar(const char *src, __u8 *id)
+{
+	const __u8 *p = (const __u8 *)src;
+	int i;
+
+	for (i = 0; i < XIA_XID_MAX; i++, p += 2) {
+		__u8 hi = hex_value[p[0]];
+		__u8 lo;
+
+		/* Testing @hi first avoids reading beyond a '\0'. */
+		if (!hi)
+			return -1;
+		lo = hex_value[p[1]];
+		if (!lo)
+			return -1;
+		id[i] = ((hi - 1) << 4) | (lo - 1);
+	}
+	return 0;
+}
+
+static void id_to_hex_scalar(const __u8 *id, char *dst)
+{
+	static const char hex_digits[] = "0123456789abcdef";
+	int i;
+
+	for (i = 0; i < XIA_XID_MAX; i++) {
+		*dst++ = hex_digits[id[i] >> 4];
+		*dst++ = hex_digits[id[i] & 0xf];
+	}
+}
+
+#ifdef XID_HEX_X86
+
+/*
+ * SSE2 implementation
+ *
+ * Each 16-byte block of digits is validated and converted to nibbles with
+ * a few comparisons, and pairs of nibbles are merged into the 8 bytes
+ * they encode. The ID is covered by the blocks starting at digits 0, 16,
+ * and 24; the last block overlaps the second one to avoid reading beyond
+ * the ID.
+ */
+
+/* Return the nibbles of the 16 digits in @v, and set *@pvalid to
+ * a mask with the valid digits.
+ */
+__attribute__((target("sse2")))
+static inline __m128i sse2_nibbles(__m128i v, int *pvalid)
+{
+	const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	/* Signed comparisons reject any char equal or above 0x80. */
+	const __m128i is_digit = _mm_and_si128(
+		_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+	const __m128i is_alpha = _mm_and_si128(
+		_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+	*pvalid = _mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha));
+	return _mm_or_si128(
+		_mm_and_si128(is_digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+		_mm_and_si128(is_alpha,
+			_mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+}
+
+/* Merge the 16 nibbles in @n into 8 bytes held in 16-bit lanes. */
+__attribute__((target("sse2")))
+static inline __m128i sse2_merge(__m128i n)
+{
+	/* In little endian, the first digit of a pair is the low byte. */
+	return _mm_or_si128(
+		_mm_and_si128(_mm_slli_epi16(n, 4), _mm_set1_epi16(0x00f0)),
+		_mm_srli_epi16(n, 8));
+}
+
+__attribute__((target("sse2")))
+static int hex_to_id_sse2(const char *src, __u8 *id)
+{
+	__m128i n0, n1, n2, b01, b2;
+	int valid0, valid1, valid2;
+	__u32 tail;
+
+	if (!is_load_safe(src))
+		return hex_to_id_scalar(src, id);
+
+	n0 = sse2_nibbles(_mm_loadu_si128((const __m128i *)src), &valid0);
+	n1 = sse2_nibbles(_mm_loadu_si128((const __m128i *)(src + 16)),
+		&valid1);
+	n2 = sse2_nibbles(_mm_loadu_si128((const __m128i *)(src + 24)),
+		&valid2);
+	if ((valid0 & valid1 & valid2) != 0xffff)
+		return -1;
+
+	b01 = _mm_packus_epi16(sse2_merge(n0), sse2_merge(n1));
+	_mm_storeu_si128((__m128i *)id, b01);
+	/* Block 2 holds bytes 12--19 of the ID; only 16--19 are new. */
+	b2 = _mm_packus_epi16(sse2_merge(n2), sse2_merge(n2));
+	tail = _mm_cvtsi128_si32(_mm_srli_si128(b2, 4));
+	memcpy(id + 16, &tail, sizeof(tail));
+	return 0;
+}
+
+/* Return the digits of the nibbles in @n. */
+__attribute__((target("sse2")))
+static inline __m128i sse2_digits(__m128i n)
+{
+	const __m128i is_alpha = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')),
+		_mm_and_si128(is_alpha, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+/* Write the digits of the bytes in @b; the high nibble of a byte comes
+ * first. Only the digits of the first 8 bytes go to @lo16.
+ */
+__attribute__((target("sse2")))
+static inline void sse2_bytes_to_digits(__m128i b, __m128i *lo16,
+	__m128i *hi16)
+{
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(b, 4), mask);
+	const __m128i lo = _mm_and_si128(b, mask);
+
+	*lo16 = sse2_digits(_mm_unpacklo_epi8(hi, lo));
+	*hi16 = sse2_digits(_mm_unpackhi_epi8(hi, lo));
+}
+
+__attribute__((target("sse2")))
+static void id_to_hex_sse2(const __u8 *id, char *dst)
+{
+	__m128i d0, d1;
+	__u32 tail;
+
+	sse2_bytes_to_digits(_mm_loadu_si128((const __m128i *)id), &d0, &d1);
+	_mm_storeu_si128((__m128i *)dst, d0);
+	_mm_storeu_si128((__m128i *)(dst + 16), d1);
+
+	memcpy(&tail, id + 16, sizeof(tail));
+	sse2_bytes_to_digits(_mm_cvtsi32_si128(tail), &d0, &d1);
+	_mm_storel_epi64((__m128i *)(dst + 32), d0);
+}
+
+/*
+ * AVX2 implementation
+ *
+ * The first 32 digits are handled in a single 256-bit block, and the last
+ * 16 digits (overlapping 8 digits of the first block) in a 128-bit block.
+ * Pairs of nibbles are merged with a multiply-add.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_nibbles(__m256i v, __u32 *pvalid)
+{
+	const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+	const __m256i is_digit = _mm256_and_si256(
+		_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+	const __m256i is_alpha = _mm256_and_si256(
+		_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+
+	*pvalid = _mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha));
+	return _mm256_or_si256(
+		_mm256_and_si256(is_digit,
+			_mm256_sub_epi8(v, _mm256_set1_epi8('0'))),
+		_mm256_and_si256(is_alpha,
+			_mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10))));
+}
+
+__attribute__((target("avx2")))
+static int hex_to_id_avx2(const char *src, __u8 *id)
+{
+	/* Multiplying the first digit of a pair by 16 and adding
+	 * the second one merges the pair.
+	 */
+	const __m256i merge = _mm256_set1_epi16(0x0110);
+	__m256i n0, b0;
+	__m128i n1, b1;
+	__u32 valid0;
+	int valid1;
+	__u32 tail;
+
+	if (!is_load_safe(src))
+		return hex_to_id_scalar(src, id);
+
+	n0 = avx2_nibbles(_mm256_loadu_si256((const __m256i *)src), &valid0);
+	n1 = sse2_nibbles(_mm_loadu_si128((const __m128i *)(src + 24)),
+		&valid1);
+	if (valid0 != 0xffffffff || valid1 != 0xffff)
+		return -1;
+
+	/* Each 128-bit lane packs its 8 bytes into its low half;
+	 * the permutation gathers both halves.
+	 */
+	b0 = _mm256_maddubs_epi16(n0, merge);
+	b0 = _mm256_permute4x64_epi64(_mm256_packus_epi16(b0, b0), 0x08);
+	_mm_storeu_si128((__m128i *)id, _mm256_castsi256_si128(b0));
+
+	b1 = _mm_maddubs_epi16(n1, _mm256_castsi256_si128(merge));
+	b1 = _mm_packus_epi16(b1, b1);
+	tail = _mm_cvtsi128_si32(_mm_srli_si128(b1, 4));
+	memcpy(id + 16, &tail, sizeof(tail));
+	return 0;
+}
+
+#endif /* XID_HEX_X86 */
+
+/*
+ * Runtime selection
+ */
+
+static enum xia_simd_level simd_level = XIA_SIMD_NONE;
+static int (*hex_to_id_impl)(const char *src, __u8 *id) = hex_to_id_scalar;
+/* Encoding an ID fits in SSE2 registers, so AVX2 brings nothing. */
+static void (*id_to_hex_impl)(const __u8 *id, char *dst) = id_to_hex_scalar;
+
+static int is_level_supported(enum xia_simd_level level)
+{
+	switch (level) {
+	case XIA_SIMD_NONE:
+		return 1;
+#ifdef XID_HEX_X86
+	case XIA_SIMD_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case XIA_SIMD_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+int xia_set_simd_level(enum xia_simd_level level)
+{
+	if (!is_level_supported(level))
+		return -EINVAL;
+
+	switch (level) {
+#ifdef XID_HEX_X86
+	case XIA_SIMD_SSE2:
+		hex_to_id_impl = hex_to_id_sse2;
+		id_to_hex_impl = id_to_hex_sse2;
+		break;
+	case XIA_SIMD_AVX2:
+		hex_to_id_impl = hex_to_id_avx2;
+		id_to_hex_impl = id_to_hex_sse2;
+		break;
+#endif
+	default:
+		hex_to_id_impl = hex_to_id_scalar;
+		id_to_hex_impl = id_to_hex_scalar;
+		break;
+	}
+	simd_level = level;
+	return 0;
+}
+
+enum xia_simd_level xia_simd_level(void)
+{
+	return simd_level;
+}
+
+__attribute__((constructor))
+static void select_simd_level(void)
+{
+	enum xia_simd_level level = XIA_SIMD_AVX2;
+
+#ifdef XID_HEX_X86
+	__builtin_cpu_init();
+#endif
+	while (xia_set_simd_level(level))
+		level--;
+}
+
+int xia_hex_to_id(const char *src, __u8 *id)
+{
+	return hex_to_id_impl(src, id);
+}
+
+void xia_id_to_hex(const __u8 *id, char *dst)
+{
+	id_to_hex_impl(id, dst);
+}
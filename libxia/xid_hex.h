@@ -0,0 +1,52 @@
+#ifndef HEADER_XID_HEX_H
+#define HEADER_XID_HEX_H
+
+/* Userland-only helpers to convert IDs to and from hexadecimal strings.
+ *
+ * dag.c carries plain C versions of these conversions, so it keeps working
+ * in the kernel; dag_userland.h redirects dag.c to the functions below,
+ * which pick an SSE2 or AVX2 implementation at runtime when available.
+ */
+
+#include <linux/types.h>
+
+/* Levels of vectorization available to the conversions. */
+enum xia_simd_level {
+	XIA_SIMD_NONE = 0,
+	XIA_SIMD_SSE2,
+	XIA_SIMD_AVX2,
+};
+
+/* xia_hex_to_id - decode the XIA_XID_MAX * 2 hexadecimal digits at @src
+ *	into @id.
+ *
+ * RETURN
+ *	Zero on success; -1 if any of the digits is not a hexadecimal digit.
+ *
+ * NOTES
+ *	The caller must guarantee that @src has at least XIA_XID_MAX * 2
+ *	chars, or that it is terminated by a char that is not a hexadecimal
+ *	digit (e.g. '\0'); the function never reads beyond the first
+ *	invalid char unless it can prove the read to be safe.
+ *	@id is undefined if the function fails.
+ */
+int xia_hex_to_id(const char *src, __u8 *id);
+
+/* xia_id_to_hex - write the XIA_XID_MAX * 2 lowercase hexadecimal digits
+ *	of @id into @dst. No '\0' is added.
+ */
+void xia_id_to_hex(const __u8 *id, char *dst);
+
+/* xia_simd_level - return the level of vectorization currently in use. */
+enum xia_simd_level xia_simd_level(void);
+
+/* xia_set_simd_level - force the level of vectorization to @level.
+ * It is meant for benchmarks and tests; the best level available is
+ * selected when the library is loaded.
+ *
+ * RETURN
+ *	Zero on success; -EINVAL if the CPU does not support @level.
+ */
+int xia_set_simd_level(enum xia_simd_level level);
+
+#endif /* HEADER_XID_HEX_H */
@@ -0,0 +1,505 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <asm-generic/errno-base.h>
+#include <net/xia.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "xid_map.h"
+
+/*
+ * Layout
+ *
+ * The table has a power of two number of slots, split in groups of
+ * GROUP_SIZE slots. Each slot has a control byte, which tells whether
+ * the slot is empty, deleted, or full; a full slot keeps the 7 low bits
+ * of the hash of its XID in its control byte. A lookup hashes its XID
+ * into a first group and a 7-bit tag, and compares the tag with all
+ * the control bytes of a group at once. Only slots whose tag matches are
+ * compared, and a lookup stops at the first group that has an empty
+ * slot.
+ *
+ * Groups are probed in triangular order, which visits every group once
+ * when the number of groups is a power of two.
+ */
+
+#define GROUP_SIZE	16
+#define CTRL_EMPTY	0x80
+#define CTRL_DELETED	0xfe
+
+/* Tables are rehashed when more than 7/8 of their slots are taken. */
+static inline size_t max_load(size_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+struct xia_xid_map {
+	/* @capacity control bytes, aligned to GROUP_SIZE. */
+	__u8		*ctrl;
+	/* @capacity slots of @slot_size bytes, each an XID followed by
+	 * its value.
+	 */
+	__u8		*slots;
+	size_t		slot_size;
+	size_t		value_size;
+	/* Zero, or a power of two no smaller than GROUP_SIZE. */
+	size_t		capacity;
+	size_t		count;
+	/* Number of empty slots that can be taken before a rehash. */
+	size_t		growth_left;
+};
+
+/*
+ * Hashing
+ *
+ * Most XIDs are cryptographic hashes, so their bits are already random.
+ * The three words of an XID are nevertheless mixed, so that structured
+ * XIDs (e.g. counters, or XIDs that only differ in their type) spread
+ * as well.
+ */
+
+static inline __u64 xid_hash(const struct xia_xid *xid)
+{
+	const __u64 *w = (const __u64 *)xid;
+	__u64 h;
+
+	BUILD_BUG_ON(sizeof(struct xia_xid) != sizeof(__u64) * 3);
+	h = w[0] ^ ((w[1] << 21) | (w[1] >> 43)) ^
+		((w[2] << 42) | (w[2] >> 22));
+	h *= 0x9e3779b97f4a7c15ULL;
+	return h ^ (h >> 32);
+}
+
+static inline __u8 hash_tag(__u64 hash)
+{
+	return hash & 0x7f;
+}
+
+static inline size_t hash_group(const struct xia_xid_map *map, __u64 hash)
+{
+	return (hash >> 7) & (map->capacity / GROUP_SIZE - 1);
+}
+
+/*
+ * Groups
+ *
+ * Matches are returned as masks with bit i set for slot i of the group.
+ */
+
+#ifdef __SSE2__
+
+static inline __u32 match_tag(const __u8 *group, __u8 tag)
+{
+	const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag)));
+}
+
+static inline __u32 match_empty(const __u8 *group)
+{
+	const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl,
+		_mm_set1_epi8((char)CTRL_EMPTY)));
+}
+
+/* Empty and deleted slots are the only ones with the high bit set. */
+static inline __u32 match_free(const __u8 *group)
+{
+	return _mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+}
+
+#else
+
+static inline __u32 match_tag(const __u8 *group, __u8 tag)
+{
+	__u32 mask = 0;
+	int i;
+
+	for (i = 0; i < GROUP_SIZE; i++)
+		mask |= (__u32)(group[i] == tag) << i;
+	return mask;
+}
+
+static inline __u32 match_empty(const __u8 *group)
+{
+	return match_tag(group, CTRL_EMPTY);
+}
+
+static inline __u32 match_free(const __u8 *group)
+{
+	__u32 mask = 0;
+	int i;
+
+	for (i = 0; i < GROUP_SIZE; i++)
+		mask |= (__u32)(group[i] >> 7) << i;
+	return mask;
+}
+
+#endif /* __SSE2__ */
+
+static inline __u8 *slot_at(const struct xia_xid_map *map, size_t i)
+{
+	return map->slots + i * map->slot_size;
+}
+
+static inline void *slot_value(__u8 *slot)
+{
+	return slot + sizeof(struct xia_xid);
+}
+
+/* Return the index of the slot of @xid, or -1 if @xid is not in @map. */
+static inline ssize_t find_hashed(const struct xia_xid_map *map,
+	const struct xia_xid *xid, __u64 hash)
+{
+	const __u8 tag = hash_tag(hash);
+	size_t group = hash_group(map, hash);
+	const size_t groups_mask = map->capacity / GROUP_SIZE - 1;
+	size_t step = 0;
+
+	if (!map->capacity)
+		return -1;
+
+	while (1) {
+		const __u8 *ctrl = map->ctrl + group * GROUP_SIZE;
+		__u32 match = match_tag(ctrl, tag);
+
+		while (match) {
+			size_t i = group * GROUP_SIZE + __builtin_ctz(match);
+			if (are_sxids_equal((const struct xia_xid *)
+				slot_at(map, i), xid))
+				return i;
+			match &= match - 1;
+		}
+		if (match_empty(ctrl))
+			return -1;
+		step++;
+		group = (group + step) & groups_mask;
+	}
+}
+
+/* Return the index of the first free slot in the probe sequence of @hash.
+ * The map must have a free slot.
+ */
+static inline size_t find_free(const struct xia_xid_map *map, __u64 hash)
+{
+	size_t group = hash_group(map, hash);
+	const size_t groups_mask = map->capacity / GROUP_SIZE - 1;
+	size_t step = 0;
+
+	while (1) {
+		__u32 match = match_free(map->ctrl + group * GROUP_SIZE);
+		if (match)
+			return group * GROUP_SIZE + __builtin_ctz(match);
+		step++;
+		group = (group + step) & groups_mask;
+	}
+}
+
+static inline void *fill_slot(struct xia_xid_map *map, size_t i,
+	const struct xia_xid *xid, __u64 hash)
+{
+	__u8 *slot = slot_at(map, i);
+
+	if (map->ctrl[i] == CTRL_EMPTY)
+		map->growth_left--;
+	map->ctrl[i] = hash_tag(hash);
+	memcpy(slot, xid, sizeof(*xid));
+	map->count++;
+	return slot_value(slot);
+}
+
+/* Move all entries of @map into a new table of @capacity slots. */
+static int rehash(struct xia_xid_map *map, size_t capacity)
+{
+	struct xia_xid_map new_map = *map;
+	size_t i;
+
+	new_map.ctrl = aligned_alloc(GROUP_SIZE, capacity);
+	new_map.slots = malloc(capacity * map->slot_size);
+	if (!new_map.ctrl || !new_map.slots) {
+		free(new_map.ctrl);
+		free(new_map.slots);
+		return -ENOMEM;
+	}
+	memset(new_map.ctrl, CTRL_EMPTY, capacity);
+	new_map.capacity = capacity;
+	new_map.growth_left = max_load(capacity) - map->count;
+
+	for (i = 0; i < map->capacity; i++) {
+		const __u8 *slot;
+		size_t j;
+
+		if (map->ctrl[i] & 0x80)
+			continue;
+		slot = slot_at(map, i);
+		j = find_free(&new_map,
+			xid_hash((const struct xia_xid *)slot));
+		new_map.ctrl[j] = map->ctrl[i];
+		memcpy(slot_at(&new_map, j), slot, map->slot_size);
+	}
+
+	free(map->ctrl);
+	free(map->slots);
+	*map = new_map;
+	return 0;
+}
+
+/* Return the smallest capacity that holds @n entries. */
+static size_t capacity_for(size_t n)
+{
+	size_t capacity = GROUP_SIZE;
+
+	while (max_load(capacity) < n)
+		capacity *= 2;
+	return capacity;
+}
+
+/* Make room for one more entry. */
+static int make_room(struct xia_xid_map *map)
+{
+	if (map->growth_left)
+		return 0;
+	/* If deleted slots take much of the table, reclaiming them is
+	 * enough.
+	 */
+	if (map->count < max_load(map->capacity) / 2)
+		return rehash(map, map->capacity);
+	return rehash(map, map->capacity ? map->capacity * 2 : GROUP_SIZE);
+}
+
+struct xia_xid_map *xia_xid_map_new(size_t value_size)
+{
+	struct xia_xid_map *map = calloc(1, sizeof(*map));
+
+	if (!map)
+		return NULL;
+	map->value_size = value_size;
+	/* Keep XIDs aligned to 8 bytes for are_sxids_equal. */
+	map->slot_size = (sizeof(struct xia_xid) + value_size + 7) & ~7UL;
+	return map;
+}
+
+void xia_xid_map_free(struct xia_xid_map *map)
+{
+	if (!map)
+		return;
+	free(map->ctrl);
+	free(map->slots);
+	free(map);
+}
+
+size_t xia_xid_map_count(const struct xia_xid_map *map)
+{
+	return map->count;
+}
+
+void xia_xid_map_clear(struct xia_xid_map *map)
+{
+	if (!map->capacity)
+		return;
+	memset(map->ctrl, CTRL_EMPTY, map->capacity);
+	map->count = 0;
+	map->growth_left = max_load(map->capacity);
+}
+
+int xia_xid_map_reserve(struct xia_xid_map *map, size_t n)
+{
+	size_t capacity;
+
+	if (n <= map->count + map->growth_left)
+		return 0;
+	capacity = capacity_for(n);
+	/* Rehashing to the same capacity still reclaims deleted slots. */
+	if (capacity < map->capacity)
+		capacity = map->capacity;
+	return rehash(map, capacity);
+}
+
+void *xia_xid_map_find(const struct xia_xid_map *map,
+	const struct xia_xid *xid)
+{
+	ssize_t i = find_hashed(map, xid, xid_hash(xid));
+	return i < 0 ? NULL : slot_value(slot_at(map, i));
+}
+
+/* Insert @xid, whose hash is @hash, with the value at @value, if any.
+ * The caller must have made room for @xid.
+ */
+static inline int insert_hashed(struct xia_xid_map *map,
+	const struct xia_xid *xid, __u64 hash, const void *value,
+	void **pvalue)
+{
+	ssize_t i = find_hashed(map, xid, hash);
+	void *dst;
+
+	if (i >= 0) {
+		if (pvalue)
+			*pvalue = slot_value(slot_at(map, i));
+		return 0;
+	}
+
+	dst = fill_slot(map, find_free(map, hash), xid, hash);
+	if (value)
+		memcpy(dst, value, map->value_size);
+	else
+		memset(dst, 0, map->value_size);
+	if (pvalue)
+		*pvalue = dst;
+	return 1;
+}
+
+int xia_xid_map_insert(struct xia_xid_map *map, const struct xia_xid *xid,
+	void **pvalue)
+{
+	const __u64 hash = xid_hash(xid);
+	ssize_t i = find_hashed(map, xid, hash);
+
+	if (i >= 0) {
+		if (pvalue)
+			*pvalue = slot_value(slot_at(map, i));
+		return 0;
+	}
+	if (make_room(map))
+		return -ENOMEM;
+	return insert_hashed(map, xid, hash, NULL, pvalue);
+}
+
+static inline void erase_slot(struct xia_xid_map *map, size_t i)
+{
+	/* If the group of the slot has an empty slot, no probe goes beyond
+	 * the group, so the slot can be empty as well.
+	 */
+	if (match_empty(map->ctrl + (i & ~(size_t)(GROUP_SIZE - 1)))) {
+		map->ctrl[i] = CTRL_EMPTY;
+		map->growth_left++;
+	} else {
+		map->ctrl[i] = CTRL_DELETED;
+	}
+	map->count--;
+}
+
+int xia_xid_map_erase(struct xia_xid_map *map, const struct xia_xid *xid)
+{
+	ssize_t i = find_hashed(map, xid, xid_hash(xid));
+
+	if (i < 0)
+		return 0;
+	erase_slot(map, i);
+	return 1;
+}
+
+/*
+ * Batches
+ *
+ * Batches hash BATCH_SIZE XIDs and prefetch their first groups before
+ * probing any of them, so that the cache misses of a batch overlap.
+ */
+
+#define BATCH_SIZE	16
+
+static inline int hash_batch(const struct xia_xid_map *map,
+	const struct xia_xid *xids, int n, __u64 *hashes)
+{
+	int i;
+
+	if (n > BATCH_SIZE)
+		n = BATCH_SIZE;
+	for (i = 0; i < n; i++) {
+		hashes[i] = xid_hash(&xids[i]);
+		__builtin_prefetch(map->ctrl +
+			hash_group(map, hashes[i]) * GROUP_SIZE);
+	}
+	return n;
+}
+
+int xia_xid_map_find_many(const struct xia_xid_map *map,
+	const struct xia_xid *xids, int n, void **values)
+{
+	__u64 hashes[BATCH_SIZE];
+	int i, j, found = 0;
+
+	if (!map->capacity) {
+		if (values)
+			memset(values, 0, n * sizeof(*values));
+		return 0;
+	}
+
+	for (i = 0; i < n; i += BATCH_SIZE) {
+		const int m = hash_batch(map, xids + i, n - i, hashes);
+		for (j = 0; j < m; j++) {
+			ssize_t k = find_hashed(map, &xids[i + j], hashes[j]);
+			if (k >= 0)
+				found++;
+			if (values)
+				values[i + j] = k < 0 ? NULL :
+					slot_value(slot_at(map, k));
+		}
+	}
+	return found;
+}
+
+int xia_xid_map_insert_many(struct xia_xid_map *map,
+	const struct xia_xid *xids, const void *values, int n, int *results)
+{
+	__u64 hashes[BATCH_SIZE];
+	int i, j, added = 0;
+
+	/* Reserving up front spares the batch any rehash. */
+	if (xia_xid_map_reserve(map, map->count + n))
+		return -ENOMEM;
+
+	for (i = 0; i < n; i += BATCH_SIZE) {
+		const int m = hash_batch(map, xids + i, n - i, hashes);
+		for (j = 0; j < m; j++) {
+			const void *value = values ? (const __u8 *)values +
+				(size_t)(i + j) * map->value_size : NULL;
+			int rc = insert_hashed(map, &xids[i + j], hashes[j],
+				value, NULL);
+			added += rc;
+			if (results)
+				results[i + j] = rc;
+		}
+	}
+	return added;
+}
+
+int xia_xid_map_erase_many(struct xia_xid_map *map,
+	const struct xia_xid *xids, int n)
+{
+	__u64 hashes[BATCH_SIZE];
+	int i, j, erased = 0;
+
+	if (!map->capacity)
+		return 0;
+
+	for (i = 0; i < n; i += BATCH_SIZE) {
+		const int m = hash_batch(map, xids + i, n - i, hashes);
+		for (j = 0; j < m; j++) {
+			ssize_t k = find_hashed(map, &xids[i + j], hashes[j]);
+			if (k >= 0) {
+				erase_slot(map, k);
+				erased++;
+			}
+		}
+	}
+	return erased;
+}
+
+const struct xia_xid *xia_xid_map_next(const struct xia_xid_map *map,
+	size_t *ppos, void **pvalue)
+{
+	size_t i;
+
+	for (i = *ppos; i < map->capacity; i++)
+		if (!(map->ctrl[i] & 0x80)) {
+			__u8 *slot = slot_at(map, i);
+			*ppos = i + 1;
+			if (pvalue)
+				*pvalue = slot_value(slot);
+			return (const struct xia_xid *)slot;
+		}
+	*ppos = map->capacity;
+	return NULL;
+}
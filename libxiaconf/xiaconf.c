@@ -0,0 +1,500 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+#include <net/xia_fib.h>
+#include <xia_socket.h>
+
+#include "xiaconf.h"
+
+/* Large enough for any message the kernel sends in a dump. */
+#define RECV_BUF_SIZE	(32 * 1024)
+
+struct xiaconf {
+	int		fd;
+	__u32		portid;
+	__u32		seq;
+	char		*buf;		/* RECV_BUF_SIZE bytes.	*/
+};
+
+int xiaconf_open(struct xiaconf **pxc)
+{
+	struct sockaddr_nl addr;
+	socklen_t addr_len = sizeof(addr);
+	struct xiaconf *xc;
+	int err;
+
+	xc = malloc(sizeof(*xc));
+	if (!xc)
+		return -ENOMEM;
+	xc->buf = malloc(RECV_BUF_SIZE);
+	if (!xc->buf) {
+		free(xc);
+		return -ENOMEM;
+	}
+
+	xc->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (xc->fd < 0)
+		goto fail;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	if (bind(xc->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+		getsockname(xc->fd, (struct sockaddr *)&addr, &addr_len))
+		goto fail;
+	xc->portid = addr.nl_pid;
+	xc->seq = 0;
+	*pxc = xc;
+	return 0;
+
+fail:
+	err = -errno;
+	if (xc->fd >= 0)
+		close(xc->fd);
+	free(xc->buf);
+	free(xc);
+	return err;
+}
+
+void xiaconf_close(struct xiaconf *xc)
+{
+	if (!xc)
+		return;
+	close(xc->fd);
+	free(xc->buf);
+	free(xc);
+}
+
+/*
+ *	Messages
+ */
+
+static int add_attr(struct nlmsghdr *n, size_t size, int type,
+	const void *data, size_t len)
+{
+	struct rtattr *rta;
+
+	if (NLMSG_ALIGN(n->nlmsg_len) + RTA_SPACE(len) > size)
+		return -EMSGSIZE;
+	rta = (struct rtattr *)((char *)n + NLMSG_ALIGN(n->nlmsg_len));
+	/* Padding is zeroed too. */
+	memset(rta, 0, RTA_SPACE(len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	memcpy(RTA_DATA(rta), data, len);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_SPACE(len);
+	return 0;
+}
+
+/* Based on modify_local() of xip/xipad.c and xrt_modify_route() of
+ * xip/xiart.c, which now build their requests here.
+ */
+int xiaconf_request(struct nlmsghdr *n, size_t size, enum xiaconf_op op,
+	const struct xiaconf_route *rt)
+{
+	int is_local = rt->tbl_id == XRTABLE_LOCAL_INDEX;
+	struct rtmsg *r;
+	int err;
+
+	if (size < NLMSG_SPACE(sizeof(*r)) ||
+		rt->protoinfo_len > XIACONF_PROTOINFO_MAX)
+		return -EMSGSIZE;
+	memset(n, 0, NLMSG_SPACE(sizeof(*r)));
+	n->nlmsg_len = NLMSG_LENGTH(sizeof(*r));
+	r = NLMSG_DATA(n);
+
+	switch (op) {
+	case XIACONF_ADD:
+		n->nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
+		n->nlmsg_type = RTM_NEWROUTE;
+		break;
+	case XIACONF_REPLACE:
+		n->nlmsg_flags = NLM_F_REQUEST|NLM_F_REPLACE;
+		n->nlmsg_type = RTM_NEWROUTE;
+		break;
+	case XIACONF_DEL:
+		n->nlmsg_flags = NLM_F_REQUEST;
+		n->nlmsg_type = RTM_DELROUTE;
+		break;
+	}
+
+	r->rtm_family = AF_XIA;
+	r->rtm_table = rt->tbl_id;
+	r->rtm_protocol = RTPROT_BOOT;
+	if (is_local) {
+		r->rtm_type = RTN_LOCAL;
+		r->rtm_scope = RT_SCOPE_HOST;
+	} else {
+		r->rtm_type = RTN_UNICAST;
+		r->rtm_scope = op == XIACONF_DEL ?
+			RT_SCOPE_NOWHERE : RT_SCOPE_LINK;
+	}
+
+	r->rtm_dst_len = sizeof(rt->dst);
+	err = add_attr(n, size, RTA_DST, &rt->dst, sizeof(rt->dst));
+	if (!err && rt->protoinfo_len)
+		err = add_attr(n, size, RTA_PROTOINFO, rt->protoinfo,
+			rt->protoinfo_len);
+	if (!err && !is_local && op != XIACONF_DEL && rt->has_gw)
+		err = add_attr(n, size, RTA_GATEWAY, &rt->gw,
+			sizeof(rt->gw));
+	return err;
+}
+
+int xiaconf_get_request(struct nlmsghdr *n, size_t size, __u32 tbl_id,
+	const struct xia_xid *dst)
+{
+	struct rtmsg *r;
+	int err;
+
+	if (size < NLMSG_SPACE(sizeof(*r)))
+		return -EMSGSIZE;
+	memset(n, 0, NLMSG_SPACE(sizeof(*r)));
+	n->nlmsg_len = NLMSG_LENGTH(sizeof(*r));
+	n->nlmsg_flags = NLM_F_REQUEST;
+	n->nlmsg_type = RTM_GETROUTE;
+	r = NLMSG_DATA(n);
+	r->rtm_family = AF_XIA;
+	r->rtm_table = tbl_id;
+	r->rtm_dst_len = sizeof(*dst);
+
+	err = add_attr(n, size, RTA_TABLE, &tbl_id, sizeof(tbl_id));
+	if (!err)
+		err = add_attr(n, size, RTA_DST, dst, sizeof(*dst));
+	return err;
+}
+
+/* Based on xrt_print_route() of xip/xiart.c. */
+int xiaconf_parse_route(const struct nlmsghdr *n, struct xiaconf_route *rt)
+{
+	const struct rtattr *tb[RTA_MAX + 1];
+	const struct rtmsg *r = NLMSG_DATA(n);
+	const struct rtattr *rta;
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+
+	if (n->nlmsg_type != RTM_NEWROUTE && n->nlmsg_type != RTM_DELROUTE)
+		return 0;
+	if (len < 0)
+		return -EINVAL;
+	if (r->rtm_family != AF_XIA || (r->rtm_flags & RTM_F_CLONED))
+		return 0;
+
+	memset(tb, 0, sizeof(tb));
+	for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+		if (rta->rta_type <= RTA_MAX)
+			tb[rta->rta_type] = rta;
+
+	if (r->rtm_dst_len != sizeof(struct xia_xid) || !tb[RTA_DST] ||
+		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid))
+		return -EINVAL;
+	if (tb[RTA_GATEWAY] &&
+		RTA_PAYLOAD(tb[RTA_GATEWAY]) != sizeof(struct xia_xid))
+		return -EINVAL;
+	if (tb[RTA_TABLE] && RTA_PAYLOAD(tb[RTA_TABLE]) != sizeof(__u32))
+		return -EINVAL;
+
+	memset(rt, 0, sizeof(*rt));
+	rt->tbl_id = tb[RTA_TABLE] ?
+		*(const __u32 *)RTA_DATA(tb[RTA_TABLE]) : r->rtm_table;
+	memcpy(&rt->dst, RTA_DATA(tb[RTA_DST]), sizeof(rt->dst));
+	if (tb[RTA_GATEWAY]) {
+		memcpy(&rt->gw, RTA_DATA(tb[RTA_GATEWAY]), sizeof(rt->gw));
+		rt->has_gw = 1;
+	}
+	if (tb[RTA_PROTOINFO]) {
+		size_t info_len = RTA_PAYLOAD(tb[RTA_PROTOINFO]);
+
+		if (info_len > XIACONF_PROTOINFO_MAX)
+			info_len = XIACONF_PROTOINFO_MAX;
+		memcpy(rt->protoinfo, RTA_DATA(tb[RTA_PROTOINFO]), info_len);
+		rt->protoinfo_len = info_len;
+	}
+	rt->protocol = r->rtm_protocol;
+	rt->flags = r->rtm_flags;
+	return 1;
+}
+
+/*
+ *	Talking to the kernel
+ */
+
+typedef int (*handler_t)(const struct nlmsghdr *n, void *arg);
+
+static int send_msg(struct xiaconf *xc, struct nlmsghdr *n)
+{
+	struct sockaddr_nl peer;
+	ssize_t sent;
+
+	memset(&peer, 0, sizeof(peer));
+	peer.nl_family = AF_NETLINK;
+	n->nlmsg_seq = ++xc->seq;
+	n->nlmsg_pid = 0;
+	do
+		sent = sendto(xc->fd, n, n->nlmsg_len, 0,
+			(struct sockaddr *)&peer, sizeof(peer));
+	while (sent < 0 && errno == EINTR);
+	if (sent < 0)
+		return -errno;
+	return 0;
+}
+
+/* Read the reply to the last message sent, and pass its messages to
+ *	@handle, if not NULL, until an acknowledgment, an error, or the end
+ *	of a dump.
+ *
+ * RETURN
+ *	Zero, or the first error of @handle, once the reply ends;
+ *	the error of the kernel; or a negative error number on failure.
+ */
+static int receive(struct xiaconf *xc, handler_t handle, void *arg)
+{
+	int err = 0, intr = 0;
+
+	while (1) {
+		struct sockaddr_nl peer;
+		struct iovec iov = {
+			.iov_base	= xc->buf,
+			.iov_len	= RECV_BUF_SIZE,
+		};
+		struct msghdr msg = {
+			.msg_name	= &peer,
+			.msg_namelen	= sizeof(peer),
+			.msg_iov	= &iov,
+			.msg_iovlen	= 1,
+		};
+		const struct nlmsghdr *h;
+		ssize_t len = recvmsg(xc->fd, &msg, 0);
+
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (msg.msg_flags & MSG_TRUNC)
+			return -EMSGSIZE;
+		if (peer.nl_pid)
+			continue;	/* Not from the kernel. */
+
+		for (h = (const struct nlmsghdr *)xc->buf; NLMSG_OK(h, len);
+			h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_pid != xc->portid ||
+				h->nlmsg_seq != xc->seq)
+				continue;	/* A stale reply. */
+			if (h->nlmsg_flags & NLM_F_DUMP_INTR)
+				intr = 1;
+
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				const struct nlmsgerr *e = NLMSG_DATA(h);
+
+				if (h->nlmsg_len < NLMSG_LENGTH(sizeof(*e)))
+					return -EINVAL;
+				return e->error ? e->error : err;
+			}
+			if (h->nlmsg_type == NLMSG_DONE) {
+				/* Newer kernels report dump errors here. */
+				if (h->nlmsg_len >= NLMSG_LENGTH(sizeof(int)) &&
+					*(const int *)NLMSG_DATA(h) < 0)
+					return *(const int *)NLMSG_DATA(h);
+				if (err)
+					return err;
+				return intr ? -EAGAIN : 0;
+			}
+			if (handle && !err)
+				err = handle(h, arg);
+		}
+	}
+}
+
+static int modify(struct xiaconf *xc, enum xiaconf_op op,
+	const struct xiaconf_route *rt)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	int err = xiaconf_request(&req.n, sizeof(req), op, rt);
+
+	if (err)
+		return err;
+	req.n.nlmsg_flags |= NLM_F_ACK;
+	err = send_msg(xc, &req.n);
+	return err ? err : receive(xc, NULL, NULL);
+}
+
+int xiaconf_add(struct xiaconf *xc, const struct xiaconf_route *rt)
+{
+	return modify(xc, XIACONF_ADD, rt);
+}
+
+int xiaconf_replace(struct xiaconf *xc, const struct xiaconf_route *rt)
+{
+	return modify(xc, XIACONF_REPLACE, rt);
+}
+
+int xiaconf_del(struct xiaconf *xc, const struct xiaconf_route *rt)
+{
+	return modify(xc, XIACONF_DEL, rt);
+}
+
+struct lookup {
+	struct xiaconf_route	*rt;
+	int			found;
+};
+
+static int save_found(const struct nlmsghdr *n, void *arg)
+{
+	struct lookup *l = arg;
+	int rc = xiaconf_parse_route(n, l->rt);
+
+	if (rc < 0)
+		return rc;
+	l->found |= rc;
+	return 0;
+}
+
+int xiaconf_get(struct xiaconf *xc, __u32 tbl_id, const struct xia_xid *dst,
+	struct xiaconf_route *rt)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	struct lookup l = { .rt = rt, .found = 0 };
+	int err = xiaconf_get_request(&req.n, sizeof(req), tbl_id, dst);
+
+	if (err)
+		return err;
+	/* The acknowledgment follows the answer. */
+	req.n.nlmsg_flags |= NLM_F_ACK;
+	err = send_msg(xc, &req.n);
+	if (!err)
+		err = receive(xc, save_found, &l);
+	if (err)
+		return err;
+	return l.found ? 0 : -ENOENT;
+}
+
+/*
+ *	Listing
+ */
+
+struct listing {
+	__u32			tbl_id;
+	xid_type_t		ppal_ty;
+	int			in_arena;
+	struct xiaconf_route	*routes;
+	size_t			count;
+	size_t			max;
+};
+
+/* Kernels that do not filter dumps send every entry. Entries of other
+ * tables and principals are skipped before they are parsed, so that
+ * they cannot fail the listing.
+ */
+static int may_be_listed(const struct nlmsghdr *n, const struct listing *l)
+{
+	const struct rtmsg *r = NLMSG_DATA(n);
+	const struct rtattr *rta;
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+	__u32 tbl_id;
+
+	if (n->nlmsg_type != RTM_NEWROUTE)
+		return 0;
+	/* Parsing rejects it. */
+	if (len < 0)
+		return 1;
+	if (r->rtm_family != AF_XIA)
+		return 0;
+
+	tbl_id = r->rtm_table;
+	for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == RTA_TABLE &&
+			RTA_PAYLOAD(rta) == sizeof(tbl_id))
+			memcpy(&tbl_id, RTA_DATA(rta), sizeof(tbl_id));
+		else if (rta->rta_type == RTA_DST &&
+			RTA_PAYLOAD(rta) >= sizeof(l->ppal_ty) &&
+			memcmp(RTA_DATA(rta), &l->ppal_ty, sizeof(l->ppal_ty)))
+			return 0;
+	}
+	return tbl_id == l->tbl_id;
+}
+
+static int add_listed(const struct nlmsghdr *n, void *arg)
+{
+	struct listing *l = arg;
+	struct xiaconf_route rt;
+	int rc;
+
+	if (!may_be_listed(n, l))
+		return 0;
+	rc = xiaconf_parse_route(n, &rt);
+	if (rc <= 0)
+		return rc;
+
+	if (l->count == l->max) {
+		struct xiaconf_route *routes;
+		size_t max = l->max ? 2 * l->max : 64;
+
+		if (l->in_arena)
+			return -ENOSPC;
+		routes = realloc(l->routes, max * sizeof(*routes));
+		if (!routes)
+			return -ENOMEM;
+		l->routes = routes;
+		l->max = max;
+	}
+	l->routes[l->count++] = rt;
+	return 0;
+}
+
+int xiaconf_list(struct xiaconf *xc, xid_type_t ppal_ty, __u32 tbl_id,
+	struct xiaconf_arena *arena, struct xiaconf_route **proutes)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[NLMSG_SPACE(sizeof(struct rtmsg)) + 64];
+	} req;
+	struct rtmsg *r = NLMSG_DATA(&req.n);
+	struct listing l;
+	int err;
+
+	memset(&l, 0, sizeof(l));
+	l.tbl_id = tbl_id;
+	l.ppal_ty = ppal_ty;
+	if (arena) {
+		const size_t align = __alignof__(struct xiaconf_route);
+		size_t start = (arena->used + align - 1) & ~(align - 1);
+
+		l.in_arena = 1;
+		l.routes = (struct xiaconf_route *)((char *)arena->buf + start);
+		l.max = start < arena->size ?
+			(arena->size - start) / sizeof(*l.routes) : 0;
+	}
+
+	/* Same request as xrt_dump_request() of xip/xiart.c. */
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(*r));
+	req.n.nlmsg_type = RTM_GETROUTE;
+	req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_DUMP;
+	r->rtm_family = AF_XIA;
+	r->rtm_table = tbl_id;
+	r->rtm_dst_len = sizeof(ppal_ty);
+	add_attr(&req.n, sizeof(req), RTA_TABLE, &tbl_id, sizeof(tbl_id));
+	add_attr(&req.n, sizeof(req), RTA_DST, &ppal_ty, sizeof(ppal_ty));
+
+	err = send_msg(xc, &req.n);
+	if (!err)
+		err = receive(xc, add_listed, &l);
+	if (err) {
+		if (!l.in_arena)
+			free(l.routes);
+		return err;
+	}
+
+	if (l.in_arena)
+		arena->used = (char *)(l.routes + l.count) -
+			(char *)arena->buf;
+	*proutes = l.routes;
+	return l.count;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <net/xia.h>
+
+#include "xid_map.h"
+
+/* Benchmark of xia_xid_map.
+ *
+ * The "hlist" lines run a chained table of 128 buckets, like the one
+ * that holds the principal map in dag.c, which is how XIDs are usually
+ * kept around; the other lines run xia_xid_map with single and batched
+ * calls.
+ */
+
+#define HLIST_SIZE	128
+
+struct hlist_entry {
+	struct hlist_entry	*next;
+	struct xia_xid		xid;
+};
+
+static struct hlist_entry *hlist_heads[HLIST_SIZE];
+
+static inline struct hlist_entry **hlist_head(const struct xia_xid *xid)
+{
+	return &hlist_heads[xid->xid_id[0] & (HLIST_SIZE - 1)];
+}
+
+static struct hlist_entry *hlist_find(const struct xia_xid *xid)
+{
+	struct hlist_entry *e;
+
+	for (e = *hlist_head(xid); e; e = e->next)
+		if (are_sxids_equal(&e->xid, xid))
+			return e;
+	return NULL;
+}
+
+static void hlist_insert(const struct xia_xid *xid)
+{
+	struct hlist_entry **head = hlist_head(xid);
+	struct hlist_entry *e;
+
+	if (hlist_find(xid))
+		return;
+	e = malloc(sizeof(*e));
+	assert(e);
+	e->xid = *xid;
+	e->next = *head;
+	*head = e;
+}
+
+static void hlist_erase(const struct xia_xid *xid)
+{
+	struct hlist_entry **pe, *e;
+
+	for (pe = hlist_head(xid); (e = *pe); pe = &e->next)
+		if (are_sxids_equal(&e->xid, xid)) {
+			*pe = e->next;
+			free(e);
+			return;
+		}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	assert(!clock_gettime(CLOCK_MONOTONIC, &ts));
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, int n, double secs)
+{
+	printf("%-8s %-8s %8.1f ns/XID\n", name, op, secs * 1e9 / n);
+}
+
+static void random_xids(struct xia_xid *xids, int n)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		xids[i].xid_type = __cpu_to_be32(0x11);
+		for (j = 0; j < XIA_XID_MAX; j++)
+			xids[i].xid_id[j] = rand();
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	/* The chained table is quadratic, so it only gets a sample. */
+	int hlist_n = n < 20000 ? n : 20000;
+	struct xia_xid *xids, *misses;
+	struct xia_xid_map *map;
+	int found, i;
+	double start;
+
+	assert(n > 0);
+	xids = malloc(n * sizeof(*xids));
+	misses = malloc(n * sizeof(*misses));
+	assert(xids && misses);
+	random_xids(xids, n);
+	random_xids(misses, n);
+
+	start = now();
+	for (i = 0; i < hlist_n; i++)
+		hlist_insert(&xids[i]);
+	report("hlist", "insert", hlist_n, now() - start);
+	start = now();
+	for (i = found = 0; i < hlist_n; i++)
+		found += !!hlist_find(&xids[i]);
+	report("hlist", "find", hlist_n, now() - start);
+	assert(found == hlist_n);
+	start = now();
+	for (i = 0; i < hlist_n; i++)
+		hlist_erase(&xids[i]);
+	report("hlist", "erase", hlist_n, now() - start);
+
+	map = xia_xid_map_new(0);
+	assert(map);
+	start = now();
+	for (i = 0; i < n; i++)
+		assert(xia_xid_map_insert(map, &xids[i], NULL) >= 0);
+	report("single", "insert", n, now() - start);
+	start = now();
+	for (i = found = 0; i < n; i++)
+		found += !!xia_xid_map_find(map, &xids[i]);
+	report("single", "find", n, now() - start);
+	assert(found == n);
+	start = now();
+	for (i = found = 0; i < n; i++)
+		found += !!xia_xid_map_find(map, &misses[i]);
+	report("single", "miss", n, now() - start);
+	assert(!found);
+	start = now();
+	for (i = 0; i < n; i++)
+		xia_xid_map_erase(map, &xids[i]);
+	report("single", "erase", n, now() - start);
+	xia_xid_map_free(map);
+
+	map = xia_xid_map_new(0);
+	assert(map);
+	start = now();
+	assert(xia_xid_map_insert_many(map, xids, NULL, n, NULL) == n);
+	report("batch", "insert", n, now() - start);
+	start = now();
+	assert(xia_xid_map_find_many(map, xids, n, NULL) == n);
+	report("batch", "find", n, now() - start);
+	start = now();
+	assert(!xia_xid_map_find_many(map, misses, n, NULL));
+	report("batch", "miss", n, now() - start);
+	start = now();
+	assert(xia_xid_map_erase_many(map, xids, n) == n);
+	report("batch", "erase", n, now() - start);
+	xia_xid_map_free(map);
+
+	free(xids);
+	free(misses);
+	return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <assert.h>
+#include <asm/byteorder.h>
+#include <net/xia_dag.h>
+
+#include "xid_hex.h"
+
+/* Benchmark of xia_ptoid.
+ *
+ * The "legacy" line runs the digit-at-a-time decoder that xia_ptoid
+ * used before IDs were decoded in blocks; the other lines run xia_ptoid
+ * at each level of vectorization the CPU supports.
+ */
+
+#define STRID_LEN	(XIA_XID_MAX * 2)
+
+static int legacy_ascii_to_int(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	else if (ch >= 'A' && ch <= 'Z')
+		return ch - 'A' + 10;
+	else if (ch >= 'a' && ch <= 'z')
+		return ch - 'a' + 10;
+	else
+		return 64;
+}
+
+static int legacy_read_be32(const char **pp, size_t *pleft, __be32 *value)
+{
+	__u32 result = 0;
+	int i = 0;
+
+	while (*pleft >= 1 && isxdigit(**pp) && i < 8) {
+		result = (result << 4) + legacy_ascii_to_int(**pp);
+		(*pp)++;
+		(*pleft)--;
+		i++;
+	}
+	*value = __cpu_to_be32(result);
+	return i;
+}
+
+static int legacy_ptoid(const char *src, size_t srclen, struct xia_xid *dst)
+{
+	__be32 *pxid = (__be32 *)dst->xid_id;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		if (legacy_read_be32(&src, &srclen, pxid++) != 8)
+			return -1;
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	assert(!clock_gettime(CLOCK_MONOTONIC, &ts));
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, int n, double secs)
+{
+	printf("%-8s %12.0f IDs/s\n", name, n / secs);
+}
+
+int main(int argc, char **argv)
+{
+	static const char *level_names[] = {"scalar", "sse2", "avx2"};
+	int n = argc > 1 ? atoi(argv[1]) : 1000000;
+	enum xia_simd_level best = xia_simd_level();
+	struct xia_xid xid;
+	char *strs;
+	double start;
+	int i, level;
+
+	assert(n > 0);
+	strs = malloc((size_t)n * (STRID_LEN + 1));
+	assert(strs);
+	for (i = 0; i < n; i++) {
+		char *s = strs + (size_t)i * (STRID_LEN + 1);
+		int j;
+		for (j = 0; j < STRID_LEN; j++)
+			s[j] = "0123456789abcdef"[rand() % 16];
+		s[STRID_LEN] = '\0';
+	}
+
+	start = now();
+	for (i = 0; i < n; i++) {
+		const char *s = strs + (size_t)i * (STRID_LEN + 1);
+		assert(!legacy_ptoid(s, STRID_LEN, &xid));
+	}
+	report("legacy", n, now() - start);
+
+	for (level = XIA_SIMD_NONE; level <= XIA_SIMD_AVX2; level++) {
+		if (xia_set_simd_level(level))
+			continue;
+		start = now();
+		for (i = 0; i < n; i++) {
+			const char *s = strs + (size_t)i * (STRID_LEN + 1);
+			assert(xia_ptoid(s, STRID_LEN, &xid) == STRID_LEN);
+		}
+		report(level_names[level], n, now() - start);
+	}
+
+	assert(!xia_set_simd_level(best));
+	free(strs);
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "dag_mt.h"
+
+#define NADDRS (64 * 1024)
+
+/* Edges likely to form valid addresses, but not always. */
+static __u8 random_edge(int node)
+{
+	switch (rand() % 16) {
+	case 0:
+		return rand() % 256;
+	case 1:
+		return XIA_CHOSEN_EDGE | (rand() % XIA_NODES_MAX);
+	case 2: case 3: case 4: case 5:
+		return XIA_EMPTY_EDGE;
+	default:
+		/* Mostly forward edges. */
+		return node + 1 - rand() % 2 + rand() % 3;
+	}
+}
+
+static void random_addr(struct xia_addr *addr)
+{
+	int n = rand() % (XIA_NODES_MAX + 1);
+	int i, j;
+
+	memset(addr, 0, sizeof(*addr));
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		struct xia_row *row = &addr->s_row[i];
+		int is_node = i < n;
+
+		/* Misplace XIDTYPE_NAT now and then. */
+		if (rand() % 64 == 0)
+			is_node = !is_node;
+		row->s_xid.xid_type = is_node ? __cpu_to_be32(0x11) :
+			XIDTYPE_NAT;
+		for (j = 0; j < XIA_OUTDEGREE_MAX; j++)
+			row->s_edge.a[j] = random_edge(i);
+		/* Sinks and the entry node often have no edges. */
+		if (rand() % 4 == 0)
+			row->s_edge.i = __cpu_to_be32(XIA_EMPTY_EDGES);
+	}
+	/* Keep a good share of valid addresses. */
+	if (n > 0 && rand() % 2) {
+		/* A chain of nodes that the entry node, the last row,
+		 * points to.
+		 */
+		for (i = 0; i < n; i++) {
+			addr->s_row[i].s_xid.xid_type = __cpu_to_be32(0x11);
+			addr->s_row[i].s_edge.i =
+				__cpu_to_be32(XIA_EMPTY_EDGES);
+			addr->s_row[i].s_edge.a[0] = i < n - 1 ? i + 1 : 0;
+		}
+	}
+}
+
+int main(void)
+{
+	struct xia_addr *addrs = malloc(NADDRS * sizeof(*addrs));
+	int *results = malloc(NADDRS * sizeof(*results));
+	int *results_mt = malloc(NADDRS * sizeof(*results_mt));
+	int seen[XIAEADDR_NO_ENTRY + 1] = {0};
+	int i, errors = 0, valid = 0;
+
+	assert(addrs && results && results_mt);
+	for (i = 0; i < NADDRS; i++)
+		random_addr(&addrs[i]);
+
+	for (i = 0; i < NADDRS; i++) {
+		int rc = xia_test_addr(&addrs[i]);
+		if (rc < 0) {
+			errors++;
+			seen[-rc] = 1;
+		} else if (rc > 0) {
+			valid++;
+		}
+	}
+	/* Make sure that every error is exercised. */
+	for (i = XIAEADDR_NAT_MISPLACED; i <= XIAEADDR_NO_ENTRY; i++)
+		assert(seen[i]);
+	assert(valid > NADDRS / 8);
+
+	assert(xia_test_addrs(addrs, results, NADDRS) == errors);
+	assert(xia_test_addrs_mt(addrs, results_mt, NADDRS, 4) == errors);
+	for (i = 0; i < NADDRS; i++) {
+		assert(results[i] == xia_test_addr(&addrs[i]));
+		assert(results_mt[i] == results[i]);
+	}
+
+	free(results_mt);
+	free(results);
+	free(addrs);
+	return 0;
+}
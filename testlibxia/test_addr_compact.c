@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "addr_compact.h"
+
+#define NADDRS	(16 * 1024)
+
+static struct xia_addr addrs[NADDRS];
+
+static __u8 random_edge(void)
+{
+	switch (rand() % 8) {
+	case 0:
+		return rand() % 256;
+	case 1:
+		return XIA_CHOSEN_EDGE | (rand() % XIA_NODES_MAX);
+	case 2: case 3: case 4:
+		return XIA_EMPTY_EDGE;
+	default:
+		return rand() % XIA_NODES_MAX;
+	}
+}
+
+static __u32 random_type(void)
+{
+	switch (rand() % 4) {
+	case 0:
+		return rand() | 1;
+	case 1:
+		return 0xffffffff;
+	default:
+		return 0x10 + rand() % 8;
+	}
+}
+
+/* Addresses with rows after their end, which are not encoded. */
+static void init_addrs(void)
+{
+	int i, j, k;
+
+	for (i = 0; i < NADDRS; i++) {
+		int n = rand() % (XIA_NODES_MAX + 1);
+		for (j = 0; j < XIA_NODES_MAX; j++) {
+			struct xia_row *row = &addrs[i].s_row[j];
+			row->s_xid.xid_type = j == n ? XIDTYPE_NAT :
+				__cpu_to_be32(random_type());
+			for (k = 0; k < XIA_XID_MAX; k++)
+				row->s_xid.xid_id[k] = rand();
+			for (k = 0; k < XIA_OUTDEGREE_MAX; k++)
+				row->s_edge.a[k] = random_edge();
+		}
+	}
+}
+
+/* @addr without the rows after its end. */
+static void expected_addr(const struct xia_addr *addr, struct xia_addr *exp)
+{
+	int i;
+
+	*exp = *addr;
+	for (i = 0; i < XIA_NODES_MAX; i++)
+		if (xia_is_nat(exp->s_row[i].s_xid.xid_type))
+			break;
+	memset(&exp->s_row[i], 0, (XIA_NODES_MAX - i) * sizeof(exp->s_row[0]));
+}
+
+static void test_codec(void)
+{
+	__u8 buf[XIA_COMPACT_ADDR_MAX], small[XIA_COMPACT_ADDR_MAX];
+	struct xia_addr got, exp;
+	int i, len, j;
+
+	for (i = 0; i < NADDRS; i++) {
+		len = xia_addr_encode(&addrs[i], buf, sizeof(buf));
+		assert(len > 0);
+		assert(xia_addr_decode(buf, len, &got) == len);
+		expected_addr(&addrs[i], &exp);
+		assert(!memcmp(&got, &exp, sizeof(got)));
+
+		/* Any prefix is incomplete, and too small buffers fail. */
+		for (j = 0; j < len; j++) {
+			assert(xia_addr_decode(buf, j, &got) == -EAGAIN);
+			assert(xia_addr_encode(&addrs[i], small, j) ==
+				-ENOSPC);
+		}
+	}
+
+	/* Too many rows. */
+	buf[0] = XIA_NODES_MAX + 1;
+	assert(xia_addr_decode(buf, sizeof(buf), &got) == -EINVAL);
+	/* A type with more than 32 bits. */
+	buf[0] = 1;
+	memset(buf + 1, 0xff, 5);
+	assert(xia_addr_decode(buf, sizeof(buf), &got) == -EINVAL);
+	/* XIDTYPE_NAT in a row. */
+	buf[1] = 0;
+	assert(xia_addr_decode(buf, sizeof(buf), &got) == -EINVAL);
+}
+
+/* A typical address of three rows shrinks over three times. */
+static void test_size(void)
+{
+	__u8 buf[XIA_COMPACT_ADDR_MAX];
+	struct xia_addr addr;
+	int i;
+
+	memset(&addr, 0, sizeof(addr));
+	for (i = 0; i < 3; i++) {
+		struct xia_row *row = &addr.s_row[i];
+		row->s_xid.xid_type = __cpu_to_be32(0x10 + i);
+		memset(row->s_xid.xid_id, i + 1, XIA_XID_MAX);
+		row->s_edge.i = __cpu_to_be32(XIA_EMPTY_EDGES);
+		if (i < 2)
+			row->s_edge.a[0] = i + 1;
+	}
+	assert(xia_addr_encode(&addr, buf, sizeof(buf)) * 3 <
+		(int)sizeof(addr));
+}
+
+static void test_stream(void)
+{
+	char file[] = "/tmp/test_addr_compact.XXXXXX";
+	struct xia_addr_writer *w;
+	struct xia_addr_reader *r;
+	struct xia_addr got[100], exp;
+	int fd = mkstemp(file);
+	int i, n, total = 0;
+
+	assert(fd >= 0);
+	w = xia_addr_writer_open(fd);
+	assert(w);
+	for (i = 0; i < NADDRS; i += 1000)
+		assert(!xia_addr_write(w, addrs + i,
+			NADDRS - i < 1000 ? NADDRS - i : 1000));
+	assert(!xia_addr_writer_close(w));
+
+	assert(!lseek(fd, 0, SEEK_SET));
+	r = xia_addr_reader_open(fd);
+	assert(r);
+	while ((n = xia_addr_read(r, got, 100)) > 0) {
+		for (i = 0; i < n; i++) {
+			expected_addr(&addrs[total + i], &exp);
+			assert(!memcmp(&got[i], &exp, sizeof(exp)));
+		}
+		total += n;
+	}
+	assert(!n);
+	assert(total == NADDRS);
+	xia_addr_reader_close(r);
+
+	/* A truncated file. */
+	assert(!ftruncate(fd, lseek(fd, 0, SEEK_END) - 1));
+	assert(!lseek(fd, 0, SEEK_SET));
+	r = xia_addr_reader_open(fd);
+	assert(r);
+	while ((n = xia_addr_read(r, got, 100)) > 0)
+		;
+	assert(n == -EINVAL);
+	xia_addr_reader_close(r);
+
+	/* Not a file of addresses. */
+	assert(!ftruncate(fd, 0));
+	assert(write(fd, "hello", 5) == 5);
+	assert(!lseek(fd, 0, SEEK_SET));
+	r = xia_addr_reader_open(fd);
+	assert(r);
+	assert(xia_addr_read(r, got, 100) == -EINVAL);
+	xia_addr_reader_close(r);
+
+	close(fd);
+	unlink(file);
+}
+
+static void test_write_error(void)
+{
+	struct xia_addr_writer *w;
+	int fd = open("/dev/null", O_RDONLY);
+
+	assert(fd >= 0);
+	w = xia_addr_writer_open(fd);
+	assert(w);
+	/* The buffer fills up, and its flush fails. */
+	assert(xia_addr_write(w, addrs, NADDRS) == -EBADF);
+	/* The error sticks. */
+	assert(xia_addr_write(w, addrs, 1) == -EBADF);
+	assert(xia_addr_writer_flush(w) == -EBADF);
+	assert(xia_addr_writer_close(w) == -EBADF);
+	close(fd);
+}
+
+int main(void)
+{
+	init_addrs();
+	test_codec();
+	test_size();
+	test_stream();
+	test_write_error();
+	return 0;
+}
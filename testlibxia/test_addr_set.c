@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "addr_set.h"
+
+#define NADDRS	(16 * 1024)
+
+static struct xia_addr addrs[NADDRS];
+static char present[NADDRS];
+
+static void random_row(struct xia_row *row)
+{
+	int i;
+
+	row->s_xid.xid_type = __cpu_to_be32(0x10 + rand() % 4);
+	/* Few distinct IDs, so that addresses share rows. */
+	memset(row->s_xid.xid_id, rand() % 8, XIA_XID_MAX);
+	for (i = 0; i < XIA_OUTDEGREE_MAX; i++)
+		row->s_edge.a[i] = rand() % 2 ? XIA_EMPTY_EDGE : rand() % 9;
+}
+
+/* Distinct addresses of up to XIA_NODES_MAX rows; the first row of each
+ * address carries its index, and only the first address is empty.
+ */
+static void init_addrs(void)
+{
+	int i, j;
+
+	for (i = 0; i < NADDRS; i++) {
+		int n = i ? 1 + i % XIA_NODES_MAX : 0;
+
+		for (j = 0; j < XIA_NODES_MAX; j++) {
+			random_row(&addrs[i].s_row[j]);
+			/* Junk after the end, which doesn't count. */
+			if (j >= n)
+				addrs[i].s_row[j].s_xid.xid_type =
+					XIDTYPE_NAT;
+		}
+		memcpy(addrs[i].s_row[0].s_xid.xid_id, &i, sizeof(i));
+	}
+}
+
+/* A copy of @addr with chosen edges and different junk. */
+static void twin_addr(struct xia_addr *twin, const struct xia_addr *addr)
+{
+	int i, j;
+
+	*twin = *addr;
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		if (xia_is_nat(twin->s_row[i].s_xid.xid_type)) {
+			twin->s_row[i].s_xid.xid_id[0]++;
+			twin->s_row[i].s_edge.i = ~twin->s_row[i].s_edge.i;
+			continue;
+		}
+		for (j = 0; j < XIA_OUTDEGREE_MAX; j++)
+			if (rand() % 2)
+				xia_mark_edge(&twin->s_row[i].s_edge.a[j]);
+	}
+}
+
+static void test_compare(void)
+{
+	struct xia_addr twin, canon;
+	int i;
+
+	for (i = 0; i < NADDRS; i++) {
+		twin_addr(&twin, &addrs[i]);
+		assert(xia_are_addrs_equal(&addrs[i], &twin));
+		assert(xia_addr_fingerprint(&addrs[i]) ==
+			xia_addr_fingerprint(&twin));
+		xia_canonical_addr(&canon, &twin);
+		assert(xia_are_addrs_equal(&canon, &addrs[i]));
+		xia_canonical_addr(&twin, &addrs[i]);
+		assert(!memcmp(&canon, &twin, sizeof(canon)));
+
+		/* Any other address differs. */
+		if (i) {
+			assert(!xia_are_addrs_equal(&addrs[i], &addrs[i - 1]));
+			assert(xia_addr_fingerprint(&addrs[i]) !=
+				xia_addr_fingerprint(&addrs[i - 1]));
+		}
+	}
+}
+
+static void check_set(const struct xia_addr_set *set)
+{
+	const struct xia_addr *addr;
+	size_t pos = 0, count = 0, expected = 0;
+	struct xia_addr twin;
+	void *value;
+	int i;
+
+	for (i = 0; i < NADDRS; i++) {
+		expected += present[i];
+		twin_addr(&twin, &addrs[i]);
+		value = xia_addr_set_find(set, &twin);
+		assert(!value == !present[i]);
+		if (value)
+			assert(*(int *)value == i);
+	}
+	assert(xia_addr_set_count(set) == expected);
+
+	while ((addr = xia_addr_set_next(set, &pos, &value))) {
+		assert(xia_addr_set_find(set, addr) == value);
+		assert(xia_are_addrs_equal(addr, &addrs[*(int *)value]));
+		count++;
+	}
+	assert(count == expected);
+}
+
+static void test_set(void)
+{
+	struct xia_addr_set *set = xia_addr_set_new(sizeof(int));
+	struct xia_addr twin;
+	int i, round;
+
+	assert(set);
+	check_set(set);
+	assert(!xia_addr_set_erase(set, &addrs[0]));
+
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < NADDRS; i++) {
+			int j = rand() % NADDRS;
+			void *value;
+
+			twin_addr(&twin, &addrs[j]);
+			if (rand() % 3) {
+				int rc = xia_addr_set_insert(set, &twin,
+					&value);
+				assert(rc == !present[j]);
+				if (rc)
+					*(int *)value = j;
+				present[j] = 1;
+			} else {
+				assert(xia_addr_set_erase(set, &twin) ==
+					present[j]);
+				present[j] = 0;
+			}
+		}
+		check_set(set);
+	}
+
+	xia_addr_set_free(set);
+}
+
+int main(void)
+{
+	init_addrs();
+	test_compare();
+	test_set();
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "ppal_map.h"
+
+#define ID "0123456789abcdef0123456789abcdef01234567"
+
+static const char *addrs[] = {
+	"hid-" ID,
+	"ad-" ID "-1:\nhid-" ID "-2:\nsid-" ID,
+	"!hid-" ID "-0",
+	"0x99-" ID,
+	"bogus-" ID,		/* Unknown principal. */
+	"",			/* Empty record. */
+	"hid-" ID "-",		/* Truncated edges. */
+	"AD-" ID "->1:\nHID-" ID,
+};
+#define NADDRS ((int)(sizeof(addrs) / sizeof(addrs[0])))
+
+/* Frame @addrs into @buf, and return the used size. */
+static size_t frame(char *buf, enum xia_rec_fmt fmt)
+{
+	char *p = buf;
+	int i;
+
+	for (i = 0; i < NADDRS; i++) {
+		size_t len = strlen(addrs[i]);
+		if (fmt == XIA_REC_LEN16) {
+			*p++ = len >> 8;
+			*p++ = len & 0xff;
+		}
+		memcpy(p, addrs[i], len);
+		p += len;
+		if (fmt == XIA_REC_NEWLINE && i < NADDRS - 1)
+			*p++ = '\n';
+	}
+	return p - buf;
+}
+
+static void test_pton_many(enum xia_rec_fmt fmt)
+{
+	char buf[NADDRS * XIA_MAX_STRADDR_SIZE];
+	struct xia_addr got[NADDRS + 1], want;
+	int status[NADDRS + 1];
+	size_t len = frame(buf, fmt), used;
+	int i;
+
+	assert(xia_pton_many(buf, len, fmt, got, status, NADDRS + 1, 0,
+		&used) == NADDRS);
+	assert(used == len);
+
+	for (i = 0; i < NADDRS; i++) {
+		int inv;
+		int rc = xia_pton(addrs[i], INT_MAX, &want, 0, &inv);
+		if (rc < 0) {
+			assert(status[i] == -1);
+			continue;
+		}
+		assert(status[i] == inv);
+		assert(!memcmp(&got[i], &want, sizeof(want)));
+	}
+
+	/* Stop after @n records. */
+	assert(xia_pton_many(buf, len, fmt, got, status, 2, 0, &used) == 2);
+	assert(xia_pton_many(buf + used, len - used, fmt, got + 2, status + 2,
+		NADDRS, 0, NULL) == NADDRS - 2);
+}
+
+/* Truncated records are left for the next call. */
+static void test_pton_many_partial(void)
+{
+	char buf[NADDRS * XIA_MAX_STRADDR_SIZE];
+	struct xia_addr got[NADDRS];
+	int status[NADDRS];
+	size_t len = frame(buf, XIA_REC_LEN16), used;
+
+	assert(xia_pton_many(buf, len - 1, XIA_REC_LEN16, got, status, NADDRS,
+		0, &used) == NADDRS - 1);
+	assert(used == len - 2 - strlen(addrs[NADDRS - 1]));
+}
+
+static void test_ntop_many(enum xia_rec_fmt fmt, int include_nl)
+{
+	struct xia_addr src[NADDRS], back[NADDRS];
+	char buf[NADDRS * XIA_MAX_STRADDR_SIZE];
+	int status[NADDRS];
+	size_t used, used2;
+	int i, n = 0;
+
+	for (i = 0; i < NADDRS; i++)
+		if (xia_pton(addrs[i], INT_MAX, &src[n], 0, NULL) >= 0)
+			n++;
+
+	assert(xia_ntop_many(src, n, fmt, buf, sizeof(buf), include_nl,
+		&used) == n);
+	assert(xia_pton_many(buf, used, fmt, back, status, n, 0, &used2) == n);
+	assert(used2 == used);
+	for (i = 0; i < n; i++) {
+		char s1[XIA_MAX_STRADDR_SIZE], s2[XIA_MAX_STRADDR_SIZE];
+		assert(status[i] >= 0);
+		assert(!memcmp(&src[i], &back[i], sizeof(src[i])));
+		assert(xia_ntop(&src[i], s1, sizeof(s1), include_nl) >= 0);
+		assert(xia_ntop(&back[i], s2, sizeof(s2), include_nl) >= 0);
+		assert(!strcmp(s1, s2));
+	}
+
+	/* Records that don't fit are not written. */
+	assert(xia_ntop_many(src, n, fmt, buf, used - 1, include_nl,
+		&used2) == n - 1);
+	assert(used2 < used);
+}
+
+static void test_xid_many(enum xia_rec_fmt fmt)
+{
+	struct xia_xid src[3], back[4];
+	char buf[4 * XIA_MAX_STRXID_SIZE];
+	int status[4];
+	size_t used;
+
+	assert(xia_ptoxid("hid-" ID, INT_MAX, &src[0]) >= 0);
+	assert(xia_ptoxid("0x99-" ID, INT_MAX, &src[1]) >= 0);
+	assert(xia_ptoxid("sid-" ID, INT_MAX, &src[2]) >= 0);
+
+	assert(xia_xidtop_many(src, 3, fmt, buf, sizeof(buf), &used) == 3);
+	assert(xia_ptoxid_many(buf, used, fmt, back, status, 4, NULL) == 3);
+	assert(!status[0] && !status[1] && !status[2]);
+	assert(!memcmp(src, back, sizeof(src)));
+
+	assert(xia_ptoxid_many("hid-" ID "\nbad\nsid-" ID, 4 + 40 + 5 + 4 + 40,
+		XIA_REC_NEWLINE, back, status, 4, NULL) == 3);
+	assert(!status[0] && status[1] == -1 && !status[2]);
+}
+
+int main(void)
+{
+	assert(!init_ppal_map("../etc-test/xia/principals"));
+
+	test_pton_many(XIA_REC_NEWLINE);
+	test_pton_many(XIA_REC_LEN16);
+	test_pton_many_partial();
+	test_ntop_many(XIA_REC_NEWLINE, 0);
+	test_ntop_many(XIA_REC_NEWLINE, 1);
+	test_ntop_many(XIA_REC_LEN16, 1);
+	test_xid_many(XIA_REC_NEWLINE);
+	test_xid_many(XIA_REC_LEN16);
+
+	assert(xia_pton_many("", 0, 7, NULL, NULL, 0, 0, NULL) == -EINVAL);
+	return 0;
+}
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "ppal_map.h"
+
+/* xia_ntop and xia_xidtop must give the same strings and return values
+ * as the snprintf-based formatter that they replaced, which follows.
+ */
+
+static inline int su_ge(signed int s, unsigned int u)
+{
+	return (s >= 0) && ((unsigned int)s >= u);
+}
+
+static int add_str(char *dst, size_t dstlen, const char *s)
+{
+	int rc = snprintf(dst, dstlen, "%s", s);
+	if (su_ge(rc, dstlen))
+		return -ENOSPC;
+	return rc;
+}
+
+static int add_char(char *dst, size_t dstlen, char ch)
+{
+	if (dstlen <= 1)
+		return -ENOSPC;
+	dst[0] = ch;
+	dst[1] = '\0';
+	return 1;
+}
+
+static void move_buf(char **dst, size_t *dstlen, int *tot, int step)
+{
+	(*dst) += step;
+	(*dstlen) -= step;
+	(*tot) += step;
+}
+
+static char edge_to_char(__u8 e)
+{
+	const char *ch_edge = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+	e &= ~XIA_CHOSEN_EDGE;
+	if (e < 36)
+		return ch_edge[e];
+	else if (is_empty_edge(e))
+		return '*';
+	else
+		return '+';
+}
+
+static int old_edges_to_str(int valid, char *dst, size_t dstlen,
+	const __u8 *edges)
+{
+	int tot = 0;
+	char *begin = dst;
+	int rc, i;
+
+	rc = add_char(dst, dstlen, '-');
+	if (rc < 0)
+		return rc;
+	move_buf(&dst, &dstlen, &tot, rc);
+
+	for (i = 0; i < XIA_OUTDEGREE_MAX; i++) {
+		if (valid && edges[i] == XIA_EMPTY_EDGE) {
+			if (i == 0) {
+				*begin = '\0';
+				return 0;
+			}
+			break;
+		}
+
+		if (is_edge_chosen(edges[i])) {
+			rc = add_char(dst, dstlen, '>');
+			if (rc < 0)
+				return rc;
+			move_buf(&dst, &dstlen, &tot, rc);
+		}
+
+		rc = add_char(dst, dstlen, edge_to_char(edges[i]));
+		if (rc < 0)
+			return rc;
+		move_buf(&dst, &dstlen, &tot, rc);
+	}
+	return tot;
+}
+
+static int old_tytop(xid_type_t ty, char *dst, size_t dstlen)
+{
+	if (dstlen < MAX_PPAL_NAME_SIZE)
+		return -ENOSPC;
+	if (ppal_type_to_name(ty, dst)) {
+		int rc = snprintf(dst, dstlen, "0x%x", __be32_to_cpu(ty));
+		if (su_ge(rc, dstlen))
+			return -ENOSPC;
+		return rc;
+	}
+	return strlen(dst);
+}
+
+static int old_idtop(const struct xia_xid *src, char *dst, size_t dstlen)
+{
+	const __be32 *pxid = (const __be32 *)src->xid_id;
+	int rc;
+
+	rc = snprintf(dst, dstlen, "%08x%08x%08x%08x%08x",
+		__be32_to_cpu(pxid[0]), __be32_to_cpu(pxid[1]),
+		__be32_to_cpu(pxid[2]), __be32_to_cpu(pxid[3]),
+		__be32_to_cpu(pxid[4]));
+	if (su_ge(rc, dstlen))
+		return -ENOSPC;
+	return rc;
+}
+
+static int old_xidtop(const struct xia_xid *src, char *dst, size_t dstlen)
+{
+	int tot = 0;
+	int rc;
+
+	rc = old_tytop(src->xid_type, dst, dstlen);
+	if (rc < 0)
+		return rc;
+	move_buf(&dst, &dstlen, &tot, rc);
+
+	rc = add_char(dst, dstlen, '-');
+	if (rc < 0)
+		return rc;
+	move_buf(&dst, &dstlen, &tot, rc);
+
+	rc = old_idtop(src, dst, dstlen);
+	if (rc < 0)
+		return rc;
+	move_buf(&dst, &dstlen, &tot, rc);
+
+	return tot;
+}
+
+static int old_ntop(const struct xia_addr *src, char *dst, size_t dstlen,
+	int include_nl)
+{
+	int tot = 0;
+	const char *node_sep = include_nl ? ":\n" : ":";
+	int valid = xia_test_addr(src) >= 1;
+	int rc, i;
+
+	if (!valid) {
+		rc = add_char(dst, dstlen, '!');
+		if (rc < 0)
+			return rc;
+		move_buf(&dst, &dstlen, &tot, rc);
+	}
+
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		const struct xia_row *row = &src->s_row[i];
+
+		if (xia_is_nat(row->s_xid.xid_type))
+			break;
+
+		if (i > 0) {
+			rc = add_str(dst, dstlen, node_sep);
+			if (rc < 0)
+				return rc;
+			move_buf(&dst, &dstlen, &tot, rc);
+		}
+
+		rc = old_xidtop(&row->s_xid, dst, dstlen);
+		if (rc < 0)
+			return rc;
+		move_buf(&dst, &dstlen, &tot, rc);
+
+		rc = old_edges_to_str(valid, dst, dstlen, row->s_edge.a);
+		if (rc < 0)
+			return rc;
+		move_buf(&dst, &dstlen, &tot, rc);
+	}
+
+	return tot;
+}
+
+/*
+ * Comparisons
+ */
+
+/* Names, numbers, and the largest type, whose number is the longest. */
+static const __u32 types[] = { 0x10, 0x11, 0x13, 0x99, 0xffffffff };
+#define NTYPES	(sizeof(types) / sizeof(types[0]))
+
+static void random_xid(struct xia_xid *xid)
+{
+	int i;
+
+	xid->xid_type = __cpu_to_be32(types[rand() % NTYPES]);
+	for (i = 0; i < XIA_XID_MAX; i++)
+		xid->xid_id[i] = rand();
+}
+
+/* A chain of @n rows, where rows may also skip the next one; the last
+ * row is the entry node, and points to the first row.
+ */
+static void valid_addr(struct xia_addr *addr, int n)
+{
+	int i;
+
+	memset(addr, 0, sizeof(*addr));
+	for (i = 0; i < n; i++) {
+		struct xia_row *row = &addr->s_row[i];
+
+		random_xid(&row->s_xid);
+		row->s_edge.i = XIA_EMPTY_EDGES;
+		if (i == n - 1) {
+			row->s_edge.a[0] = 0;
+			continue;
+		}
+		row->s_edge.a[0] = i + 1;
+		if (i + 2 < n && rand() % 2)
+			row->s_edge.a[1] = i + 2;
+	}
+}
+
+/* Rows with edges of any value, which are mostly invalid. */
+static void random_addr(struct xia_addr *addr, int n)
+{
+	int i, j;
+
+	memset(addr, 0, sizeof(*addr));
+	for (i = 0; i < n; i++) {
+		random_xid(&addr->s_row[i].s_xid);
+		for (j = 0; j < XIA_OUTDEGREE_MAX; j++)
+			addr->s_row[i].s_edge.a[j] = rand() % 3 ?
+				XIA_EMPTY_EDGE : rand();
+	}
+}
+
+static void check_xid(const struct xia_xid *xid)
+{
+	char want[XIA_MAX_STRXID_SIZE + 1], got[XIA_MAX_STRXID_SIZE + 1];
+	size_t dstlen;
+
+	for (dstlen = 0; dstlen <= sizeof(want); dstlen++) {
+		int rc_want = old_xidtop(xid, want, dstlen);
+		int rc = xia_xidtop(xid, got, dstlen);
+
+		assert(rc == rc_want);
+		if (rc >= 0)
+			assert(!memcmp(got, want, rc + 1));
+	}
+}
+
+/* Return true if @addr is valid. */
+static int check_addr(const struct xia_addr *addr)
+{
+	char want[XIA_MAX_STRADDR_SIZE + 2], got[XIA_MAX_STRADDR_SIZE + 2];
+	int valid = xia_test_addr(addr) >= 1;
+	int include_nl, i;
+
+	for (include_nl = 0; include_nl < 2; include_nl++) {
+		int len = old_ntop(addr, want, sizeof(want), include_nl);
+		size_t dstlen;
+
+		assert(len >= 0);
+		for (dstlen = 0; dstlen <= (size_t)len + 2; dstlen++) {
+			int rc_want = old_ntop(addr, want, dstlen, include_nl);
+			int rc;
+
+			memset(got, 'x', sizeof(got));
+			rc = xia_ntop(addr, got, dstlen, include_nl);
+			assert(rc == rc_want);
+			if (rc < 0)
+				continue;
+			assert(!memcmp(got, want, rc));
+			if (dstlen)
+				assert(got[rc] == '\0');
+			if (valid)
+				assert(xia_ntop_trusted(addr, got, dstlen,
+					include_nl) == rc);
+		}
+	}
+
+	for (i = 0; i < XIA_NODES_MAX; i++) {
+		if (xia_is_nat(addr->s_row[i].s_xid.xid_type))
+			break;
+		check_xid(&addr->s_row[i].s_xid);
+	}
+	return valid;
+}
+
+/* Empty addresses are invalid, and print as "!". */
+static void test_empty(void)
+{
+	struct xia_addr addr;
+	char buf[4];
+
+	memset(&addr, 0, sizeof(addr));
+	assert(!check_addr(&addr));
+	assert(xia_ntop(&addr, buf, 0, 0) == -ENOSPC);
+	assert(xia_ntop(&addr, buf, 1, 0) == -ENOSPC);
+	assert(xia_ntop(&addr, buf, 2, 0) == 1);
+	assert(!strcmp(buf, "!"));
+}
+
+static void test_random(void)
+{
+	struct xia_addr addr;
+	int i, valid = 0;
+
+	srand(1);
+	for (i = 0; i < 1000; i++) {
+		int n = rand() % (XIA_NODES_MAX + 1);
+
+		if (i % 2)
+			valid_addr(&addr, n);
+		else
+			random_addr(&addr, n);
+		valid += check_addr(&addr);
+	}
+	/* Both formats of edges were covered. */
+	assert(valid > 0 && valid < i);
+}
+
+int main(void)
+{
+	assert(!init_ppal_map("../etc-test/xia/principals"));
+	test_empty();
+	test_random();
+	return 0;
+}
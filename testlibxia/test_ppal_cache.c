@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <net/xia_dag.h>
+
+#include "ppal_map.h"
+
+/* Each check runs in a new process, since a process loads its principal
+ * map only once.
+ */
+
+static char map_file[] = "/tmp/test_ppal_cache.XXXXXX";
+static char cache_dir[] = "/tmp/test_ppal_cache_dir.XXXXXX";
+
+static void write_map(const char *content)
+{
+	FILE *f = fopen(map_file, "w");
+	assert(f);
+	fputs(content, f);
+	assert(!fclose(f));
+}
+
+/* Return the number of caches in the cache directory. */
+static int count_caches(void)
+{
+	DIR *dir = opendir(cache_dir);
+	struct dirent *ent;
+	int n = 0;
+
+	assert(dir);
+	while ((ent = readdir(dir)))
+		if (ent->d_name[0] != '.')
+			n++;
+	closedir(dir);
+	return n;
+}
+
+/* Return true if the process maps the cache. */
+static int is_cache_mapped(void)
+{
+	char line[512];
+	int found = 0;
+	FILE *f = fopen("/proc/self/maps", "r");
+
+	assert(f);
+	while (fgets(line, sizeof(line), f))
+		if (strstr(line, cache_dir))
+			found = 1;
+	fclose(f);
+	return found;
+}
+
+static void check_map(const char *name, __u32 type, int cached)
+{
+	xid_type_t ty;
+	char got[MAX_PPAL_NAME_SIZE];
+
+	assert(!init_ppal_map(map_file));
+	/* Loading waits for the first use. */
+	assert(!is_cache_mapped());
+	assert(!ppal_name_to_type(name, &ty));
+	assert(ty == __cpu_to_be32(type));
+	assert(is_cache_mapped() == cached);
+	assert(!ppal_type_to_name(__cpu_to_be32(type), got));
+	assert(!strcmp(got, name));
+
+	/* Changes copy the cached map into memory. */
+	assert(!ppal_add_map("extra", __cpu_to_be32(0x999)));
+	assert(!ppal_name_to_type(name, &ty));
+	assert(ty == __cpu_to_be32(type));
+	assert(!ppal_del_map(__cpu_to_be32(type)));
+	assert(ppal_name_to_type(name, &ty));
+	assert(!ppal_compile_map());
+	assert(!ppal_name_to_type("extra", &ty));
+}
+
+static void run(const char *name, __u32 type, int cached)
+{
+	pid_t pid = fork();
+	int status;
+
+	assert(pid >= 0);
+	if (!pid) {
+		check_map(name, type, cached);
+		exit(0);
+	}
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && !WEXITSTATUS(status));
+}
+
+static void test_import(void)
+{
+	size_t len;
+	void *buf;
+	__u32 *words;
+
+	assert(!init_ppal_map(map_file));
+	assert(!ppal_export_map(&buf, &len));
+	/* The map is not empty. */
+	assert(ppal_import_map(buf, len) == -EBUSY);
+	assert(ppal_import_map(buf, len - 1) == -EINVAL);
+	assert(ppal_import_map((char *)buf + 1, len - 1) == -EINVAL);
+	/* Too many entries for the length. */
+	words = buf;
+	words[0]++;
+	assert(ppal_import_map(buf, len) == -EINVAL);
+	free(buf);
+}
+
+int main(void)
+{
+	struct timespec times[2];
+	struct stat st;
+	char cmd[64];
+	int fd = mkstemp(map_file);
+
+	assert(fd >= 0);
+	close(fd);
+	assert(mkdtemp(cache_dir));
+	write_map("alpha 0x100\nbeta 0x101\n");
+
+	/* Without a cache directory, nothing is cached. */
+	run("alpha", 0x100, 0);
+	run("alpha", 0x100, 0);
+	assert(!count_caches());
+
+	assert(!setenv("XIA_PPAL_CACHE_DIR", cache_dir, 1));
+	/* The first process saves the cache, and the second one uses it. */
+	run("alpha", 0x100, 0);
+	assert(count_caches() == 1);
+	run("beta", 0x101, 1);
+
+	/* A changed file invalidates the cache. */
+	write_map("gamma 0x100\nbeta 0x101\n");
+	run("gamma", 0x100, 0);
+	run("gamma", 0x100, 1);
+
+	/* So does a file with a different content but the same size and
+	 * modification time, since its status change time differs.
+	 */
+	assert(!stat(map_file, &st));
+	write_map("delta 0x100\nbeta 0x101\n");
+	times[0] = st.st_atim;
+	times[1] = st.st_mtim;
+	assert(!utimensat(AT_FDCWD, map_file, times, 0));
+	run("delta", 0x100, 0);
+
+	assert(count_caches() == 1);
+
+	/* Files that cannot be read are reported right away. */
+	assert(init_ppal_map("/nonexistent/principals") < 0);
+
+	test_import();
+
+	unlink(map_file);
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", cache_dir);
+	assert(!system(cmd));
+	return 0;
+}
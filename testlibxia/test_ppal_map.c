@@ -1,19 +1,82 @@
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <assert.h>
 #include <net/xia_dag.h>
 
 #include "ppal_map.h"
 
-int main(void)
+#define EXTRA_PPALS 1000
+
+static void test_lookups(void)
 {
 	xid_type_t ty;
-	assert(!init_ppal_map("../etc-test/xia/principals"));
+	char name[MAX_PPAL_NAME_SIZE];
 
 	assert(!ppal_name_to_type("nat", &ty));
 	assert(!ppal_name_to_type("hid", &ty));
+	assert(ty == __cpu_to_be32(0x11));
 	assert(!ppal_name_to_type("Sid", &ty));
+	assert(ty == __cpu_to_be32(0x13));
 	assert(ppal_name_to_type("", &ty));
 	assert(ppal_name_to_type("XXX", &ty));
+	assert(ppal_name_to_type("hidd", &ty));
+	assert(ppal_name_to_type("a234567890123456789012345678901234567890",
+		&ty));
+
+	assert(!ppal_type_to_name(__cpu_to_be32(0x18), name));
+	assert(!strcmp(name, "serval"));
+	assert(ppal_type_to_name(__cpu_to_be32(0x1000), name));
+	assert(ppal_type_to_name(__cpu_to_be32(0x12345678), name));
+}
+
+/* Lookups must not depend on whether the map is compiled. */
+static void test_many(void)
+{
+	char name[MAX_PPAL_NAME_SIZE], got[MAX_PPAL_NAME_SIZE];
+	xid_type_t ty;
+	int i;
+
+	for (i = 0; i < EXTRA_PPALS; i++) {
+		snprintf(name, sizeof(name), "Extra%i", i);
+		assert(!ppal_add_map(name, __cpu_to_be32(0x100 + i)));
+	}
+	assert(!ppal_compile_map());
+
+	for (i = 0; i < EXTRA_PPALS; i++) {
+		snprintf(name, sizeof(name), "EXTRA%i", i);
+		assert(!ppal_name_to_type(name, &ty));
+		assert(ty == __cpu_to_be32(0x100 + i));
+		assert(!ppal_type_to_name(ty, got));
+		snprintf(name, sizeof(name), "extra%i", i);
+		assert(!strcmp(name, got));
+	}
+	assert(ppal_name_to_type("extra", &ty));
+	assert(ppal_name_to_type("extra1000", &ty));
+	test_lookups();
+
+	/* Large types cannot be compiled, but remain reachable. */
+	assert(!ppal_add_map("large", __cpu_to_be32(0x12345678)));
+	assert(ppal_compile_map() == -ERANGE);
+	assert(!ppal_name_to_type("LARGE", &ty));
+	assert(ty == __cpu_to_be32(0x12345678));
+	assert(!ppal_name_to_type("extra999", &ty));
+	assert(!ppal_del_map(__cpu_to_be32(0x12345678)));
+	assert(!ppal_compile_map());
+	assert(ppal_name_to_type("large", &ty));
+
+	for (i = 0; i < EXTRA_PPALS; i++)
+		assert(!ppal_del_map(__cpu_to_be32(0x100 + i)));
+	assert(!ppal_compile_map());
+	test_lookups();
+}
+
+int main(void)
+{
+	assert(!init_ppal_map("../etc-test/xia/principals"));
+
+	test_lookups();
+	test_many();
 
 	return 0;
 }
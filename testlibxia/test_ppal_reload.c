@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <net/xia_dag.h>
+
+#include "ppal_map.h"
+
+/* Readers look principals up while the map is reloaded from two files
+ * that map the same types to different names.
+ */
+
+#define PPALS		50
+#define READERS		4
+#define RELOADS		200
+#define FIRST_TYPE	0x100
+
+static char map_a[] = "/tmp/test_ppal_reload_a.XXXXXX";
+static char map_b[] = "/tmp/test_ppal_reload_b.XXXXXX";
+static char map_bad[] = "/tmp/test_ppal_reload_bad.XXXXXX";
+static volatile int done;
+
+static void write_map(char *file, char prefix, int bad)
+{
+	int fd = mkstemp(file);
+	FILE *f;
+	int i;
+
+	assert(fd >= 0);
+	f = fdopen(fd, "w");
+	assert(f);
+	for (i = 0; i < PPALS; i++)
+		fprintf(f, "%c%i 0x%x\n", prefix, i, FIRST_TYPE + i);
+	if (bad)
+		/* Too large to be compiled. */
+		fprintf(f, "huge 0x12345678\n");
+	assert(!fclose(f));
+}
+
+static void *reader(void *arg)
+{
+	char name[MAX_PPAL_NAME_SIZE];
+	xid_type_t ty;
+	unsigned int seed = (unsigned long)arg;
+
+	while (!done) {
+		int i = rand_r(&seed) % PPALS;
+		char a[8], b[8];
+
+		snprintf(a, sizeof(a), "a%i", i);
+		snprintf(b, sizeof(b), "b%i", i);
+
+		/* Every type is always in either map. */
+		assert(!ppal_type_to_name(__cpu_to_be32(FIRST_TYPE + i), name));
+		assert(!strcmp(name, a) || !strcmp(name, b));
+
+		if (!ppal_name_to_type(a, &ty))
+			assert(ty == __cpu_to_be32(FIRST_TYPE + i));
+		if (!ppal_name_to_type(b, &ty))
+			assert(ty == __cpu_to_be32(FIRST_TYPE + i));
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t threads[READERS];
+	char name[MAX_PPAL_NAME_SIZE];
+	xid_type_t ty;
+	int i;
+
+	write_map(map_a, 'a', 0);
+	write_map(map_b, 'b', 0);
+	write_map(map_bad, 'c', 1);
+
+	assert(!init_ppal_map(map_a));
+	for (i = 0; i < READERS; i++)
+		assert(!pthread_create(&threads[i], NULL, reader,
+			(void *)(unsigned long)i));
+
+	for (i = 0; i < RELOADS; i++)
+		assert(!reload_ppal_map(i & 1 ? map_a : map_b));
+	/* The last reload loaded map_a; reloading it again is a no-op. */
+	assert(!reload_ppal_map(map_a));
+
+	done = 1;
+	for (i = 0; i < READERS; i++)
+		assert(!pthread_join(threads[i], NULL));
+
+	assert(!ppal_name_to_type("a1", &ty));
+	assert(ty == __cpu_to_be32(FIRST_TYPE + 1));
+	assert(ppal_name_to_type("b1", &ty));
+	assert(ppal_name_to_type("hid", &ty));
+
+	/* A map that cannot be compiled is loaded all the same. */
+	assert(!reload_ppal_map(map_bad));
+	assert(!ppal_type_to_name(__cpu_to_be32(FIRST_TYPE), name));
+	assert(!strcmp(name, "c0"));
+	assert(!ppal_name_to_type("huge", &ty));
+	assert(ty == __cpu_to_be32(0x12345678));
+	assert(!ppal_type_to_name(__cpu_to_be32(0x12345678), name));
+	assert(!strcmp(name, "huge"));
+	assert(ppal_name_to_type("a1", &ty));
+
+	/* And it is replaced as any other map. */
+	assert(!reload_ppal_map(map_b));
+	assert(!ppal_name_to_type("b1", &ty));
+	assert(ty == __cpu_to_be32(FIRST_TYPE + 1));
+	assert(ppal_name_to_type("huge", &ty));
+
+	unlink(map_a);
+	unlink(map_b);
+	unlink(map_bad);
+	return 0;
+}
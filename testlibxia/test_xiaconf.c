@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <linux/rtnetlink.h>
+#include <net/xia_fib.h>
+#include <xia_socket.h>
+
+#include "xiaconf.h"
+
+/* Requests are built, and decoded back as the kernel would echo them. */
+
+static void fill_xid(struct xia_xid *xid, __u32 type, int seed)
+{
+	xid->xid_type = __cpu_to_be32(type);
+	memset(xid->xid_id, seed, XIA_XID_MAX);
+}
+
+static const struct rtattr *find_attr(const struct nlmsghdr *n, int type)
+{
+	const struct rtmsg *r = NLMSG_DATA(n);
+	const struct rtattr *rta;
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+
+	for (rta = RTM_RTA(r); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+		if (rta->rta_type == type)
+			return rta;
+	return NULL;
+}
+
+static void test_local(void)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	const struct rtmsg *r = NLMSG_DATA(&req.n);
+	struct xiaconf_route rt, got;
+	__u8 prefix_len = 24;
+
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_LOCAL_INDEX;
+	fill_xid(&rt.dst, 0x10, 1);
+	/* Locals have no gateways, even if one is given. */
+	fill_xid(&rt.gw, 0x11, 2);
+	rt.has_gw = 1;
+	rt.protoinfo_len = sizeof(prefix_len);
+	memcpy(rt.protoinfo, &prefix_len, sizeof(prefix_len));
+
+	assert(!xiaconf_request(&req.n, sizeof(req), XIACONF_ADD, &rt));
+	assert(req.n.nlmsg_type == RTM_NEWROUTE);
+	assert(req.n.nlmsg_flags ==
+		(NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL));
+	assert(r->rtm_family == AF_XIA);
+	assert(r->rtm_type == RTN_LOCAL);
+	assert(r->rtm_scope == RT_SCOPE_HOST);
+	assert(!find_attr(&req.n, RTA_GATEWAY));
+
+	assert(xiaconf_parse_route(&req.n, &got) == 1);
+	assert(got.tbl_id == XRTABLE_LOCAL_INDEX);
+	assert(!memcmp(&got.dst, &rt.dst, sizeof(rt.dst)));
+	assert(!got.has_gw);
+	assert(got.protoinfo_len == 1 && got.protoinfo[0] == prefix_len);
+	assert(got.protocol == RTPROT_BOOT);
+
+	assert(!xiaconf_request(&req.n, sizeof(req), XIACONF_DEL, &rt));
+	assert(req.n.nlmsg_type == RTM_DELROUTE);
+	assert(req.n.nlmsg_flags == NLM_F_REQUEST);
+	assert(find_attr(&req.n, RTA_PROTOINFO));
+}
+
+static void test_route(void)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	const struct rtmsg *r = NLMSG_DATA(&req.n);
+	struct xiaconf_route rt, got;
+
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_MAIN_INDEX;
+	fill_xid(&rt.dst, 0x10, 3);
+	fill_xid(&rt.gw, 0x11, 4);
+	rt.has_gw = 1;
+
+	assert(!xiaconf_request(&req.n, sizeof(req), XIACONF_REPLACE, &rt));
+	assert(req.n.nlmsg_flags == (NLM_F_REQUEST|NLM_F_REPLACE));
+	assert(r->rtm_type == RTN_UNICAST);
+	assert(r->rtm_scope == RT_SCOPE_LINK);
+	assert(!find_attr(&req.n, RTA_PROTOINFO));
+	assert(xiaconf_parse_route(&req.n, &got) == 1);
+	assert(got.tbl_id == XRTABLE_MAIN_INDEX);
+	assert(got.has_gw && !memcmp(&got.gw, &rt.gw, sizeof(rt.gw)));
+
+	/* Deletions do not carry gateways. */
+	assert(!xiaconf_request(&req.n, sizeof(req), XIACONF_DEL, &rt));
+	assert(r->rtm_scope == RT_SCOPE_NOWHERE);
+	assert(!find_attr(&req.n, RTA_GATEWAY));
+
+	/* Buffers too small. */
+	assert(xiaconf_request(&req.n, NLMSG_SPACE(sizeof(*r)) + 8,
+		XIACONF_ADD, &rt) == -EMSGSIZE);
+	rt.protoinfo_len = XIACONF_PROTOINFO_MAX + 1;
+	assert(xiaconf_request(&req.n, sizeof(req), XIACONF_ADD, &rt) ==
+		-EMSGSIZE);
+}
+
+static void test_get(void)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	const struct rtmsg *r = NLMSG_DATA(&req.n);
+	const struct rtattr *rta;
+	struct xia_xid dst;
+
+	fill_xid(&dst, 0x10, 6);
+	assert(!xiaconf_get_request(&req.n, sizeof(req), XRTABLE_MAIN_INDEX,
+		&dst));
+	assert(req.n.nlmsg_type == RTM_GETROUTE);
+	/* A lookup, not a dump. */
+	assert(req.n.nlmsg_flags == NLM_F_REQUEST);
+	assert(r->rtm_family == AF_XIA);
+	assert(r->rtm_dst_len == sizeof(dst));
+	rta = find_attr(&req.n, RTA_DST);
+	assert(rta && RTA_PAYLOAD(rta) == sizeof(dst));
+	assert(!memcmp(RTA_DATA(rta), &dst, sizeof(dst)));
+	rta = find_attr(&req.n, RTA_TABLE);
+	assert(rta && *(const __u32 *)RTA_DATA(rta) == XRTABLE_MAIN_INDEX);
+
+	assert(xiaconf_get_request(&req.n, NLMSG_SPACE(sizeof(*r)) + 8,
+		XRTABLE_MAIN_INDEX, &dst) == -EMSGSIZE);
+}
+
+static void test_parse(void)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	struct rtmsg *r = NLMSG_DATA(&req.n);
+	struct rtattr *rta;
+	struct xiaconf_route rt, got;
+
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_LOCAL_INDEX;
+	fill_xid(&rt.dst, 0x10, 5);
+
+	assert(!xiaconf_request(&req.n, sizeof(req), XIACONF_ADD, &rt));
+	r->rtm_flags |= RTM_F_CLONED;
+	assert(xiaconf_parse_route(&req.n, &got) == 0);
+	r->rtm_flags = 0;
+	r->rtm_family = AF_INET;
+	assert(xiaconf_parse_route(&req.n, &got) == 0);
+	r->rtm_family = AF_XIA;
+	req.n.nlmsg_type = RTM_NEWLINK;
+	assert(xiaconf_parse_route(&req.n, &got) == 0);
+	req.n.nlmsg_type = RTM_NEWROUTE;
+
+	/* Destinations that are not XIDs. */
+	rta = (struct rtattr *)RTM_RTA(r);
+	rta->rta_len = RTA_LENGTH(sizeof(xid_type_t));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(*r)) +
+		RTA_SPACE(sizeof(xid_type_t));
+	assert(xiaconf_parse_route(&req.n, &got) == -EINVAL);
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(*r)) - 1;
+	assert(xiaconf_parse_route(&req.n, &got) == -EINVAL);
+}
+
+int main(void)
+{
+	test_local();
+	test_route();
+	test_get();
+	test_parse();
+	return 0;
+}
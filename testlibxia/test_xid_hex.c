@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <net/xia_dag.h>
+
+#include "xid_hex.h"
+
+#define ID_DIGITS (XIA_XID_MAX * 2)
+
+static const char digits[] = "0123456789abcdefABCDEF";
+
+/* Decode @src with all available levels, and verify that they agree. */
+static int decode_all(const char *src, __u8 *id)
+{
+	__u8 ref[XIA_XID_MAX], got[XIA_XID_MAX];
+	int level, rc;
+
+	assert(!xia_set_simd_level(XIA_SIMD_NONE));
+	rc = xia_hex_to_id(src, ref);
+
+	for (level = XIA_SIMD_SSE2; level <= XIA_SIMD_AVX2; level++) {
+		if (xia_set_simd_level(level))
+			continue;
+		assert(xia_hex_to_id(src, got) == rc);
+		if (!rc)
+			assert(!memcmp(ref, got, sizeof(ref)));
+	}
+
+	if (!rc)
+		memcpy(id, ref, sizeof(ref));
+	return rc;
+}
+
+static void test_random(void)
+{
+	char src[ID_DIGITS + 1];
+	__u8 id[XIA_XID_MAX];
+	int i, j;
+
+	for (i = 0; i < 100000; i++) {
+		for (j = 0; j < ID_DIGITS; j++)
+			src[j] = digits[rand() % (sizeof(digits) - 1)];
+		src[ID_DIGITS] = '\0';
+
+		/* Valid IDs must match the value printed back. */
+		if (i & 1) {
+			char out[XIA_MAX_STRID_SIZE];
+			struct xia_xid xid;
+			assert(!decode_all(src, id));
+			memcpy(xid.xid_id, id, sizeof(id));
+			assert(xia_idtop(&xid, out, sizeof(out)) == ID_DIGITS);
+			for (j = 0; j < ID_DIGITS; j++)
+				assert(out[j] == (src[j] | 0x20));
+			continue;
+		}
+
+		/* Spoil one char with anything. */
+		j = rand() % ID_DIGITS;
+		src[j] = rand() % 256;
+		if (strchr(digits, src[j]) && src[j])
+			assert(!decode_all(src, id));
+		else
+			assert(decode_all(src, id));
+	}
+}
+
+/* All levels must encode IDs as the scalar encoder does. */
+static void test_encode(void)
+{
+	char ref[ID_DIGITS], got[ID_DIGITS];
+	__u8 id[XIA_XID_MAX];
+	int i, j, level;
+
+	for (i = 0; i < 10000; i++) {
+		for (j = 0; j < XIA_XID_MAX; j++)
+			id[j] = rand() % 256;
+
+		assert(!xia_set_simd_level(XIA_SIMD_NONE));
+		xia_id_to_hex(id, ref);
+		for (level = XIA_SIMD_SSE2; level <= XIA_SIMD_AVX2; level++) {
+			if (xia_set_simd_level(level))
+				continue;
+			xia_id_to_hex(id, got);
+			assert(!memcmp(ref, got, sizeof(ref)));
+		}
+
+		for (j = 0; j < XIA_XID_MAX; j++) {
+			char pair[3];
+			snprintf(pair, sizeof(pair), "%02x", id[j]);
+			assert(!memcmp(pair, ref + j * 2, 2));
+		}
+	}
+}
+
+/* IDs at the end of a page followed by an unmapped page. */
+static void test_page_boundary(void)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	char *map, *src;
+	__u8 id[XIA_XID_MAX];
+	int i;
+
+	map = mmap(NULL, page * 2, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(map != MAP_FAILED);
+	assert(!mprotect(map + page, page, PROT_NONE));
+
+	/* Short IDs terminated by '\0' must fail without faulting. */
+	for (i = 0; i < ID_DIGITS; i++) {
+		src = map + page - i - 1;
+		memset(src, 'a', i);
+		src[i] = '\0';
+		assert(decode_all(src, id));
+	}
+
+	/* A full ID that ends at the boundary. */
+	src = map + page - ID_DIGITS;
+	memset(src, 'a', ID_DIGITS);
+	assert(!decode_all(src, id));
+
+	munmap(map, page * 2);
+}
+
+int main(void)
+{
+	enum xia_simd_level best = xia_simd_level();
+
+	test_random();
+	test_encode();
+	test_page_boundary();
+
+	assert(!xia_set_simd_level(best));
+	return 0;
+}
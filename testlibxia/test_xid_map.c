@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <net/xia.h>
+
+#include "xid_map.h"
+
+#define NXIDS	(64 * 1024)
+
+static struct xia_xid xids[NXIDS];
+static char present[NXIDS];
+
+/* Random XIDs, and XIDs that only differ in a few bits. */
+static void init_xids(void)
+{
+	int i, j;
+
+	for (i = 0; i < NXIDS; i++) {
+		xids[i].xid_type = __cpu_to_be32(0x10 + i % 4);
+		if (i & 1) {
+			for (j = 0; j < XIA_XID_MAX; j++)
+				xids[i].xid_id[j] = rand();
+		} else {
+			memset(xids[i].xid_id, 0, XIA_XID_MAX);
+			memcpy(xids[i].xid_id + XIA_XID_MAX - sizeof(i), &i,
+				sizeof(i));
+		}
+	}
+}
+
+/* The map must hold exactly the XIDs marked present. */
+static void check_map(const struct xia_xid_map *map, int with_values)
+{
+	void **values = malloc(NXIDS * sizeof(*values));
+	const struct xia_xid *xid;
+	size_t pos = 0, count = 0, expected = 0;
+	void *value;
+	int i;
+
+	assert(values);
+	for (i = 0; i < NXIDS; i++)
+		expected += present[i];
+	assert(xia_xid_map_count(map) == expected);
+	assert(xia_xid_map_find_many(map, xids, NXIDS, values) ==
+		(int)expected);
+
+	for (i = 0; i < NXIDS; i++) {
+		value = xia_xid_map_find(map, &xids[i]);
+		assert(value == values[i]);
+		assert(!value == !present[i]);
+		if (value && with_values)
+			assert(*(int *)value == i);
+	}
+
+	while ((xid = xia_xid_map_next(map, &pos, &value))) {
+		assert(xia_xid_map_find(map, xid) == value);
+		count++;
+	}
+	assert(count == expected);
+	free(values);
+}
+
+static void test_single(int with_values)
+{
+	struct xia_xid_map *map = xia_xid_map_new(with_values ?
+		sizeof(int) : 0);
+	int i, round;
+
+	assert(map);
+	memset(present, 0, sizeof(present));
+	check_map(map, with_values);
+	assert(!xia_xid_map_erase(map, &xids[0]));
+
+	/* Churn leaves deleted slots behind. */
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < NXIDS; i++) {
+			int j = rand() % NXIDS;
+			void *value;
+
+			if (rand() % 3) {
+				int rc = xia_xid_map_insert(map, &xids[j],
+					&value);
+				assert(rc == !present[j]);
+				if (with_values && rc)
+					*(int *)value = j;
+				present[j] = 1;
+			} else {
+				assert(xia_xid_map_erase(map, &xids[j]) ==
+					present[j]);
+				present[j] = 0;
+			}
+		}
+		check_map(map, with_values);
+	}
+
+	xia_xid_map_clear(map);
+	memset(present, 0, sizeof(present));
+	check_map(map, with_values);
+	xia_xid_map_free(map);
+}
+
+static void test_many(void)
+{
+	struct xia_xid_map *map = xia_xid_map_new(sizeof(int));
+	int *values = malloc(NXIDS * sizeof(*values));
+	int *results = malloc(NXIDS * sizeof(*results));
+	struct xia_xid dups[2];
+	int i, added;
+
+	assert(map && values && results);
+	memset(present, 0, sizeof(present));
+	for (i = 0; i < NXIDS; i++)
+		values[i] = i;
+
+	/* The first half, then all XIDs. */
+	assert(xia_xid_map_insert_many(map, xids, values, NXIDS / 2,
+		results) == NXIDS / 2);
+	memset(present, 1, NXIDS / 2);
+	check_map(map, 1);
+	added = xia_xid_map_insert_many(map, xids, values, NXIDS, results);
+	assert(added == NXIDS - NXIDS / 2);
+	for (i = 0; i < NXIDS; i++)
+		assert(results[i] == (i >= NXIDS / 2));
+	memset(present, 1, NXIDS);
+	check_map(map, 1);
+
+	/* Every other XID, twice. */
+	assert(xia_xid_map_erase_many(map, xids, NXIDS / 2) == NXIDS / 2);
+	assert(!xia_xid_map_erase_many(map, xids, NXIDS / 2));
+	memset(present, 0, NXIDS / 2);
+	check_map(map, 1);
+
+	/* Duplicates within a batch are added once. */
+	xia_xid_map_clear(map);
+	memset(present, 0, sizeof(present));
+	memcpy(&dups[0], &xids[0], sizeof(xids[0]));
+	memcpy(&dups[1], &xids[0], sizeof(xids[0]));
+	assert(xia_xid_map_insert_many(map, dups, values, 2, results) == 1);
+	assert(results[0] == 1 && results[1] == 0);
+	present[0] = 1;
+	check_map(map, 1);
+
+	free(values);
+	free(results);
+	xia_xid_map_free(map);
+}
+
+int main(void)
+{
+	init_xids();
+	test_single(0);
+	test_single(1);
+	test_many();
+	return 0;
+}
@@ -0,0 +1,362 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <net/xia_dag.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+
+/* Compiled batch files
+ *
+ * xip compile runs the lines of a batch file as a batch would, but keeps
+ * the requests they build instead of sending them; xip -replay sends
+ * those requests again without parsing anything. A compiled file is:
+ *
+ *	struct compiled_header
+ *	name of the batch file, padded to NLMSG_ALIGNTO
+ *	struct compiled_rec and its request, for every request
+ *
+ * XID types in the requests come from the principal map, so the header
+ * carries a hash of the map, and replays under another map are refused.
+ * Only the lines that change a single entry (see xip_is_entry_cmd())
+ * can be compiled, since any other line may depend on the state of
+ * the kernel when it runs. Compiled files are in host byte order.
+ */
+
+static int usage(void)
+{
+	fprintf(stderr, "Usage: xip compile BATCH_FILE COMPILED_FILE\n");
+	return -1;
+}
+
+#define COMPILED_MAGIC		"XIPC"
+#define COMPILED_VERSION	1
+
+struct compiled_header {
+	char		magic[4];
+	__u32		version;
+	__u64		map_hash;
+	__u32		nr_msgs;
+	__u32		name_len;	/* Not counting the padding.	*/
+};
+
+struct compiled_rec {
+	__u32		lineno;		/* Line of the batch file.	*/
+};
+
+/* RETURN zero, and set *@phash to the hash of the compiled principal map,
+ *	or a negative number on failure.
+ */
+static int map_hash(__u64 *phash)
+{
+	const __u8 *p;
+	void *buf;
+	size_t len, i;
+	__u64 hash = 14695981039346656037ULL;
+	int rc = ppal_export_map(&buf, &len);
+
+	if (rc) {
+		fprintf(stderr, "Cannot export the principal map: %s\n",
+			strerror(-rc));
+		return rc;
+	}
+	for (p = buf, i = 0; i < len; i++)
+		hash = (hash ^ p[i]) * 1099511628211ULL;
+	free(buf);
+	*phash = hash;
+	return 0;
+}
+
+/*
+ *	Compile
+ */
+
+static struct {
+	FILE		*out;
+	__u32		nr_msgs;
+	int		err;
+} comp;
+
+static int write_padded(const void *buf, size_t len)
+{
+	static const char zeros[NLMSG_ALIGNTO];
+	size_t pad = NLMSG_ALIGN(len) - len;
+
+	if (fwrite(buf, 1, len, comp.out) != len ||
+		fwrite(zeros, 1, pad, comp.out) != pad) {
+		comp.err = errno;
+		return -1;
+	}
+	return 0;
+}
+
+static int record(struct nlmsghdr *n)
+{
+	struct compiled_rec rec = { .lineno = cmdlineno };
+
+	/* Sequence numbers are assigned when requests are sent. */
+	n->nlmsg_seq = 0;
+	n->nlmsg_pid = 0;
+	if (write_padded(&rec, sizeof(rec)) ||
+		write_padded(n, n->nlmsg_len))
+		return -1;
+	comp.nr_msgs++;
+	return 0;
+}
+
+static int compile_lines(const char *in_name, FILE *in)
+{
+	struct cmdfile cf;
+	char *largv[100];
+	int largc, ret = 0;
+
+	if (cmdfile_open(&cf, in))
+		return -1;
+	cmdlineno = 0;
+	while ((largc = cmdfile_next(&cf, largv, 100)) != -1) {
+		if (largc == 0)
+			continue;	/* blank line */
+		if (!xip_is_entry_cmd(largc, largv)) {
+			fprintf(stderr, "Command cannot be compiled %s:%d\n",
+				in_name, cmdlineno);
+			ret = -1;
+			break;
+		}
+		if (xip_do_cmd(largc, largv)) {
+			fprintf(stderr, "Command failed %s:%d\n", in_name,
+				cmdlineno);
+			ret = -1;
+			break;
+		}
+	}
+	cmdfile_close(&cf);
+	return ret;
+}
+
+int do_compile(int argc, char **argv)
+{
+	struct compiled_header hdr;
+	const char *in_name, *out_name;
+	FILE *in;
+	int ret;
+
+	if (argc != 2) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+	in_name = argv[0];
+	out_name = argv[1];
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, COMPILED_MAGIC, sizeof(hdr.magic));
+	hdr.version = COMPILED_VERSION;
+	hdr.name_len = strlen(in_name);
+	if (map_hash(&hdr.map_hash))
+		exit(1);
+
+	in = fopen(in_name, "r");
+	if (!in) {
+		fprintf(stderr, "Cannot open file '%s': %s\n", in_name,
+			strerror(errno));
+		exit(1);
+	}
+	memset(&comp, 0, sizeof(comp));
+	comp.out = fopen(out_name, "w");
+	if (!comp.out) {
+		fprintf(stderr, "Cannot open file '%s': %s\n", out_name,
+			strerror(errno));
+		exit(1);
+	}
+
+	/* The header is written again once @nr_msgs is known. */
+	ret = write_padded(&hdr, sizeof(hdr)) ||
+		write_padded(in_name, hdr.name_len);
+	if (!ret) {
+		xip_talk_hook = record;
+		ret = compile_lines(in_name, in);
+		xip_talk_hook = NULL;
+	}
+	fclose(in);
+
+	if (!ret) {
+		hdr.nr_msgs = comp.nr_msgs;
+		if (fseek(comp.out, 0, SEEK_SET) ||
+			fwrite(&hdr, sizeof(hdr), 1, comp.out) != 1) {
+			comp.err = errno;
+			ret = -1;
+		}
+	}
+	if (fclose(comp.out) && !comp.err) {
+		comp.err = errno;
+		ret = -1;
+	}
+	if (ret) {
+		if (comp.err)
+			fprintf(stderr, "Cannot write file '%s': %s\n",
+				out_name, strerror(comp.err));
+		unlink(out_name);
+		return 1;
+	}
+	if (show_details)
+		printf("%u requests compiled\n", comp.nr_msgs);
+	return 0;
+}
+
+/*
+ *	Replay
+ */
+
+static char *source;	/* Name of the batch file.	*/
+
+static void replay_error(int tag, int err, void *arg)
+{
+	UNUSED(arg);
+	fprintf(stderr, "RTNETLINK answers: %s\n", strerror(-err));
+	fprintf(stderr, "Command failed %s:%d\n", source, tag);
+}
+
+/* Read the whole of @name; RETURN the buffer, or NULL on failure. */
+static char *read_file(const char *name, size_t *plen)
+{
+	struct stat st;
+	char *buf;
+	FILE *f = fopen(name, "r");
+
+	if (!f) {
+		fprintf(stderr, "Cannot open file '%s': %s\n", name,
+			strerror(errno));
+		return NULL;
+	}
+	if (fstat(fileno(f), &st)) {
+		fprintf(stderr, "Cannot stat file '%s': %s\n", name,
+			strerror(errno));
+		fclose(f);
+		return NULL;
+	}
+	buf = malloc(st.st_size + 1);
+	if (!buf) {
+		fprintf(stderr, "Cannot allocate memory for '%s'\n", name);
+	} else if (fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		fprintf(stderr, "Cannot read file '%s'\n", name);
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+	*plen = st.st_size;
+	return buf;
+}
+
+/* RETURN the request of the record at @off, or NULL if the record does
+ *	not fit in the @len bytes of @buf.
+ */
+static struct nlmsghdr *rec_msg(char *buf, size_t len, size_t off)
+{
+	struct nlmsghdr *n;
+
+	if (len - off < sizeof(struct compiled_rec) + NLMSG_HDRLEN)
+		return NULL;
+	n = (struct nlmsghdr *)(buf + off + sizeof(struct compiled_rec));
+	len -= off + sizeof(struct compiled_rec);
+	if (n->nlmsg_len < NLMSG_HDRLEN || n->nlmsg_len > len ||
+		NLMSG_ALIGN(n->nlmsg_len) > len)
+		return NULL;
+	return n;
+}
+
+int xip_replay(const char *name)
+{
+	const struct compiled_header *hdr;
+	struct rtnl_batch nlb;
+	size_t len, start, off;
+	__u64 hash;
+	__u32 i;
+	char *buf;
+	int ret = 0;
+
+	buf = read_file(name, &len);
+	if (!buf)
+		return -1;
+
+	hdr = (const struct compiled_header *)buf;
+	if (len < sizeof(*hdr) ||
+		memcmp(hdr->magic, COMPILED_MAGIC, sizeof(hdr->magic))) {
+		fprintf(stderr, "'%s' is not a compiled batch file\n", name);
+		goto fail;
+	}
+	if (hdr->version != COMPILED_VERSION) {
+		fprintf(stderr, "'%s' has unknown version %u\n", name,
+			hdr->version);
+		goto fail;
+	}
+	if (map_hash(&hash))
+		goto fail;
+	if (hash != hdr->map_hash) {
+		fprintf(stderr, "'%s' was compiled with another principal "
+			"map\n", name);
+		goto fail;
+	}
+
+	/* Check every record before anything is sent. */
+	if (hdr->name_len > len - sizeof(*hdr))
+		goto malformed;
+	start = off = sizeof(*hdr) + NLMSG_ALIGN(hdr->name_len);
+	for (i = 0; i < hdr->nr_msgs; i++) {
+		struct nlmsghdr *n = off <= len ? rec_msg(buf, len, off) :
+			NULL;
+
+		if (!n)
+			goto malformed;
+		off += sizeof(struct compiled_rec) + NLMSG_ALIGN(n->nlmsg_len);
+	}
+	if (off != len)
+		goto malformed;
+
+	source = strndup(buf + sizeof(*hdr), hdr->name_len);
+	if (!source) {
+		fprintf(stderr, "Cannot allocate memory for '%s'\n", name);
+		goto fail;
+	}
+	if (rtnl_open(&rth, 0) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink\n");
+		goto fail;
+	}
+	if (xip_batch_begin(&nlb, replay_error, NULL) < 0) {
+		rtnl_close(&rth);
+		goto fail;
+	}
+
+	/* As in serial batches, without -force, lines that follow a failed
+	 * one may have already been sent when the failure is known.
+	 */
+	for (i = 0, off = start; i < hdr->nr_msgs; i++) {
+		const struct compiled_rec *rec =
+			(const struct compiled_rec *)(buf + off);
+		struct nlmsghdr *n = rec_msg(buf, len, off);
+
+		off += sizeof(*rec) + NLMSG_ALIGN(n->nlmsg_len);
+		if (rtnl_batch_add(&rth, n, rec->lineno) ||
+			(nlb.errors && !force)) {
+			ret = 1;
+			break;
+		}
+	}
+
+	if (rtnl_batch_end(&rth) || nlb.errors)
+		ret = 1;
+	else if (show_details)
+		printf("%u requests replayed\n", hdr->nr_msgs);
+	rtnl_close(&rth);
+	free(source);
+	free(buf);
+	return ret;
+
+malformed:
+	fprintf(stderr, "Compiled batch file '%s' is malformed\n", name);
+fail:
+	free(source);
+	free(buf);
+	return -1;
+}
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+
+/* Dumps on several threads
+ *
+ * With -jobs, the thread that requests a dump only receives it: it copies
+ * the messages into chunks, and queues them for a pool of workers. Each
+ * worker runs the filter of the dump on the messages of a chunk, exactly
+ * as rtnl_dump_filter() would, but keeps the output in memory. Chunks
+ * are written in the order they arrived by the worker that completes
+ * the oldest one, so the output is the same as the one of a serial dump.
+ */
+
+#define CHUNK_MSGS	1024
+/* Chunks received, but not written yet. */
+#define MAX_CHUNKS	(4 * MAX_JOBS)
+
+struct chunk {
+	struct chunk	*next;		/* Next chunk to format.	*/
+	char		*msgs;		/* Messages, back to back.	*/
+	int		count;
+	char		*out;		/* Output of the filter.	*/
+	size_t		out_len;
+	int		err;
+	int		done;
+};
+
+static struct {
+	rtnl_filter_t		filter;
+	FILE			*fp;
+	struct sockaddr_nl	who;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		work;		/* A chunk is queued.	*/
+	pthread_cond_t		room;		/* A chunk is written.	*/
+	struct chunk		*head, *tail;	/* Chunks to format.	*/
+	/* Chunks not written yet, indexed by their seq. */
+	struct chunk		*ring[MAX_CHUNKS];
+	unsigned int		recv_seq;	/* Seq of the next chunk.	*/
+	unsigned int		write_seq;	/* Oldest chunk in @ring.	*/
+	int			closing;
+	int			err;		/* First error of a filter.	*/
+} pipeline = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.room = PTHREAD_COND_INITIALIZER,
+};
+
+static void format_chunk(struct chunk *c)
+{
+	char *p = c->msgs;
+	int i;
+
+	out_capture_begin();
+	for (i = 0; i < c->count; i++) {
+		struct nlmsghdr *h = (struct nlmsghdr *)p;
+
+		c->err = pipeline.filter(&pipeline.who, h, pipeline.fp);
+		if (c->err < 0)
+			break;
+		p += NLMSG_ALIGN(h->nlmsg_len);
+	}
+	c->out = out_capture_end(&c->out_len);
+}
+
+/* Write the chunks that are done in order; the lock must be held. */
+static void write_chunks(void)
+{
+	struct chunk *c;
+
+	while ((c = pipeline.ring[pipeline.write_seq % MAX_CHUNKS]) &&
+		c->done) {
+		/* Nothing after the first error shows up, as in
+		 * rtnl_dump_filter().
+		 */
+		if (!pipeline.err) {
+			if (c->out_len)
+				fwrite(c->out, 1, c->out_len,
+					pipeline.fp);
+			pipeline.err = c->err;
+		}
+		pipeline.ring[pipeline.write_seq % MAX_CHUNKS] = NULL;
+		pipeline.write_seq++;
+		free(c->out);
+		free(c->msgs);
+		free(c);
+	}
+	pthread_cond_broadcast(&pipeline.room);
+}
+
+static void *worker(void *arg)
+{
+	UNUSED(arg);
+
+	pthread_mutex_lock(&pipeline.lock);
+	while (1) {
+		struct chunk *c;
+
+		while (!pipeline.head && !pipeline.closing)
+			pthread_cond_wait(&pipeline.work, &pipeline.lock);
+		c = pipeline.head;
+		if (!c)
+			break;
+		pipeline.head = c->next;
+		if (!pipeline.head)
+			pipeline.tail = NULL;
+
+		/* Chunks after an error are dropped unformatted. */
+		if (!pipeline.err) {
+			pthread_mutex_unlock(&pipeline.lock);
+			format_chunk(c);
+			pthread_mutex_lock(&pipeline.lock);
+		}
+		c->done = 1;
+		write_chunks();
+	}
+	pthread_mutex_unlock(&pipeline.lock);
+	return NULL;
+}
+
+/* Queue @count messages of @msgs as a chunk. */
+static int queue_chunk(struct nlmsghdr **msgs, int count)
+{
+	struct chunk *c;
+	int i, len = 0;
+	char *p;
+
+	for (i = 0; i < count; i++)
+		len += NLMSG_ALIGN(msgs[i]->nlmsg_len);
+
+	c = calloc(1, sizeof(*c));
+	if (!c || !(c->msgs = malloc(len))) {
+		free(c);
+		fprintf(stderr, "Cannot allocate dump chunk\n");
+		return -1;
+	}
+	for (i = 0, p = c->msgs; i < count; i++) {
+		memcpy(p, msgs[i], msgs[i]->nlmsg_len);
+		p += NLMSG_ALIGN(msgs[i]->nlmsg_len);
+	}
+	c->count = count;
+
+	pthread_mutex_lock(&pipeline.lock);
+	while (pipeline.recv_seq - pipeline.write_seq >= MAX_CHUNKS &&
+		!pipeline.err)
+		pthread_cond_wait(&pipeline.room, &pipeline.lock);
+	if (pipeline.err) {
+		pthread_mutex_unlock(&pipeline.lock);
+		free(c->msgs);
+		free(c);
+		return pipeline.err;
+	}
+	pipeline.ring[pipeline.recv_seq++ % MAX_CHUNKS] = c;
+	if (pipeline.tail)
+		pipeline.tail->next = c;
+	else
+		pipeline.head = c;
+	pipeline.tail = c;
+	pthread_cond_signal(&pipeline.work);
+	pthread_mutex_unlock(&pipeline.lock);
+	return 0;
+}
+
+static int receive(const struct sockaddr_nl *who, struct nlmsghdr **msgs,
+	int count, void *arg)
+{
+	UNUSED(who);
+	UNUSED(arg);
+
+	while (count > 0) {
+		int n = count < CHUNK_MSGS ? count : CHUNK_MSGS;
+		int err = queue_chunk(msgs, n);
+
+		if (err < 0)
+			return err;
+		msgs += n;
+		count -= n;
+	}
+	return 0;
+}
+
+int xip_dump_filter(rtnl_filter_t filter, FILE *fp)
+{
+	pthread_t threads[MAX_JOBS];
+	int i, n, rc;
+
+	if (jobs <= 1)
+		return rtnl_dump_filter(&rth, filter, fp, NULL, NULL);
+
+	/* Records already buffered come first. */
+	out_flush();
+
+	pipeline.filter = filter;
+	pipeline.fp = fp;
+	/* Only messages of the kernel reach the filter. */
+	memset(&pipeline.who, 0, sizeof(pipeline.who));
+	pipeline.who.nl_family = AF_NETLINK;
+	pipeline.closing = 0;
+	pipeline.err = 0;
+	pipeline.recv_seq = pipeline.write_seq = 0;
+
+	n = jobs < MAX_JOBS ? jobs : MAX_JOBS;
+	for (i = 0; i < n; i++) {
+		if (pthread_create(&threads[i], NULL, worker, NULL)) {
+			fprintf(stderr, "Cannot create dump thread\n");
+			exit(1);
+		}
+	}
+
+	rc = rtnl_dump_filter_v(&rth, receive, NULL);
+
+	pthread_mutex_lock(&pipeline.lock);
+	pipeline.closing = 1;
+	pthread_cond_broadcast(&pipeline.work);
+	pthread_mutex_unlock(&pipeline.lock);
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	fflush(fp);
+
+	return rc < 0 ? rc : pipeline.err;
+}
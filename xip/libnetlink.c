@@ -15,6 +15,7 @@
  * length of large functions, adds comments that explain the code, and
  * gives a more linear flow would be greatly appreciated.
  */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -77,16 +78,460 @@ int rtnl_open_byproto(struct rtnl_handle *rth, unsigned subscriptions,
 	return 0;
 }
 
+/*
+ * Receiving
+ *
+ * Dumps and notifications are received into a queue of page-aligned
+ * slots that each hold a datagram. The size of the next datagram is
+ * peeked before every refill, so slots grow to fit instead of truncating
+ * it, and a single recvmmsg(2) fills as many slots as there are
+ * datagrams waiting. While dumping, the kernel prepares the next part of
+ * the dump as each datagram is read, so one call receives many parts.
+ */
+
+/* The kernel builds parts of dumps of up to 32KB. */
+#define RCV_MIN_SLOT	(32 * 1024)
+#define RCV_SLOTS	16
+
+struct rtnl_rcv
+{
+	char			*buf;		/* RCV_SLOTS slots.		*/
+	size_t			slot;		/* Size of each slot.		*/
+	int			next;		/* Next datagram to hand out.	*/
+	int			count;		/* Datagrams in the queue.	*/
+	struct mmsghdr		vec[RCV_SLOTS];
+	struct iovec		iov[RCV_SLOTS];
+	struct sockaddr_nl	addr[RCV_SLOTS];
+
+	/* Messages passed to a vector filter, see rtnl_dump_filter_v(). */
+	struct nlmsghdr		**msgs;
+	int			msgs_size;
+};
+
+/* Make room for datagrams of @len bytes. */
+static int rcv_grow(struct rtnl_rcv *rcv, size_t len)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t slot = rcv->slot ? rcv->slot : RCV_MIN_SLOT;
+	void *buf;
+
+	while (slot < len)
+		slot *= 2;
+	slot = (slot + page - 1) & ~(page - 1);
+	if (slot == rcv->slot)
+		return 0;
+
+	if (posix_memalign(&buf, page, slot * RCV_SLOTS)) {
+		fprintf(stderr, "Cannot allocate %zu bytes to receive "
+			"netlink messages\n", slot * RCV_SLOTS);
+		return -1;
+	}
+	free(rcv->buf);
+	rcv->buf = buf;
+	rcv->slot = slot;
+	return 0;
+}
+
+/* Wait for datagrams, and queue all that have arrived. */
+static int rcv_fill(struct rtnl_handle *rth, int flags)
+{
+	struct rtnl_rcv *rcv = rth->rcv;
+	struct msghdr peek = { 0 };
+	int i, len, n;
+
+	if (!rcv) {
+		rcv = rth->rcv = calloc(1, sizeof(*rcv));
+		if (!rcv) {
+			fprintf(stderr, "Cannot allocate netlink queue\n");
+			return -1;
+		}
+	}
+
+	len = recvmsg(rth->fd, &peek, flags | MSG_PEEK | MSG_TRUNC);
+	if (len < 0)
+		return -1;
+	if (rcv_grow(rcv, len) < 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (i = 0; i < RCV_SLOTS; i++) {
+		rcv->iov[i].iov_base = rcv->buf + i * rcv->slot;
+		rcv->iov[i].iov_len = rcv->slot;
+		rcv->vec[i].msg_hdr = (struct msghdr) {
+			.msg_name = &rcv->addr[i],
+			.msg_namelen = sizeof(rcv->addr[i]),
+			.msg_iov = &rcv->iov[i],
+			.msg_iovlen = 1,
+		};
+	}
+	n = recvmmsg(rth->fd, rcv->vec, RCV_SLOTS, MSG_WAITFORONE, NULL);
+	if (n < 0)
+		return -1;
+	rcv->next = 0;
+	rcv->count = n;
+	return n;
+}
+
+/* rtnl_recv - obtain the next datagram in *@buf, and its sender in *@who.
+ *
+ * RETURN
+ *	The length of the datagram, zero on EOF, or a negative number with
+ *	errno set. *@trunc is true if the datagram did not fit.
+ *
+ * NOTES
+ *	The datagram stays valid until the next call.
+ */
+static int rtnl_recv(struct rtnl_handle *rth, char **buf,
+		     struct sockaddr_nl **who, int *trunc)
+{
+	struct rtnl_rcv *rcv = rth->rcv;
+	struct mmsghdr *m;
+	int i;
+
+	if (!rcv || rcv->next >= rcv->count) {
+		int n = rcv_fill(rth, 0);
+		if (n <= 0)
+			return n;
+		rcv = rth->rcv;
+	}
+
+	i = rcv->next++;
+	m = &rcv->vec[i];
+	*buf = rcv->iov[i].iov_base;
+	*who = &rcv->addr[i];
+	*trunc = !!(m->msg_hdr.msg_flags & MSG_TRUNC);
+	if (m->msg_hdr.msg_namelen != sizeof(rcv->addr[i])) {
+		fprintf(stderr, "Sender address length == %d\n",
+			m->msg_hdr.msg_namelen);
+		exit(1);
+	}
+	return m->msg_len;
+}
+
+int rtnl_set_rcvbuf(struct rtnl_handle *rth, int size)
+{
+	if (setsockopt(rth->fd, SOL_SOCKET, SO_RCVBUFFORCE, &size,
+		       sizeof(size)) < 0 &&
+	    setsockopt(rth->fd, SOL_SOCKET, SO_RCVBUF, &size,
+		       sizeof(size)) < 0) {
+		perror("SO_RCVBUF");
+		return -1;
+	}
+	return 0;
+}
+
 void rtnl_close(struct rtnl_handle *rth)
 {
 	if (rth->fd >= 0) {
 		close(rth->fd);
 		rth->fd = -1;
 	}
+	if (rth->rcv) {
+		free(rth->rcv->buf);
+		free(rth->rcv->msgs);
+		free(rth->rcv);
+		rth->rcv = NULL;
+	}
+}
+
+/*
+ * Batching
+ *
+ * Only the last request of each sendmsg(2) asks for an ACK; the other
+ * ones are only answered when they fail. Since the kernel processes
+ * the requests of a socket in order, the reply to a request
+ * acknowledges all requests before it.
+ */
+
+#ifndef NETLINK_CAP_ACK
+#define NETLINK_CAP_ACK	10
+#endif
+
+/* Upper bound of the memory that an error queued in the receive buffer
+ * consumes; it sizes the receive buffer after the window.
+ */
+#define BATCH_REPLY_TRUESIZE	1024
+
+/* Set socket buffer @opt to at least @want, bypassing the system limit
+ * when privileged (@force_opt, or -1 to respect it), and return
+ * the resulting size.
+ */
+static int grow_sockbuf(int fd, int opt, int force_opt, int want)
+{
+	int cur;
+	socklen_t optlen = sizeof(cur);
+
+	if (getsockopt(fd, SOL_SOCKET, opt, &cur, &optlen) < 0)
+		return -1;
+	/* The kernel reports twice the requested value. */
+	if (cur / 2 >= want)
+		return cur;
+	if ((force_opt < 0 ||
+	     setsockopt(fd, SOL_SOCKET, force_opt, &want, sizeof(want)) < 0) &&
+	    setsockopt(fd, SOL_SOCKET, opt, &want, sizeof(want)) < 0)
+		return -1;
+	if (getsockopt(fd, SOL_SOCKET, opt, &cur, &optlen) < 0)
+		return -1;
+	return cur;
+}
+
+int rtnl_batch_begin(struct rtnl_handle *rth, struct rtnl_batch *b,
+		     int max_bytes, int max_count, int window,
+		     rtnl_batch_err_t err_cb, void *arg)
+{
+	int sndbuf, rcvbuf, one = 1;
+
+	if (rth->batch) {
+		fprintf(stderr, "A batch is already active\n");
+		return -1;
+	}
+
+	/* The kernel refuses messages larger than its send buffer minus
+	 * some slack.
+	 */
+	sndbuf = grow_sockbuf(rth->fd, SO_SNDBUF, SO_SNDBUFFORCE, max_bytes);
+	if (sndbuf < 0) {
+		perror("SO_SNDBUF");
+		return -1;
+	}
+	if (sndbuf - 32 < max_bytes)
+		max_bytes = sndbuf - 32;
+
+	/* If every request of the window fails, all errors must fit in
+	 * the receive buffer, otherwise the kernel drops them. Large
+	 * windows are up to the caller; see rtnl_set_rcvbuf().
+	 */
+	rcvbuf = grow_sockbuf(rth->fd, SO_RCVBUF, -1,
+			      window * BATCH_REPLY_TRUESIZE);
+	if (rcvbuf < 0) {
+		perror("SO_RCVBUF");
+		return -1;
+	}
+	if (rcvbuf / BATCH_REPLY_TRUESIZE < window)
+		window = rcvbuf / BATCH_REPLY_TRUESIZE;
+	if (max_count > window)
+		max_count = window;
+
+	/* Errors do not need to echo the failed requests. Old kernels
+	 * lack this option, and just send larger errors.
+	 */
+	setsockopt(rth->fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+
+	memset(b, 0, sizeof(*b));
+	b->size = max_bytes;
+	b->max_count = max_count;
+	b->window = window;
+	b->base_seq = b->unacked = b->sent_seq = b->end_seq = rth->seq + 1;
+	b->err_cb = err_cb;
+	b->arg = arg;
+	b->buf = malloc(max_bytes);
+	b->tags = malloc(window * sizeof(*b->tags));
+	if (!b->buf || !b->tags) {
+		fprintf(stderr, "Cannot allocate netlink batch\n");
+		free(b->buf);
+		free(b->tags);
+		return -1;
+	}
+
+	rth->batch = b;
+	return 0;
+}
+
+/* Read replies until all requests before @until are acknowledged, and
+ * then whatever else is already queued without blocking.
+ */
+static int batch_recv(struct rtnl_handle *rth, struct rtnl_batch *b,
+		      __u32 until)
+{
+	struct sockaddr_nl nladdr;
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name = &nladdr,
+		.msg_namelen = sizeof(nladdr),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char buf[16384];
+
+	iov.iov_base = buf;
+	while (1) {
+		/* Unsigned arithmetic copes with wrapped seqs. */
+		int flags = (__s32)(until - b->unacked) > 0 ? 0 : MSG_DONTWAIT;
+		struct nlmsghdr *h;
+		int status;
+
+		iov.iov_len = sizeof(buf);
+		status = recvmsg(rth->fd, &msg, flags);
+		if (status < 0) {
+			if (errno == EAGAIN && flags)
+				return 0;
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			fprintf(stderr, "netlink receive error %s (%d), "
+				"%u requests of batch lost\n",
+				strerror(errno), errno,
+				b->sent_seq - b->unacked);
+			b->unacked = b->sent_seq;
+			return -1;
+		}
+		if (status == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -1;
+		}
+
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, status);
+		     h = NLMSG_NEXT(h, status)) {
+			struct nlmsgerr *err = NLMSG_DATA(h);
+			int tag;
+
+			if (nladdr.nl_pid != 0 ||
+			    h->nlmsg_pid != rth->local.nl_pid ||
+			    h->nlmsg_seq - b->unacked >=
+			    b->sent_seq - b->unacked)
+				continue;
+
+			if (h->nlmsg_type != NLMSG_ERROR) {
+				fprintf(stderr, "Unexpected reply!!!\n");
+				continue;
+			}
+			tag = b->tags[(h->nlmsg_seq - b->base_seq) % b->window];
+			b->unacked = h->nlmsg_seq + 1;
+			if (h->nlmsg_len < NLMSG_LENGTH(sizeof(*err))) {
+				fprintf(stderr, "ERROR truncated\n");
+				b->errors++;
+				b->err_cb(tag, -EBADMSG, b->arg);
+			} else if (err->error) {
+				b->errors++;
+				b->err_cb(tag, err->error, b->arg);
+			}
+		}
+
+		if (msg.msg_flags & MSG_TRUNC) {
+			fprintf(stderr, "Message truncated\n");
+			continue;
+		}
+		if (status) {
+			fprintf(stderr, "!!!Remnant of size %d\n", status);
+			return -1;
+		}
+	}
+}
+
+/* Send the queued requests without waiting for them. */
+static int batch_send(struct rtnl_handle *rth, struct rtnl_batch *b)
+{
+	struct sockaddr_nl nladdr;
+	struct iovec iov = {
+		.iov_base = b->buf,
+		.iov_len = b->len,
+	};
+	struct msghdr msg = {
+		.msg_name = &nladdr,
+		.msg_namelen = sizeof(nladdr),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	int rc;
+
+	if (!b->count)
+		return 0;
+
+	memset(&nladdr, 0, sizeof(nladdr));
+	nladdr.nl_family = AF_NETLINK;
+
+	((struct nlmsghdr *)(b->buf + b->last))->nlmsg_flags |= NLM_F_ACK;
+	rc = sendmsg(rth->fd, &msg, 0);
+	/* The queue is emptied even on failure, so that a later call
+	 * does not send the same requests twice.
+	 */
+	b->len = b->count = 0;
+	if (rc < 0) {
+		perror("Cannot talk to rtnetlink");
+		b->unacked = b->sent_seq = b->end_seq;
+		return -1;
+	}
+	b->sent_seq = b->end_seq;
+
+	/* Report errors early, and keep the receive buffer from filling. */
+	return batch_recv(rth, b, b->unacked);
+}
+
+int rtnl_batch_add(struct rtnl_handle *rth, struct nlmsghdr *n, int tag)
+{
+	struct rtnl_batch *b = rth->batch;
+	int len = NLMSG_ALIGN(n->nlmsg_len);
+
+	if (len > b->size) {
+		fprintf(stderr, "Message too large for netlink batch: %d\n",
+			len);
+		return -1;
+	}
+	if ((b->len + len > b->size || b->count >= b->max_count) &&
+	    batch_send(rth, b) < 0)
+		return -1;
+	/* Wait for the oldest request if the window is full. */
+	if (b->end_seq - b->unacked >= (__u32)b->window &&
+	    (batch_send(rth, b) < 0 ||
+	     batch_recv(rth, b, b->end_seq - b->window + 1) < 0))
+		return -1;
+
+	n->nlmsg_seq = ++rth->seq;
+	n->nlmsg_flags &= ~NLM_F_ACK;
+	/* Requests that bypassed the batch consumed seqs. */
+	if (b->unacked == b->end_seq)
+		b->unacked = b->sent_seq = n->nlmsg_seq;
+	b->end_seq = n->nlmsg_seq + 1;
+
+	b->tags[(n->nlmsg_seq - b->base_seq) % b->window] = tag;
+	b->last = b->len;
+	memcpy(b->buf + b->len, n, n->nlmsg_len);
+	memset(b->buf + b->len + n->nlmsg_len, 0, len - n->nlmsg_len);
+	b->len += len;
+	b->count++;
+	return 0;
+}
+
+int rtnl_batch_flush(struct rtnl_handle *rth)
+{
+	struct rtnl_batch *b = rth->batch;
+	int errors = b->errors;
+
+	if (batch_send(rth, b) < 0 || batch_recv(rth, b, b->sent_seq) < 0)
+		return -1;
+	return b->errors - errors;
+}
+
+int rtnl_batch_end(struct rtnl_handle *rth)
+{
+	struct rtnl_batch *b = rth->batch;
+	int rc;
+
+	if (!b)
+		return 0;
+	rc = rtnl_batch_flush(rth);
+	free(b->buf);
+	free(b->tags);
+	b->buf = NULL;
+	b->tags = NULL;
+	rth->batch = NULL;
+	return rc;
+}
+
+/* Requests that bypass the batch must not overtake it. */
+static int flush_batch(struct rtnl_handle *rth)
+{
+	struct rtnl_batch *b = rth->batch;
+
+	if (b && b->unacked != b->end_seq && rtnl_batch_flush(rth) < 0)
+		return -1;
+	return 0;
 }
 
 int rtnl_send(struct rtnl_handle *rth, const char *buf, int len)
 {
+	if (flush_batch(rth) < 0)
+		return -1;
 	return send(rth->fd, buf, len, 0);
 }
 
@@ -96,6 +541,8 @@ int rtnl_send_check(struct rtnl_handle *rth, const char *buf, int len)
 	int status;
 	char resp[1024];
 
+	if (flush_batch(rth) < 0)
+		return -1;
 	status = send(rth->fd, buf, len, 0);
 	if (status < 0)
 		return status;
@@ -138,6 +585,8 @@ int rtnl_wilddump_request(struct rtnl_handle *rth, int family, int type)
 	req.nlh.nlmsg_seq = rth->dump = ++rth->seq;
 	req.g.rtgen_family = family;
 
+	if (flush_batch(rth) < 0)
+		return -1;
 	return send(rth->fd, (void*)&req, sizeof(req), 0);
 }
 
@@ -165,31 +614,46 @@ int rtnl_dump_request(struct rtnl_handle *rth, int type, void *req, int len)
 	nlh.nlmsg_pid = 0;
 	nlh.nlmsg_seq = rth->dump = ++rth->seq;
 
+	if (flush_batch(rth) < 0)
+		return -1;
 	return sendmsg(rth->fd, &msg, 0);
 }
 
+int rtnl_dump_request_n(struct rtnl_handle *rth, struct nlmsghdr *n)
+{
+	n->nlmsg_flags = NLM_F_DUMP|NLM_F_REQUEST;
+	n->nlmsg_pid = 0;
+	n->nlmsg_seq = rth->dump = ++rth->seq;
+
+	if (flush_batch(rth) < 0)
+		return -1;
+	return send(rth->fd, n, n->nlmsg_len, 0);
+}
+
+static void print_dump_error(const struct nlmsghdr *h)
+{
+	const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(h);
+
+	if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+		fprintf(stderr, "ERROR truncated\n");
+	} else {
+		errno = -err->error;
+		perror("RTNETLINK answers");
+	}
+}
+
 int rtnl_dump_filter_l(struct rtnl_handle *rth,
 		       const struct rtnl_dump_filter_arg *arg)
 {
-	struct sockaddr_nl nladdr;
-	struct iovec iov;
-	struct msghdr msg = {
-		.msg_name = &nladdr,
-		.msg_namelen = sizeof(nladdr),
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
-	char buf[16384];
-
-	iov.iov_base = buf;
 	while (1) {
-		int status;
+		struct sockaddr_nl *who;
+		char *buf;
+		int status, trunc;
 		const struct rtnl_dump_filter_arg *a;
 		int found_done = 0;
 		int msglen = 0;
 
-		iov.iov_len = sizeof(buf);
-		status = recvmsg(rth->fd, &msg, 0);
+		status = rtnl_recv(rth, &buf, &who, &trunc);
 		if (status < 0) {
 			if (errno == EINTR || errno == EAGAIN)
 				continue;
@@ -210,12 +674,11 @@ int rtnl_dump_filter_l(struct rtnl_handle *rth,
 			while (NLMSG_OK(h, msglen)) {
 				int err;
 
-				if (nladdr.nl_pid != 0 ||
+				if (who->nl_pid != 0 ||
 				    h->nlmsg_pid != rth->local.nl_pid ||
 				    h->nlmsg_seq != rth->dump) {
 					if (a->junk) {
-						err = a->junk(&nladdr, h,
-							      a->arg2);
+						err = a->junk(who, h, a->arg2);
 						if (err < 0)
 							return err;
 					}
@@ -227,17 +690,10 @@ int rtnl_dump_filter_l(struct rtnl_handle *rth,
 					break; /* process next filter */
 				}
 				if (h->nlmsg_type == NLMSG_ERROR) {
-					struct nlmsgerr *err = (struct nlmsgerr*)NLMSG_DATA(h);
-					if (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
-						fprintf(stderr,
-							"ERROR truncated\n");
-					} else {
-						errno = -err->error;
-						perror("RTNETLINK answers");
-					}
+					print_dump_error(h);
 					return -1;
 				}
-				err = a->filter(&nladdr, h, a->arg1);
+				err = a->filter(who, h, a->arg1);
 				if (err < 0)
 					return err;
 
@@ -249,7 +705,7 @@ skip_it:
 		if (found_done)
 			return 0;
 
-		if (msg.msg_flags & MSG_TRUNC) {
+		if (trunc) {
 			fprintf(stderr, "Message truncated\n");
 			continue;
 		}
@@ -260,6 +716,87 @@ skip_it:
 	}
 }
 
+int rtnl_dump_filter_v(struct rtnl_handle *rth, rtnl_filter_v_t filter,
+		       void *arg)
+{
+	while (1) {
+		struct rtnl_rcv *rcv;
+		struct sockaddr_nl *who = NULL;
+		int count = 0;
+		int found_done = 0;
+
+		/* Collect every datagram in the queue. */
+		do {
+			char *buf;
+			struct nlmsghdr *h;
+			int status, trunc;
+
+			status = rtnl_recv(rth, &buf, &who, &trunc);
+			if (status < 0) {
+				if (errno == EINTR || errno == EAGAIN)
+					continue;
+				fprintf(stderr, "netlink receive error "
+					"%s (%d)\n", strerror(errno), errno);
+				return -1;
+			}
+			if (status == 0) {
+				fprintf(stderr, "EOF on netlink\n");
+				return -1;
+			}
+			if (trunc) {
+				fprintf(stderr, "Message truncated\n");
+				continue;
+			}
+
+			rcv = rth->rcv;
+			for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, status);
+			     h = NLMSG_NEXT(h, status)) {
+				if (who->nl_pid != 0 ||
+				    h->nlmsg_pid != rth->local.nl_pid ||
+				    h->nlmsg_seq != rth->dump)
+					continue;
+				if (h->nlmsg_type == NLMSG_DONE) {
+					found_done = 1;
+					break;
+				}
+				if (h->nlmsg_type == NLMSG_ERROR) {
+					print_dump_error(h);
+					return -1;
+				}
+
+				if (count >= rcv->msgs_size) {
+					int size = rcv->msgs_size ?
+						rcv->msgs_size * 2 : 1024;
+					struct nlmsghdr **msgs = realloc(
+						rcv->msgs, size * sizeof(*msgs));
+					if (!msgs) {
+						fprintf(stderr, "Cannot "
+							"allocate netlink "
+							"vector\n");
+						return -1;
+					}
+					rcv->msgs = msgs;
+					rcv->msgs_size = size;
+				}
+				rcv->msgs[count++] = h;
+			}
+			if (status && !found_done) {
+				fprintf(stderr, "!!!Remnant of size %d\n",
+					status);
+				return -1;
+			}
+		} while (!found_done && rth->rcv->next < rth->rcv->count);
+
+		if (count) {
+			int err = filter(who, rth->rcv->msgs, count, arg);
+			if (err < 0)
+				return err;
+		}
+		if (found_done)
+			return 0;
+	}
+}
+
 int rtnl_dump_filter(struct rtnl_handle *rth,
 		     rtnl_filter_t filter,
 		     void *arg1,
@@ -300,6 +837,8 @@ int rtnl_talk(struct rtnl_handle *rtnl, struct nlmsghdr *n, __u32 peer,
 	nladdr.nl_pid = peer;
 	nladdr.nl_groups = groups;
 
+	if (flush_batch(rtnl) < 0)
+		return -1;
 	n->nlmsg_seq = seq = ++rtnl->seq;
 
 	if (answer == NULL)
@@ -405,25 +944,12 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 {
 	int status;
 	struct nlmsghdr *h;
-	struct sockaddr_nl nladdr;
-	struct iovec iov;
-	struct msghdr msg = {
-		.msg_name = &nladdr,
-		.msg_namelen = sizeof(nladdr),
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
-	char   buf[8192];
+	struct sockaddr_nl *who;
+	char *buf;
+	int trunc;
 
-	memset(&nladdr, 0, sizeof(nladdr));
-	nladdr.nl_family = AF_NETLINK;
-	nladdr.nl_pid = 0;
-	nladdr.nl_groups = 0;
-
-	iov.iov_base = buf;
 	while (1) {
-		iov.iov_len = sizeof(buf);
-		status = recvmsg(rtnl->fd, &msg, 0);
+		status = rtnl_recv(rtnl, &buf, &who, &trunc);
 
 		if (status < 0) {
 			if (errno == EINTR || errno == EAGAIN)
@@ -438,17 +964,13 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 			fprintf(stderr, "EOF on netlink\n");
 			return -1;
 		}
-		if (msg.msg_namelen != sizeof(nladdr)) {
-			fprintf(stderr, "Sender address length == %d\n", msg.msg_namelen);
-			exit(1);
-		}
 		for (h = (struct nlmsghdr*)buf; status >= sizeof(*h); ) {
 			int err;
 			int len = h->nlmsg_len;
 			int l = len - sizeof(*h);
 
 			if (l<0 || len>status) {
-				if (msg.msg_flags & MSG_TRUNC) {
+				if (trunc) {
 					fprintf(stderr, "Truncated message\n");
 					return -1;
 				}
@@ -456,14 +978,14 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 				exit(1);
 			}
 
-			err = handler(&nladdr, h, jarg);
+			err = handler(who, h, jarg);
 			if (err < 0)
 				return err;
 
 			status -= NLMSG_ALIGN(len);
 			h = (struct nlmsghdr*)((char*)h + NLMSG_ALIGN(len));
 		}
-		if (msg.msg_flags & MSG_TRUNC) {
+		if (trunc) {
 			fprintf(stderr, "Message truncated\n");
 			continue;
 		}
@@ -479,8 +1001,15 @@ int rtnl_from_file(FILE *rtnl, rtnl_filter_t handler,
 {
 	int status;
 	struct sockaddr_nl nladdr;
-	char   buf[8192];
-	struct nlmsghdr *h = (void*)buf;
+	/* The buffer grows to fit the largest message. */
+	size_t size = RCV_MIN_SLOT;
+	struct nlmsghdr *h = malloc(size);
+	int rc = -1;
+
+	if (!h) {
+		perror("rtnl_from_file: malloc");
+		return -1;
+	}
 
 	memset(&nladdr, 0, sizeof(nladdr));
 	nladdr.nl_family = AF_NETLINK;
@@ -491,41 +1020,61 @@ int rtnl_from_file(FILE *rtnl, rtnl_filter_t handler,
 		int err, len;
 		int l;
 
-		status = fread(&buf, 1, sizeof(*h), rtnl);
+		status = fread(h, 1, sizeof(*h), rtnl);
 
 		if (status < 0) {
 			if (errno == EINTR)
 				continue;
 			perror("rtnl_from_file: fread");
-			return -1;
+			goto out;
+		}
+		if (status == 0) {
+			rc = 0;
+			goto out;
 		}
-		if (status == 0)
-			return 0;
 
 		len = h->nlmsg_len;
 		l = len - sizeof(*h);
 
-		if (l<0 || len>sizeof(buf)) {
+		if (l<0) {
 			fprintf(stderr, "!!!malformed message: len=%d @%lu\n",
 				len, ftell(rtnl));
-			return -1;
+			goto out;
+		}
+		if (NLMSG_ALIGN(len) > size) {
+			struct nlmsghdr *bigger;
+
+			while (size < NLMSG_ALIGN(len))
+				size *= 2;
+			bigger = realloc(h, size);
+			if (!bigger) {
+				perror("rtnl_from_file: realloc");
+				goto out;
+			}
+			h = bigger;
 		}
 
 		status = fread(NLMSG_DATA(h), 1, NLMSG_ALIGN(l), rtnl);
 
 		if (status < 0) {
 			perror("rtnl_from_file: fread");
-			return -1;
+			goto out;
 		}
 		if (status < l) {
 			fprintf(stderr, "rtnl-from_file: truncated message\n");
-			return -1;
+			goto out;
 		}
 
 		err = handler(&nladdr, h, jarg);
-		if (err < 0)
-			return err;
+		if (err < 0) {
+			rc = err;
+			goto out;
+		}
 	}
+
+out:
+	free(h);
+	return rc;
 }
 
 int addattr32(struct nlmsghdr *n, int maxlen, int type, __u32 data)
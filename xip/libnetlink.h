@@ -13,12 +13,19 @@
 #include <linux/if_addr.h>
 #include <linux/neighbour.h>
 
+struct rtnl_batch;
+struct rtnl_rcv;
+
 struct rtnl_handle
 {
 	int			fd;
 	struct sockaddr_nl	local;
 	__u32			seq;
 	__u32			dump;
+	/* Requests waiting to be sent, see rtnl_batch_begin(). */
+	struct rtnl_batch	*batch;
+	/* Datagrams received but not yet processed. */
+	struct rtnl_rcv		*rcv;
 };
 
 /*
@@ -41,6 +48,11 @@ static inline int rtnl_open(struct rtnl_handle *rth, unsigned subscriptions)
 
 extern void rtnl_close(struct rtnl_handle *rth);
 
+/* Set the receive buffer of @rth to @size bytes, beyond the system limit
+ * when privileged.
+ */
+extern int rtnl_set_rcvbuf(struct rtnl_handle *rth, int size);
+
 /*
  * Sending
  */
@@ -50,6 +62,94 @@ extern int rtnl_send(struct rtnl_handle *rth, const char *buf, int);
 /* Same as rtnl_send, but checks for immediate errors before returning. */
 extern int rtnl_send_check(struct rtnl_handle *rth, const char *buf, int);
 
+/*
+ * Batching
+ *
+ * A batch packs many requests into a single sendmsg(2), and does not wait
+ * for them before queueing more: up to a window of requests may be
+ * in flight. The kernel only answers the requests that fail, and
+ * the last one of each sendmsg(2). Each request carries a tag chosen by
+ * the caller (e.g. the line of a batch file), so that errors can be
+ * traced back to their origin once the kernel answers.
+ *
+ * While a batch is active, any other request sent through the handle
+ * (e.g. a dump or rtnl_talk()) flushes the batch first, so requests are
+ * always processed in the order they are issued.
+ */
+
+/* Called for each request of a batch that the kernel rejected.
+ * @err is a negative errno.
+ */
+typedef void (*rtnl_batch_err_t)(int tag, int err, void *arg);
+
+struct rtnl_batch
+{
+	char			*buf;
+	int			len;		/* Bytes queued in @buf.	*/
+	int			size;		/* Capacity of @buf.		*/
+	int			count;		/* Requests queued in @buf.	*/
+	int			max_count;
+	int			last;		/* Offset of the last request.	*/
+
+	/* Requests in flight are those from @unacked to @sent_seq - 1;
+	 * the queued ones follow up to @end_seq - 1.
+	 */
+	int			window;		/* Capacity of @tags.		*/
+	__u32			base_seq;	/* Seq of @tags[0].		*/
+	__u32			unacked;
+	__u32			sent_seq;
+	__u32			end_seq;
+	int			*tags;		/* Tag of each request.		*/
+
+	int			errors;		/* Rejected requests so far.	*/
+	rtnl_batch_err_t	err_cb;
+	void			*arg;
+};
+
+/* rtnl_batch_begin - attach @b to @rth; requests are sent when
+ *	@max_bytes or @max_count is reached, or when the batch is flushed.
+ *	At most @window requests are ever waiting for the kernel.
+ *
+ * RETURN
+ *	Zero on success; a negative number otherwise.
+ *
+ * NOTES
+ *	The socket buffers of @rth are enlarged to hold @max_bytes and
+ *	the errors of @window requests; if the system limits them,
+ *	the batch is made smaller to fit. The receive buffer only grows
+ *	up to the system limit; callers that want larger windows set it
+ *	with rtnl_set_rcvbuf() first.
+ */
+extern int rtnl_batch_begin(struct rtnl_handle *rth, struct rtnl_batch *b,
+			    int max_bytes, int max_count, int window,
+			    rtnl_batch_err_t err_cb, void *arg);
+
+/* rtnl_batch_add - queue @n with @tag.
+ *
+ * RETURN
+ *	Zero on success; a negative number if the batch failed to reach
+ *	the kernel. Rejected requests are only reported to the callback.
+ */
+extern int rtnl_batch_add(struct rtnl_handle *rth, struct nlmsghdr *n,
+			  int tag);
+
+/* rtnl_batch_flush - send the queued requests, and wait for all requests
+ *	in flight.
+ *
+ * RETURN
+ *	The number of errors reported while flushing; a negative number if
+ *	the batch could not be sent or its replies could not be read.
+ */
+extern int rtnl_batch_flush(struct rtnl_handle *rth);
+
+/* rtnl_batch_end - flush and detach the batch of @rth.
+ *
+ * RETURN
+ *	Same as rtnl_batch_flush(). @b->errors still holds the total
+ *	number of rejected requests.
+ */
+extern int rtnl_batch_end(struct rtnl_handle *rth);
+
 /*
  * Dumping
  */
@@ -58,6 +158,11 @@ extern int rtnl_wilddump_request(struct rtnl_handle *rth, int fam, int type);
 extern int rtnl_dump_request(struct rtnl_handle *rth, int type, void *req,
 			int len);
 
+/* Send @n, a complete dump request whose header only needs its type and
+ * length filled, so that the request can carry attributes.
+ */
+extern int rtnl_dump_request_n(struct rtnl_handle *rth, struct nlmsghdr *n);
+
 typedef int (*rtnl_filter_t)(const struct sockaddr_nl *,
 			     struct nlmsghdr *n, void *);
 
@@ -79,6 +184,19 @@ extern int rtnl_dump_filter(struct rtnl_handle *rth, rtnl_filter_t filter,
 			    rtnl_filter_t junk,
 			    void *arg2);
 
+/* Called with the @count messages of a dump that arrived together,
+ * in order. The messages are only valid during the call.
+ */
+typedef int (*rtnl_filter_v_t)(const struct sockaddr_nl *,
+			       struct nlmsghdr **msgs, int count, void *);
+
+/* rtnl_dump_filter_v - same as rtnl_dump_filter(), but the filter takes
+ *	all messages that a receive call brings at once. Messages that do
+ *	not belong to the dump are skipped.
+ */
+extern int rtnl_dump_filter_v(struct rtnl_handle *rth, rtnl_filter_v_t filter,
+			      void *arg);
+
 /*
  * Attributes
  */
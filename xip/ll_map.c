@@ -112,7 +112,7 @@ const char *ll_idx_n2a(int idx, char *buf)
 
 const char *ll_index_to_name(int idx)
 {
-	static char nbuf[IFNAMSIZ];
+	static __thread char nbuf[IFNAMSIZ];
 
 	return ll_idx_n2a(idx, nbuf);
 }
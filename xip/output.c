@@ -0,0 +1,398 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <linux/rtnetlink.h>
+#include <net/xia_dag.h>
+
+#include "output.h"
+
+enum out_format out_format = OUT_TEXT;
+
+/* Records are flushed once the buffer is this full; the rest of
+ * the buffer guarantees room for any single field.
+ */
+#define OUT_BUF_SIZE	(256 * 1024)
+#define OUT_FLUSH_AT	(OUT_BUF_SIZE - 16 * 1024)
+/* Captured output starts smaller, and grows as needed. */
+#define OUT_CAPTURE_SIZE	(64 * 1024)
+
+/* Each thread has its own writer, see out_capture_begin(). */
+static __thread struct {
+	FILE		*fp;
+	char		*buf;
+	size_t		len;
+	size_t		size;
+	int		capture;
+	const char	*section;
+	int		fields;		/* Fields of the current record.	*/
+	int		in_item;
+	int		items;		/* Items of the current list.		*/
+	int		item_fields;	/* Fields of the current item.		*/
+} out;
+
+static int registered;
+
+void out_flush(void)
+{
+	if (out.capture)
+		return;
+	if (out.len && out.fp) {
+		fwrite(out.buf, 1, out.len, out.fp);
+		fflush(out.fp);
+	}
+	out.len = 0;
+}
+
+/* Return room for @n bytes at the end of the buffer. */
+static char *room(size_t n)
+{
+	if (out.len + n <= out.size)
+		return out.buf + out.len;
+
+	if (out.capture || !out.buf) {
+		size_t size = out.size ? out.size : out.capture ?
+			OUT_CAPTURE_SIZE : OUT_BUF_SIZE;
+		char *buf;
+
+		while (size < out.len + n)
+			size *= 2;
+		buf = realloc(out.buf, size);
+		if (!buf) {
+			fprintf(stderr, "Cannot allocate output buffer\n");
+			exit(1);
+		}
+		out.buf = buf;
+		out.size = size;
+	} else {
+		assert(n <= out.size);
+		out_flush();
+	}
+	return out.buf + out.len;
+}
+
+static void put_mem(const char *s, size_t n)
+{
+	/* Large strings go out in pieces unless they are captured. */
+	while (n) {
+		size_t chunk = out.capture || !out.size ? n : out.size - out.len;
+
+		if (!chunk) {
+			out_flush();
+			chunk = out.size;
+		}
+		if (chunk > n)
+			chunk = n;
+		memcpy(room(chunk), s, chunk);
+		out.len += chunk;
+		s += chunk;
+		n -= chunk;
+	}
+}
+
+static inline void put(const char *s)
+{
+	put_mem(s, strlen(s));
+}
+
+static inline void put_char(char c)
+{
+	*room(1) = c;
+	out.len++;
+}
+
+/* Write @s as the value of a field in the current format. */
+static void put_value(const char *s)
+{
+	const unsigned char *p;
+
+	switch (out_format) {
+	case OUT_TEXT:
+		put(s);
+		break;
+
+	case OUT_JSON:
+		put_char('"');
+		for (p = (const unsigned char *)s; *p; p++) {
+			if (*p == '"' || *p == '\\') {
+				put_char('\\');
+				put_char(*p);
+			} else if (*p < 0x20) {
+				char *q = room(6);
+				out.len += sprintf(q, "\\u%04x", *p);
+			} else {
+				put_char(*p);
+			}
+		}
+		put_char('"');
+		break;
+
+	case OUT_TSV:
+		for (p = (const unsigned char *)s; *p; p++)
+			put_char(*p == '\t' || *p == '\n' || *p == '\r' ?
+				' ' : *p);
+		break;
+	}
+}
+
+/* Start a field; RETURN false if the field does not show up. */
+static int begin_field(const char *label, const char *key, int present)
+{
+	int first;
+
+	switch (out_format) {
+	case OUT_TEXT:
+		if (!label || !present)
+			return 0;
+		put(label);
+		return 1;
+
+	case OUT_JSON:
+		if (!present)
+			return 0;
+		first = out.in_item ? !out.item_fields++ : !out.fields++;
+		if (!first)
+			put_char(',');
+		put_char('"');
+		put(key);
+		put("\":");
+		return 1;
+
+	case OUT_TSV:
+		if (out.in_item) {
+			if (out.item_fields++)
+				put_char(' ');
+		} else if (out.fields++) {
+			put_char('\t');
+		}
+		return present;
+	}
+	return 0;
+}
+
+void out_section(FILE *fp, const char *title)
+{
+	if (out_format == OUT_TEXT) {
+		if (!title)
+			return;
+		out_record_begin(fp, 0);
+		put(title);
+		put(":\n");
+		return;
+	}
+	out.section = title;
+}
+
+void out_record_begin(FILE *fp, int deleted)
+{
+	if (!__atomic_exchange_n(&registered, 1, __ATOMIC_RELAXED))
+		atexit(out_flush);
+	if (fp != out.fp) {
+		out_flush();
+		out.fp = fp;
+	}
+	out.fields = 0;
+	out.in_item = 0;
+
+	if (out_format == OUT_JSON)
+		put_char('{');
+	if (out_format != OUT_TEXT && out.section) {
+		begin_field(NULL, "section", 1);
+		put_value(out.section);
+	}
+	if (deleted) {
+		switch (out_format) {
+		case OUT_TEXT:
+			put("Deleted ");
+			break;
+		case OUT_JSON:
+			begin_field(NULL, "deleted", 1);
+			put("true");
+			break;
+		case OUT_TSV:
+			/* Dumps never carry deleted routes. */
+			break;
+		}
+	}
+}
+
+void out_record_end(void)
+{
+	switch (out_format) {
+	case OUT_TEXT:
+		put("\n\n");
+		break;
+	case OUT_JSON:
+		put("}\n");
+		break;
+	case OUT_TSV:
+		put_char('\n');
+		break;
+	}
+	if (out.len >= OUT_FLUSH_AT)
+		out_flush();
+}
+
+void out_capture_begin(void)
+{
+	out_flush();
+	out.capture = 1;
+}
+
+char *out_capture_end(size_t *len)
+{
+	char *buf = out.buf;
+
+	*len = out.len;
+	out.buf = NULL;
+	out.len = out.size = 0;
+	out.capture = 0;
+	return buf;
+}
+
+void out_text(const char *s)
+{
+	if (out_format == OUT_TEXT)
+		put(s);
+}
+
+void out_str(const char *label, const char *key, const char *s)
+{
+	if (begin_field(label, key, !!s))
+		put_value(s);
+}
+
+void out_uint(const char *label, const char *key, unsigned int v)
+{
+	if (begin_field(label, key, 1)) {
+		char *p = room(16);
+		out.len += sprintf(p, "%u", v);
+	}
+}
+
+void out_hex(const char *label, const char *key, unsigned int v)
+{
+	if (begin_field(label, key, 1)) {
+		char *p = room(16);
+		out.len += sprintf(p, out_format == OUT_TEXT ? "%x" : "%u", v);
+	}
+}
+
+void out_xid(const char *label, const char *key, const struct xia_xid *xid)
+{
+	int quote = out_format == OUT_JSON;
+	char *p;
+	int n;
+
+	if (!begin_field(label, key, !!xid))
+		return;
+
+	/* XIDs need no escaping, so they go straight into the buffer. */
+	p = room(XIA_MAX_STRXID_SIZE + 2);
+	if (quote)
+		*p++ = '"';
+	n = xia_xidtop(xid, p, XIA_MAX_STRXID_SIZE);
+	if (n < 0) {
+		fprintf(stderr, "Cannot format XID\n");
+		exit(1);
+	}
+	p += n;
+	if (quote)
+		*p++ = '"';
+	out.len = p - out.buf;
+}
+
+void out_addr(const char *label, const char *key,
+	const struct xia_addr *addr)
+{
+	char str[XIA_MAX_STRADDR_SIZE];
+	int text = out_format == OUT_TEXT;
+
+	if (!begin_field(label, key, !!addr))
+		return;
+	if (xia_ntop(addr, str, sizeof(str), text) < 0) {
+		fprintf(stderr, "Cannot format XIA address\n");
+		exit(1);
+	}
+	put_value(str);
+	if (text)
+		put_char('\n');
+}
+
+void out_rtm_flags(const char *label, unsigned int flags)
+{
+	static const struct {
+		unsigned int	flag;
+		const char	*name;
+	} names[] = {
+		{ RTNH_F_DEAD,		"dead"		},
+		{ RTNH_F_ONLINK,	"onlink"	},
+		{ RTNH_F_PERVASIVE,	"pervasive"	},
+		{ RTM_F_NOTIFY,		"notify"	},
+	};
+	unsigned int i;
+	int first = 1;
+
+	if (!begin_field(label, "flags", 1))
+		return;
+	if (out_format == OUT_JSON)
+		put_char('[');
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (!(flags & names[i].flag))
+			continue;
+		switch (out_format) {
+		case OUT_TEXT:
+			put(names[i].name);
+			put_char(' ');
+			break;
+		case OUT_JSON:
+			if (!first)
+				put_char(',');
+			put_char('"');
+			put(names[i].name);
+			put_char('"');
+			break;
+		case OUT_TSV:
+			if (!first)
+				put_char(',');
+			put(names[i].name);
+			break;
+		}
+		first = 0;
+	}
+	if (out_format != OUT_TSV)
+		put_char(']');
+}
+
+void out_list_begin(const char *key)
+{
+	if (begin_field(NULL, key, 1) && out_format == OUT_JSON)
+		put_char('[');
+	out.items = 0;
+}
+
+void out_item_begin(void)
+{
+	if (out_format == OUT_JSON) {
+		if (out.items)
+			put_char(',');
+		put_char('{');
+	} else if (out_format == OUT_TSV && out.items) {
+		put_char(',');
+	}
+	out.items++;
+	out.in_item = 1;
+	out.item_fields = 0;
+}
+
+void out_item_end(void)
+{
+	if (out_format == OUT_JSON)
+		put_char('}');
+	out.in_item = 0;
+}
+
+void out_list_end(void)
+{
+	if (out_format == OUT_JSON)
+		put_char(']');
+}
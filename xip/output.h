@@ -0,0 +1,74 @@
+#ifndef HEADER_OUTPUT_H
+#define HEADER_OUTPUT_H
+
+/* Output of dumps.
+ *
+ * Printers describe a record as a sequence of fields. Every field carries
+ * the label that precedes it in plain text, and the key that names it in
+ * machine-readable formats, so a single printer serves all formats:
+ *
+ *	text	the usual layout: labels, values, and out_text() strings;
+ *	json	one object per line, with a member per field;
+ *	tsv	one line per record, with a column per field; absent fields
+ *		are empty columns, items of lists are separated by commas,
+ *		and fields of an item by spaces.
+ *
+ * A NULL label keeps a field out of the text format, and a NULL value
+ * marks an absent field. Records are kept in a large buffer that is
+ * written to its stream in big chunks; a printer may only switch streams
+ * between records. Each thread has its own buffer.
+ */
+
+#include <stdio.h>
+#include <net/xia.h>
+
+enum out_format {
+	OUT_TEXT = 0,
+	OUT_JSON,
+	OUT_TSV,
+};
+
+extern enum out_format out_format;
+
+/* Title the records that follow; titles go in their own line in text,
+ * and in the first field of each record otherwise. A NULL @title ends
+ * the section.
+ */
+void out_section(FILE *fp, const char *title);
+
+void out_record_begin(FILE *fp, int deleted);
+void out_record_end(void);
+
+/* Text that only shows up in the text format. */
+void out_text(const char *s);
+
+void out_str(const char *label, const char *key, const char *s);
+void out_uint(const char *label, const char *key, unsigned int v);
+/* Same as out_uint, but hexadecimal in text. */
+void out_hex(const char *label, const char *key, unsigned int v);
+void out_xid(const char *label, const char *key, const struct xia_xid *xid);
+/* The text format shows one node per line, and ends with a newline. */
+void out_addr(const char *label, const char *key,
+	const struct xia_addr *addr);
+/* Flags of struct rtmsg. */
+void out_rtm_flags(const char *label, unsigned int flags);
+
+/* Lists of items; the fields between out_item_begin() and out_item_end()
+ * belong to an item.
+ */
+void out_list_begin(const char *key);
+void out_item_begin(void);
+void out_item_end(void);
+void out_list_end(void);
+
+/* Write all buffered records to their stream. */
+void out_flush(void);
+
+/* Keep the records of the calling thread in memory instead of writing
+ * them, until out_capture_end() returns them; the caller frees the
+ * returned buffer, which is NULL if nothing was captured.
+ */
+void out_capture_begin(void);
+char *out_capture_end(size_t *len);
+
+#endif /* HEADER_OUTPUT_H */
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+/* cmdfile_next() must split any input as getcmdline() and makeargs() do;
+ * the commands of both are written out as text, and compared.
+ */
+
+#define MAX_ARGS	1000
+
+static void put_cmd(FILE *out, int argc, char **argv)
+{
+	int i;
+
+	fprintf(out, "%d:", cmdlineno);
+	for (i = 0; i < argc; i++)
+		fprintf(out, " [%s]", argv[i]);
+	fputc('\n', out);
+}
+
+static char *scalar_cmds(FILE *in)
+{
+	char *argv[MAX_ARGS];
+	char *line = NULL;
+	size_t len = 0;
+	char *text;
+	size_t text_len;
+	FILE *out = open_memstream(&text, &text_len);
+
+	assert(out);
+	rewind(in);
+	cmdlineno = 0;
+	while (getcmdline(&line, &len, in) != -1)
+		put_cmd(out, makeargs(line, argv, MAX_ARGS), argv);
+	fprintf(out, "end %d\n", cmdlineno);
+	free(line);
+	assert(!fclose(out));
+	return text;
+}
+
+static char *cmdfile_cmds(FILE *in)
+{
+	char *argv[MAX_ARGS];
+	struct cmdfile cf;
+	char *text;
+	size_t text_len;
+	FILE *out = open_memstream(&text, &text_len);
+	int argc;
+
+	assert(out);
+	rewind(in);
+	cmdlineno = 0;
+	assert(!cmdfile_open(&cf, in));
+	while ((argc = cmdfile_next(&cf, argv, MAX_ARGS)) != -1)
+		put_cmd(out, argc, argv);
+	fprintf(out, "end %d\n", cmdlineno);
+	cmdfile_close(&cf);
+	assert(!fclose(out));
+	return text;
+}
+
+static void check_mem(const char *input, size_t len)
+{
+	FILE *in = tmpfile();
+	char *want, *got;
+
+	assert(in);
+	assert(fwrite(input, 1, len, in) == len);
+	assert(!fflush(in));
+
+	want = scalar_cmds(in);
+	got = cmdfile_cmds(in);
+	if (strcmp(want, got)) {
+		fprintf(stderr, "Tokenizers differ\n"
+			"getcmdline():\n%.1000s\ncmdfile_next():\n%.1000s\n",
+			want, got);
+		assert(0);
+	}
+	free(want);
+	free(got);
+	assert(!fclose(in));
+}
+
+static void check(const char *input)
+{
+	check_mem(input, strlen(input));
+}
+
+static void test_lines(void)
+{
+	check("");
+	check("\n\n\n");
+	check("add a b c\n");
+	check("  lead\t\ttabs  \r\nend\r\n");
+	check("a b\nlast line without newline");
+	check("single");
+	check("   ");
+}
+
+static void test_comments(void)
+{
+	check("# whole line\nadd x # rest of line\n   #\n#\nx#y z\n");
+	check("a b # no newline after the comment");
+	/* Comments hide backslashes at the end of their lines. */
+	check("a # c \\\nb\n");
+	check("a \\\n b # c \\\nd\n");
+}
+
+static void test_escapes(void)
+{
+	/* Lines are continued by a backslash right before the newline. */
+	check("a \\\nb c\\\n d\n");
+	check("a\\\nb\n");
+	check("\\\n\\\n\\\nx\n");
+	check("a \\\n\n");
+	/* Other backslashes and quotes are not special. */
+	check("a\\b \\ c\\\\ \\t\n");
+	check("say \"hello world\" 'x y' \"\" ''\n");
+	check("a \\\r\nb\n");
+	check("a \\ \nb\n");
+}
+
+/* Tokens, comments, and continuations at every offset of 16-byte vectors,
+ * both at the start of the input and past a first line.
+ */
+static void test_boundaries(void)
+{
+	static const char *ends[] = { "\n", "#c\n", "\\\nx\n", "\r\n", "" };
+	char input[512];
+	size_t i;
+	int pad, len, first;
+
+	for (first = 0; first < 2; first++)
+	for (i = 0; i < sizeof(ends) / sizeof(ends[0]); i++)
+	for (pad = 0; pad < 48; pad++)
+	for (len = 1; len < 40; len++) {
+		char *p = input;
+
+		if (first)
+			p += sprintf(p, "first line\n");
+		memset(p, ' ', pad);
+		p += pad;
+		memset(p, 'a' + len % 26, len);
+		p += len;
+		p += sprintf(p, " %.*s%s", len % 17, "bbbbbbbbbbbbbbbbb",
+			ends[i]);
+		check_mem(input, p - input);
+	}
+}
+
+/* Random inputs larger than the blocks the input is read in. */
+static void test_large(void)
+{
+	static const char chars[] = "  \t\t\r\n\n\n#\\\\\"'abcdefgh";
+	size_t size = 3 * 1024 * 1024;
+	char *input = malloc(size + 16);
+	unsigned int seed = 1;
+	size_t i;
+
+	assert(input);
+	for (i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		input[i] = chars[(seed >> 16) % (sizeof(chars) - 1)];
+	}
+	/* Never end with a continuation, which has no next line. */
+	memcpy(input + size, "\nend\n", 5);
+	check_mem(input, size + 5);
+
+	/* A single line longer than a block. */
+	memset(input, 'z', size);
+	memcpy(input + size / 2, " mid ", 5);
+	memcpy(input + size, "\nend", 4);
+	check_mem(input, size + 4);
+	free(input);
+}
+
+int main(void)
+{
+	test_lines();
+	test_comments();
+	test_escapes();
+	test_boundaries();
+	test_large();
+	return 0;
+}
@@ -2,6 +2,11 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "utils.h"
 
@@ -11,6 +16,7 @@ int oneline = 0;
 int timestamp = 0;
 char *_SL_ = NULL;
 int force = 0;
+int jobs = 1;
 
 int matches(const char *cmd, const char *pattern)
 {
@@ -43,8 +49,11 @@ int do_cmd(const struct cmd *cmds, const char *entity, const char *help,
 	return -1;
 }
 
-/* XXX Does one really need this global variable? */
-int cmdlineno;
+/* XXX Does one really need this global variable?
+ * It is per thread, so that the workers of xip -jobs can report their
+ * own lines.
+ */
+__thread int cmdlineno;
 
 ssize_t getcmdline(char **linep, size_t *lenp, FILE *in)
 {
@@ -108,6 +117,240 @@ int makeargs(char *line, char *argv[], int maxargs)
 	return argc;
 }
 
+/* Input is read in blocks of this size. Mapping files is slower, since
+ * writing the ends of tokens in place makes the kernel copy every page.
+ */
+#define CMD_BLOCK	(1024 * 1024)
+/* Bytes past the input that scan_special() may read. */
+#define CMD_SLACK	16
+
+int cmdfile_open(struct cmdfile *cf, FILE *in)
+{
+	memset(cf, 0, sizeof(*cf));
+	cf->fd = fileno(in);
+	cf->size = CMD_BLOCK;
+	cf->buf = malloc(cf->size + CMD_SLACK);
+	if (!cf->buf) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+	return 0;
+}
+
+void cmdfile_close(struct cmdfile *cf)
+{
+	free(cf->buf);
+	cf->buf = NULL;
+}
+
+/* Move the rest of the input to the start of the buffer, and read more. */
+static int cmdfile_fill(struct cmdfile *cf)
+{
+	ssize_t n;
+
+	if (cf->pos) {
+		memmove(cf->buf, cf->buf + cf->pos, cf->len - cf->pos);
+		cf->len -= cf->pos;
+		cf->pos = 0;
+	}
+	if (cf->size - cf->len < CMD_BLOCK / 2) {
+		char *buf = realloc(cf->buf, cf->size * 2 + CMD_SLACK);
+		if (!buf) {
+			fprintf(stderr, "Out of memory\n");
+			return -1;
+		}
+		cf->buf = buf;
+		cf->size *= 2;
+	}
+
+	do
+		n = read(cf->fd, cf->buf + cf->len, cf->size - cf->len);
+	while (n < 0 && errno == EINTR);
+	if (n < 0) {
+		perror("Cannot read command lines");
+		return -1;
+	}
+	if (!n)
+		cf->eof = 1;
+	cf->len += n;
+	return 0;
+}
+
+/* Make sure that the next line, and the lines that continue it,
+ * are in the buffer.
+ */
+static int cmdfile_ensure_line(struct cmdfile *cf)
+{
+	size_t scan = 0;	/* From @cf->pos. */
+
+	while (!cf->eof) {
+		char *line = cf->buf + cf->pos + scan;
+		char *nl = memchr(line, '\n', cf->len - cf->pos - scan);
+
+		if (!nl) {
+			if (cmdfile_fill(cf))
+				return -1;
+			continue;
+		}
+		/* Comments end continued lines. Empty continuation lines
+		 * may continue them too, see cmdfile_next().
+		 */
+		if (nl == line ? !scan : nl[-1] != '\\' ||
+			memchr(line, '#', nl - line) ||
+			memchr(line, '\0', nl - line))
+			return 0;
+		scan = nl + 1 - cf->buf - cf->pos;
+	}
+	return 0;
+}
+
+/* RETURN the first byte of [@p, @end) that may end a run of token bytes:
+ *	a control character, a space, '#', or '\\'; or @end.
+ * NOTE
+ *	Up to CMD_SLACK bytes past @end may be read.
+ */
+static char *scan_special(char *p, char *end)
+{
+#ifdef __SSE2__
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i hash = _mm_set1_epi8('#');
+	const __m128i bslash = _mm_set1_epi8('\\');
+
+	for (; p < end; p += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		__m128i m = _mm_or_si128(
+			_mm_cmpeq_epi8(_mm_min_epu8(v, space), v),
+			_mm_or_si128(_mm_cmpeq_epi8(v, hash),
+				_mm_cmpeq_epi8(v, bslash)));
+		unsigned int mask = _mm_movemask_epi8(m);
+
+		if (mask) {
+			p += __builtin_ctz(mask);
+			return p < end ? p : end;
+		}
+	}
+	return end;
+#else
+	for (; p < end; p++)
+		if ((unsigned char)*p <= ' ' || *p == '#' || *p == '\\')
+			return p;
+	return end;
+#endif
+}
+
+/* End the token at @tok, if any, at @w.
+ * RETURN the new number of arguments; @maxargs once there are too many.
+ */
+static int end_token(char *argv[], int argc, int maxargs, char **tok, char *w)
+{
+	if (!*tok)
+		return argc;
+	if (argc >= (maxargs - 1)) {
+		*tok = NULL;
+		return maxargs;
+	}
+	*w = '\0';
+	argv[argc++] = *tok;
+	*tok = NULL;
+	return argc;
+}
+
+int cmdfile_next(struct cmdfile *cf, char *argv[], int maxargs)
+{
+	char *p, *w, *end, *tok = NULL, *cont = NULL;
+	int argc = 0;
+
+	if (cmdfile_ensure_line(cf) || cf->pos >= cf->len)
+		return -1;
+	++cmdlineno;
+
+	/* Token bytes are written at @w; @w only falls behind @p when
+	 * a token goes on in a continuation line.
+	 */
+	p = w = cf->buf + cf->pos;
+	end = cf->buf + cf->len;
+	while (1) {
+		char *s = scan_special(p, end);
+
+		if (s > p) {
+			if (!tok)
+				tok = w;
+			if (w != p)
+				memmove(w, p, s - p);
+			w += s - p;
+		}
+		if (s == end) {
+			cf->pos = cf->len;
+			break;
+		}
+
+		switch (*s) {
+		case ' ':
+		case '\t':
+		case '\r':
+			argc = end_token(argv, argc, maxargs, &tok, w);
+			p = w = s + 1;
+			continue;
+
+		case '#':
+		case '\0':
+			/* Comments go to the end of the line. */
+			s = memchr(s, '\n', end - s);
+			cf->pos = s ? (size_t)(s + 1 - cf->buf) : cf->len;
+			break;
+
+		case '\n':
+			/* When an empty line continues a token that ends in
+			 * a backslash, getcmdline() takes that backslash and
+			 * the newline for another continuation.
+			 */
+			if (s == cont && tok && w[-1] == '\\') {
+				if (--w == tok)
+					tok = NULL;
+				goto next_line;
+			}
+			cf->pos = s + 1 - cf->buf;
+			break;
+
+		case '\\':
+			if (s + 1 < end && s[1] == '\n') {
+				s++;
+				goto next_line;
+			}
+			/* fall through */
+		default:
+			/* Other control characters belong to tokens. */
+			if (!tok)
+				tok = w;
+			*w++ = *s;
+			p = s + 1;
+			continue;
+		}
+		break;
+
+next_line:
+		/* @s is the newline of a continued line. */
+		if (s + 1 == end) {
+			fprintf(stderr, "Missing continuation line\n");
+			cf->pos = cf->len;
+			return -1;
+		}
+		++cmdlineno;
+		p = cont = s + 1;
+		if (!tok)
+			w = p;
+	}
+
+	/* As in getcmdline(), a missing continuation line takes precedence. */
+	argc = end_token(argv, argc, maxargs, &tok, w);
+	if (argc >= maxargs) {
+		fprintf(stderr, "Too many arguments to command\n");
+		exit(1);
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
 int lladdr_ntop(const unsigned char *lladdr, int alen, char *buf, int blen)
 {
 	int i;
@@ -10,6 +10,9 @@ extern int oneline;
 extern int timestamp;
 extern char *_SL_;
 extern int force;
+extern int jobs;
+/* Largest number of jobs, see xip -jobs. */
+#define MAX_JOBS	256
 
 struct cmd {
 	const char *cmd;
@@ -20,13 +23,47 @@ int matches(const char *arg, const char *pattern);
 int do_cmd(const struct cmd *cmds, const char *entity, const char *help,
 	int argc, char **argv);
 
-extern int cmdlineno;
+extern __thread int cmdlineno;
 
 /* Like glibc getline but handle continuation lines and comments. */
 ssize_t getcmdline(char **line, size_t *len, FILE *in);
 /* split command line into argument vector. */
 int makeargs(char *line, char *argv[], int maxargs);
 
+/* Reader of command lines that splits them in place; it is faster than
+ * getcmdline() and makeargs() on large inputs.
+ */
+struct cmdfile {
+	int	fd;
+	char	*buf;
+	size_t	len;		/* Bytes of input in @buf.		*/
+	size_t	size;		/* Room for input in @buf.		*/
+	size_t	pos;		/* Start of the next line.		*/
+	int	eof;		/* All input is in @buf.		*/
+};
+
+/** cmdfile_open - read the command lines of @in with @cf.
+ * RETURN
+ *	Return zero if success; otherwise a negative number.
+ * NOTES
+ *	@in is read in large blocks straight from its file descriptor, so
+ *	nothing must have been read from @in, and @in must stay open until
+ *	cmdfile_close() is called.
+ */
+int cmdfile_open(struct cmdfile *cf, FILE *in);
+
+/** cmdfile_next - split the next command line of @cf into @argv as
+ *		getcmdline() and makeargs() would, and update cmdlineno.
+ * RETURN
+ *	Return the number of arguments, zero for blank lines, and -1 at
+ *	the end of the input or on failure.
+ * NOTES
+ *	The arguments point into @cf, and are only valid until the next call.
+ */
+int cmdfile_next(struct cmdfile *cf, char *argv[], int maxargs);
+
+void cmdfile_close(struct cmdfile *cf);
+
 #define UNUSED(x) (void)x
 
 /** lladdr_ntop - convert @lladdr, a link layer address of size @alen, into
@@ -38,76 +38,99 @@ void xrt_get_xid(help_func_t usage, struct xia_xid *dst, const char *s)
 	}
 }
 
-/* Based on iproute2/ip/iproute.c:iproute_modify. */
-int xrt_modify_route(const struct xia_xid *dst, const struct xia_xid *gw)
+int xrt_modify(enum xiaconf_op op, const struct xiaconf_route *rt)
 {
-	int to_add = !!gw;
-	struct {
-		struct nlmsghdr 	n;
-		struct rtmsg 		r;
-		char   			buf[1024];
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
 	} req;
+	int rc;
 
-	memset(&req, 0, sizeof(req));
+	rc = xiaconf_request(&req.n, sizeof(req), op, rt);
+	if (rc) {
+		fprintf(stderr, "Cannot build request: %s\n", strerror(-rc));
+		exit(1);
+	}
+	if (xip_talk(&req.n) < 0)
+		exit(2);
+	return 0;
+}
 
-	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+int xrt_modify_local(const struct xia_xid *dst, const void *info,
+	__u8 info_len, int to_add)
+{
+	struct xiaconf_route rt;
 
-	if (to_add) {
-		/* XXX Does one really needs all these flags? */
-		req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
-		req.n.nlmsg_type = RTM_NEWROUTE;
-		req.r.rtm_scope = RT_SCOPE_LINK;
-	} else {
-		req.n.nlmsg_flags = NLM_F_REQUEST;
-		req.n.nlmsg_type = RTM_DELROUTE;
-		req.r.rtm_scope = RT_SCOPE_NOWHERE;
-	}
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_LOCAL_INDEX;
+	rt.dst = *dst;
+	assert(info_len <= sizeof(rt.protoinfo));
+	if (info_len)
+		memcpy(rt.protoinfo, info, info_len);
+	rt.protoinfo_len = info_len;
+	return xrt_modify(to_add ? XIACONF_ADD : XIACONF_DEL, &rt);
+}
 
-	req.r.rtm_family = AF_XIA;
-	req.r.rtm_table = XRTABLE_MAIN_INDEX;
-	req.r.rtm_protocol = RTPROT_BOOT;
-	req.r.rtm_type = RTN_UNICAST;
+int xrt_modify_route(const struct xia_xid *dst, const struct xia_xid *gw)
+{
+	struct xiaconf_route rt;
 
-	req.r.rtm_dst_len = sizeof(*dst);
-	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_MAIN_INDEX;
+	rt.dst = *dst;
+	if (gw) {
+		rt.gw = *gw;
+		rt.has_gw = 1;
+	}
+	return xrt_modify(gw ? XIACONF_ADD : XIACONF_DEL, &rt);
+}
 
-	if (to_add)
-		addattr_l(&req.n, sizeof(req), RTA_GATEWAY, gw, sizeof(*gw));
+int xrt_dump_request(__u32 tbl_id, xid_type_t ppal_ty)
+{
+	struct {
+		struct nlmsghdr	n;
+		struct rtmsg	r;
+		char		buf[64];
+	} req;
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
-		exit(2);
-	return 0;
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	req.n.nlmsg_type = RTM_GETROUTE;
+	req.r.rtm_family = AF_XIA;
+	req.r.rtm_table = tbl_id;
+	req.r.rtm_dst_len = sizeof(ppal_ty);
+	addattr32(&req.n, sizeof(req), RTA_TABLE, tbl_id);
+	addattr_l(&req.n, sizeof(req), RTA_DST, &ppal_ty, sizeof(ppal_ty));
+	return rtnl_dump_request_n(&rth, &req.n);
 }
 
-static struct {
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
+struct xrt_filter xrt_filter;
 
-static inline void reset_filter(__u32 tb_id, xid_type_t ty)
+void xrt_set_filter(__u32 tbl_id, xid_type_t ppal_ty)
 {
-	filter.tb = tb_id;
-	filter.xid_type = ty;
+	xrt_filter.tb = tbl_id;
+	xrt_filter.xid_type = ppal_ty;
 }
 
 /* Based on iproute2/ip/iproute.c:iproute_list_flush_or_save. */
 static int dump(__u32 tbl_id, xid_type_t ty, rtnl_filter_t print)
 {
-	reset_filter(tbl_id, ty);
+	xrt_set_filter(tbl_id, ty);
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, ty) < 0) {
 		perror("XIA RT: Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print, stdout) < 0) {
 		fprintf(stderr, "XIA RT: Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
 /* Based on iproute2/ip/iproute.c:print_route. */
-static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
+int xrt_print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	void *arg)
 {
 	FILE *fp = (FILE*)arg;
@@ -143,50 +166,97 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
-	if (tb[RTA_GATEWAY]) {
-		printf("gw ");
+	if (tb[RTA_GATEWAY])
 		assert(RTA_PAYLOAD(tb[RTA_GATEWAY]) == sizeof(struct xia_xid));
-		print_xia_xid((const struct xia_xid *)
-			RTA_DATA(tb[RTA_GATEWAY]));
-	}
+	out_xid("gw ", "gw", tb[RTA_GATEWAY] ?
+		(const struct xia_xid *)RTA_DATA(tb[RTA_GATEWAY]) : NULL);
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, " flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags(" flags [", r->rtm_flags);
+	out_record_end();
+	return 0;
+}
+
+int xrt_get(const struct xip_printer *printers, help_func_t usage,
+	const struct xia_xid *dst, __u32 tbl_id, int argc, char **argv)
+{
+	struct {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+	struct {
+		struct nlmsghdr	n;
+		char		buf[16384];	/* See rtnl_talk(). */
+	} answer;
+	const struct xip_printer *p;
+	int rc;
+
+	if (argc == 2 && !strcmp(argv[0], "table")) {
+		if (!matches(argv[1], "local")) {
+			tbl_id = XRTABLE_LOCAL_INDEX;
+		} else if (!matches(argv[1], "main")) {
+			tbl_id = XRTABLE_MAIN_INDEX;
+		} else {
+			fprintf(stderr, "Unknown table '%s', it must be either 'local', or 'main'\n",
+				argv[1]);
+			return usage();
+		}
+	} else if (argc) {
+		fprintf(stderr, "Wrong parameters\n");
+		return usage();
+	}
+
+	for (p = printers; p->ppal; p++) {
+		xid_type_t ty;
+		if (p->tbl_id == tbl_id && !ppal_name_to_type(p->ppal, &ty) &&
+			ty == dst->xid_type)
+			break;
+	}
+	if (!p->ppal) {
+		fprintf(stderr, "No printer for table %u of principal 0x%x\n",
+			tbl_id, __be32_to_cpu(dst->xid_type));
+		exit(1);
+	}
+
+	rc = xiaconf_get_request(&req.n, sizeof(req), tbl_id, dst);
+	if (rc) {
+		fprintf(stderr, "Cannot build request: %s\n", strerror(-rc));
+		exit(1);
+	}
+	if (rtnl_talk(&rth, &req.n, 0, 0, &answer.n, NULL, NULL) < 0)
+		exit(2);
+	if (answer.n.nlmsg_type != RTM_NEWROUTE) {
+		fprintf(stderr, "XIA RT: Unexpected answer of type %u\n",
+			answer.n.nlmsg_type);
+		exit(1);
+	}
+
+	p->prepare(tbl_id, dst->xid_type);
+	if (p->print(NULL, &answer.n, stdout) < 0) {
+		fprintf(stderr, "XIA RT: Malformed answer\n");
+		exit(1);
+	}
+	out_flush();
 	return 0;
 }
 
 int xrt_list_rt_redirects(__u32 tbl_id, xid_type_t ppal_ty)
 {
-	return dump(tbl_id, ppal_ty, print_route);
+	return dump(tbl_id, ppal_ty, xrt_print_route);
 }
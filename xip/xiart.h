@@ -7,6 +7,7 @@
  */
 
 #include <net/xia.h>
+#include <xiaconf.h>
 
 /* Function to help reading XIDs and ID. */
 typedef int (*help_func_t)(void);
@@ -16,8 +17,63 @@ void xrt_get_ppal_id(const char *ppal, help_func_t usage, struct xia_xid *dst,
 	const char *s);
 void xrt_get_xid(help_func_t usage, struct xia_xid *dst, const char *s);
 
+/* xrt_dump_request - request a dump of the routes of table @tbl_id whose
+ * destinations are of principal type @ppal_ty.
+ *
+ * The table goes in rtm_table and RTA_TABLE; the principal type goes in
+ * RTA_DST as a prefix of the destination, that is, rtm_dst_len is
+ * sizeof(xid_type_t). Kernels that do not filter dumps ignore both,
+ * so callers must still filter the routes they receive.
+ *
+ * RETURN
+ *	Same as rtnl_dump_request_n().
+ */
+int xrt_dump_request(__u32 tbl_id, xid_type_t ppal_ty);
+
+/* xrt_modify - send the request of operation @op on entry @rt, which
+ * xiaconf_request() builds; exit on failure.
+ */
+int xrt_modify(enum xiaconf_op op, const struct xiaconf_route *rt);
+
+/* Add (@to_add true) or delete the local entry @dst, with the
+ * protocol-specific information @info of @info_len bytes.
+ */
+int xrt_modify_local(const struct xia_xid *dst, const void *info,
+	__u8 info_len, int to_add);
+
 /* Functions to implement routing redirects. */
 int xrt_modify_route(const struct xia_xid *dst, const struct xia_xid *gw);
 int xrt_list_rt_redirects(__u32 tbl_id, xid_type_t ppal_ty);
 
+/* xrt_get - print the entry of table @tbl_id whose destination is @dst,
+ * with the printer of @printers for its table and principal.
+ *
+ * @argv holds the arguments that follow the ID, which may select another
+ * table with "table { local | main }". The kernel looks the entry up,
+ * so the table is not dumped.
+ */
+struct xip_printer;
+int xrt_get(const struct xip_printer *printers, help_func_t usage,
+	const struct xia_xid *dst, __u32 tbl_id, int argc, char **argv);
+
+/* Table and principal of the entries that printers print; entries of
+ * the other ones are skipped. Some printers only check the principal.
+ */
+struct xrt_filter {
+	__u32		tb;
+	xid_type_t	xid_type;
+};
+extern struct xrt_filter xrt_filter;
+
+/* Set up xrt_filter for @tbl_id and @ppal_ty; the prepare function of
+ * all printers of xip show.
+ */
+void xrt_set_filter(__u32 tbl_id, xid_type_t ppal_ty);
+
+/* Printer of routing redirects for xip show. */
+struct sockaddr_nl;
+struct nlmsghdr;
+int xrt_print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
+	void *arg);
+
 #endif	/* _XIART_H */
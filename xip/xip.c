@@ -2,23 +2,37 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <ppal_map.h>
+#include <net/xia_fib.h>
 
 #include "xip_common.h"
 #include "SNAPSHOT.h"
 #include "libnetlink.h"
 #include "utils.h"
+#include "xipd.h"
 
-struct rtnl_handle rth = { .fd = -1 };
+__thread struct rtnl_handle rth = { .fd = -1 };
 
 static int usage(void)
 {
 	fprintf(stderr,
 "Usage: xip [ OPTIONS ] OBJECT { COMMAND | help }\n"
-"       xip [ -force ] -batch filename\n"
+"       xip [ -force ] [ -jobs N ] -batch filename\n"
+"       xip [ -force ] -replay filename\n"
+"       xip [ -group GROUP ] -daemon SOCKET\n"
+"       xip [ OPTIONS ] -client SOCKET OBJECT { COMMAND | help }\n"
+"       xip show [ all ]\n"
+"       xip sync FILE\n"
+"       xip compile BATCH_FILE COMPILED_FILE\n"
+"       xip save FILE\n"
+"       xip restore [ -show ] FILE\n"
 "where  OBJECT := { ad | dst | ether | hid | lpm | serval | u4id | xdp | zf }\n"
 "       OPTIONS := { -V[ersion] | -s[tatistics] | -d[etails] |\n"
-"                    -o[neline] | -t[imestamp] | -b[atch] [filename] }\n");
+"                    -o[neline] | -t[imestamp] | -b[atch] [filename] |\n"
+"                    -j[obs] N | -rc[vbuf] SIZE | -json | -tsv }\n");
 	return -1;
 }
 
@@ -32,11 +46,16 @@ static int do_help(int argc, char **argv)
 
 static const struct cmd cmds[] = {
 	{ "ad", 	do_ad		},
+	{ "compile",	do_compile	},
 	{ "dst",	do_dst		},
 	{ "ether",	do_ether	},
 	{ "hid", 	do_hid		},
 	{ "lpm",	do_lpm		},
+	{ "restore",	do_restore	},
+	{ "save",	do_save		},
 	{ "serval",	do_serval	},
+	{ "show",	do_show_all	},
+	{ "sync",	do_sync		},
 	{ "u4id",	do_u4id		},
 	{ "xdp",	do_xdp		},
 	{ "zf",		do_zf		},
@@ -50,52 +69,557 @@ static inline int my_do_cmd(int argc, char **argv)
 	return do_cmd(cmds, "Object", "xip help", argc, argv);
 }
 
+int xip_do_cmd(int argc, char **argv)
+{
+	return my_do_cmd(argc, argv);
+}
+
 static char *batch_file = NULL;
+static char *replay_file = NULL;
+static char *daemon_socket = NULL;
+static char *daemon_group = NULL;
+static char *client_socket = NULL;
+/* Receive buffer of batches, or zero to keep the system limit. */
+static int batch_rcvbuf;
 
-static int batch(const char *name)
+/* Limits of a netlink batch; rtnl_batch_begin() shrinks them if
+ * the socket buffers cannot grow enough.
+ */
+#define BATCH_MAX_BYTES	(256 * 1024)
+#define BATCH_MAX_MSGS	2048
+#define BATCH_WINDOW	16384
+
+int (*xip_talk_hook)(struct nlmsghdr *n);
+
+int xip_talk(struct nlmsghdr *n)
 {
-	char *line = NULL;
-	size_t len = 0;
-	int ret = 0;
+	if (xip_talk_hook)
+		return xip_talk_hook(n);
+	if (rth.batch)
+		return rtnl_batch_add(&rth, n, cmdlineno);
+	return rtnl_talk(&rth, n, 0, 0, NULL, NULL, NULL);
+}
 
-	if (name && strcmp(name, "-") != 0) {
-		if (freopen(name, "r", stdin) == NULL) {
-			fprintf(stderr,
-				"Cannot open file \"%s\" for reading: %s\n",
-				name, strerror(errno));
-			return -1;
-		}
-	}
+static void batch_error(int tag, int err, void *arg)
+{
+	fprintf(stderr, "RTNETLINK answers: %s\n", strerror(-err));
+	fprintf(stderr, "Command failed %s:%d\n", (const char *)arg, tag);
+}
+
+int xip_batch_begin(struct rtnl_batch *nlb, rtnl_batch_err_t err_cb,
+		    void *arg)
+{
+	/* The window shrinks to what the receive buffer holds. */
+	if (batch_rcvbuf && rtnl_set_rcvbuf(&rth, batch_rcvbuf) < 0)
+		return -1;
+	return rtnl_batch_begin(&rth, nlb, BATCH_MAX_BYTES, BATCH_MAX_MSGS,
+				BATCH_WINDOW, err_cb, arg);
+}
 
+/* Open @rth and attach @nlb to it. */
+static int batch_open(const char *name, struct rtnl_batch *nlb)
+{
 	if (rtnl_open(&rth, 0) < 0) {
 		fprintf(stderr, "Cannot open rtnetlink\n");
 		return -1;
 	}
+	if (xip_batch_begin(nlb, batch_error, (void *)name) < 0) {
+		rtnl_close(&rth);
+		return -1;
+	}
+	return 0;
+}
 
-	cmdlineno = 0;
-	while (getcmdline(&line, &len, stdin) != -1) {
-		char *largv[100];
-		int largc;
+/* Flush and close @rth. RETURN nonzero if any line failed. */
+static int batch_close(struct rtnl_batch *nlb)
+{
+	int ret = rtnl_batch_end(&rth) || nlb->errors;
+
+	rtnl_close(&rth);
+	return ret;
+}
+
+/* Run a line with the handle of the calling thread.
+ * RETURN nonzero if any line has failed so far.
+ */
+static int batch_line(const char *name, int argc, char **argv,
+		      struct rtnl_batch *nlb)
+{
+	if (my_do_cmd(argc, argv)) {
+		fprintf(stderr, "Command failed %s:%d\n", name, cmdlineno);
+		return 1;
+	}
+	return !!nlb->errors;
+}
+
+/* Requests of many lines are sent together, and are not waited for,
+ * so a failure is only known some lines later; without -force, the lines
+ * that follow the failed one may have already been applied.
+ */
+static int serial_batch(const char *name)
+{
+	struct rtnl_batch nlb;
+	struct cmdfile cf;
+	char *largv[100];
+	int largc, ret = 0;
 
-		largc = makeargs(line, largv, 100);
+	if (cmdfile_open(&cf, stdin))
+		return -1;
+	if (batch_open(name, &nlb)) {
+		cmdfile_close(&cf);
+		return -1;
+	}
+
+	cmdlineno = 0;
+	while ((largc = cmdfile_next(&cf, largv, 100)) != -1) {
 		if (largc == 0)
 			continue;	/* blank line */
 
-		if (my_do_cmd(largc, largv)) {
-			fprintf(stderr, "Command failed %s:%d\n",
-				name, cmdlineno);
+		if (batch_line(name, largc, largv, &nlb)) {
 			ret = 1;
 			if (!force)
 				break;
 		}
 	}
-	if (line)
-		free(line);
+	cmdfile_close(&cf);
 
-	rtnl_close(&rth);
+	if (batch_close(&nlb))
+		ret = 1;
 	return ret;
 }
 
+/*
+ * Parallel batches
+ *
+ * With -jobs, lines are parsed and sent by worker threads, each one with
+ * its own netlink socket. Only the commands in job_cmds[] run in
+ * parallel; their handlers touch no state but the entry they change.
+ *
+ * Within a run of lines of the same class, lines are spread over
+ * the workers by the XID they change, so changes of an XID stay in order.
+ * Before a line of another class, all workers flush their batches, so
+ * that, for example, the locals added by a run of lines exist before
+ * the routes that follow them. Any other command runs in the main thread
+ * as in a serial batch, and is also surrounded by these barriers.
+ */
+
+enum job_class {
+	JC_SERIAL = 0,
+	JC_LOCAL,
+	JC_ROUTE,
+};
+
+static const struct job_cmd {
+	const char	*object;
+	const char	*cmd;
+	enum job_class	class;
+	int		id_arg;		/* Argument with the ID changed.*/
+} job_cmds[] = {
+	{ "ad",		"addlocal",	JC_LOCAL,	2 },
+	{ "ad",		"dellocal",	JC_LOCAL,	2 },
+	{ "ad",		"addroute",	JC_ROUTE,	2 },
+	{ "ad",		"delroute",	JC_ROUTE,	2 },
+	{ "lpm",	"addlocal",	JC_LOCAL,	2 },
+	{ "lpm",	"dellocal",	JC_LOCAL,	2 },
+	{ "lpm",	"addroute",	JC_ROUTE,	2 },
+	{ "lpm",	"delroute",	JC_ROUTE,	2 },
+	/* After the kind of XID, service or flow. */
+	{ "serval",	"addroute",	JC_ROUTE,	3 },
+	{ "serval",	"delroute",	JC_ROUTE,	3 },
+	{ "u4id",	"add",		JC_LOCAL,	2 },
+	{ "u4id",	"del",		JC_LOCAL,	2 },
+	{ "xdp",	"addroute",	JC_ROUTE,	2 },
+	{ "xdp",	"delroute",	JC_ROUTE,	2 },
+	{ "zf",		"addlocal",	JC_LOCAL,	2 },
+	{ "zf",		"dellocal",	JC_LOCAL,	2 },
+	{ "zf",		"addroute",	JC_ROUTE,	2 },
+	{ "zf",		"delroute",	JC_ROUTE,	2 },
+	{ NULL,		NULL,		JC_SERIAL,	0 }
+};
+
+/* Abbreviated names run serially, since their keys could not be compared
+ * with the keys of full names.
+ */
+static const struct job_cmd *find_job_cmd(int argc, char **argv)
+{
+	const struct job_cmd *c;
+
+	for (c = job_cmds; c->object; c++)
+		if (argc > c->id_arg && !strcmp(argv[0], c->object) &&
+			!strcmp(argv[1], c->cmd))
+			return c;
+	return NULL;
+}
+
+static enum job_class job_class(int argc, char **argv)
+{
+	const struct job_cmd *c = find_job_cmd(argc, argv);
+
+	return c ? c->class : JC_SERIAL;
+}
+
+int xip_is_entry_cmd(int argc, char **argv)
+{
+	return job_class(argc, argv) != JC_SERIAL;
+}
+
+unsigned int xip_entry_tables(const char *object)
+{
+	const struct job_cmd *c;
+	unsigned int tables = 0;
+
+	for (c = job_cmds; c->object; c++)
+		if (!strcmp(c->object, object))
+			tables |= 1U << (c->class == JC_LOCAL ?
+				XRTABLE_LOCAL_INDEX : XRTABLE_MAIN_INDEX);
+	return tables;
+}
+
+/* Hash of the object and XID changed by the line @argv of @c. */
+static unsigned int job_key(const struct job_cmd *c, char **argv)
+{
+	unsigned int hash = 2166136261U;
+	const char *p;
+
+	for (p = argv[0]; *p; p++)
+		hash = (hash ^ (unsigned char)*p) * 16777619U;
+	hash = (hash ^ '-') * 16777619U;
+	/* IDs are hexadecimal, so their case does not matter. */
+	for (p = argv[c->id_arg]; *p; p++)
+		hash = (hash ^ tolower((unsigned char)*p)) * 16777619U;
+	return hash;
+}
+
+#define JOB_MAX_ARGS	100
+#define JOB_QUEUE_LEN	1024
+
+struct job {
+	struct job	*next;
+	int		lineno;
+	int		argc;		/* Zero for a barrier.	*/
+	char		*argv[JOB_MAX_ARGS];
+	char		line[];
+};
+
+struct worker {
+	pthread_t	thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	nonempty;
+	pthread_cond_t	nonfull;
+	struct job	*head, *tail;
+	int		queued;
+	int		quit;
+};
+
+static struct {
+	const char	*name;
+	struct worker	*workers;
+	int		failed;
+
+	/* Workers that have not reached the barrier yet. */
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	int		pending;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void set_failed(void)
+{
+	__atomic_store_n(&pool.failed, 1, __ATOMIC_RELAXED);
+}
+
+static int should_stop(void)
+{
+	return !force && __atomic_load_n(&pool.failed, __ATOMIC_RELAXED);
+}
+
+static void push_job(struct worker *w, struct job *job)
+{
+	job->next = NULL;
+	pthread_mutex_lock(&w->lock);
+	while (w->queued >= JOB_QUEUE_LEN)
+		pthread_cond_wait(&w->nonfull, &w->lock);
+	if (w->tail)
+		w->tail->next = job;
+	else
+		w->head = job;
+	w->tail = job;
+	w->queued++;
+	pthread_cond_signal(&w->nonempty);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* RETURN the next job of @w, or NULL once @w must quit. */
+static struct job *pop_job(struct worker *w)
+{
+	struct job *job;
+
+	pthread_mutex_lock(&w->lock);
+	while (!w->head && !w->quit)
+		pthread_cond_wait(&w->nonempty, &w->lock);
+	job = w->head;
+	if (job) {
+		w->head = job->next;
+		if (!w->head)
+			w->tail = NULL;
+		w->queued--;
+		pthread_cond_signal(&w->nonfull);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return job;
+}
+
+static void barrier_arrive(void)
+{
+	pthread_mutex_lock(&pool.lock);
+	if (!--pool.pending)
+		pthread_cond_signal(&pool.cond);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/* Wait for the kernel to process all lines sent to the workers. */
+static void barrier_wait(void)
+{
+	int i;
+
+	pool.pending = jobs;
+	for (i = 0; i < jobs; i++) {
+		struct job *job = malloc(sizeof(*job));
+		if (!job) {
+			fprintf(stderr, "Cannot allocate barrier\n");
+			exit(1);
+		}
+		job->argc = 0;
+		push_job(&pool.workers[i], job);
+	}
+
+	pthread_mutex_lock(&pool.lock);
+	while (pool.pending)
+		pthread_cond_wait(&pool.cond, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct rtnl_batch nlb;
+	struct job *job;
+
+	/* Skipping the lines of a worker would break -force. */
+	if (batch_open(pool.name, &nlb))
+		exit(1);
+
+	/* Keep consuming jobs after failures, so that barriers complete. */
+	while ((job = pop_job(w))) {
+		if (!job->argc) {
+			if (rtnl_batch_flush(&rth) < 0)
+				set_failed();
+			barrier_arrive();
+		} else if (!should_stop()) {
+			cmdlineno = job->lineno;
+			if (batch_line(pool.name, job->argc, job->argv, &nlb))
+				set_failed();
+		}
+		free(job);
+	}
+
+	if (batch_close(&nlb))
+		set_failed();
+	return NULL;
+}
+
+static int start_workers(void)
+{
+	int i;
+
+	pool.workers = calloc(jobs, sizeof(*pool.workers));
+	if (!pool.workers) {
+		fprintf(stderr, "Cannot allocate workers\n");
+		return -1;
+	}
+	for (i = 0; i < jobs; i++) {
+		struct worker *w = &pool.workers[i];
+
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->nonempty, NULL);
+		pthread_cond_init(&w->nonfull, NULL);
+		if (pthread_create(&w->thread, NULL, worker_main, w)) {
+			fprintf(stderr, "Cannot start worker %i\n", i);
+			exit(1);
+		}
+	}
+	return 0;
+}
+
+static void stop_workers(void)
+{
+	int i;
+
+	for (i = 0; i < jobs; i++) {
+		struct worker *w = &pool.workers[i];
+
+		pthread_mutex_lock(&w->lock);
+		w->quit = 1;
+		pthread_cond_signal(&w->nonempty);
+		pthread_mutex_unlock(&w->lock);
+	}
+	for (i = 0; i < jobs; i++) {
+		struct worker *w = &pool.workers[i];
+
+		pthread_join(w->thread, NULL);
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->nonempty);
+		pthread_cond_destroy(&w->nonfull);
+	}
+	free(pool.workers);
+	pool.workers = NULL;
+}
+
+/* Copy the arguments of a line into a job, since they only last until
+ * the next line is read.
+ */
+static struct job *new_job(int argc, char **argv)
+{
+	size_t lens[JOB_MAX_ARGS], size = 0;
+	struct job *job;
+	char *p;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		lens[i] = strlen(argv[i]) + 1;
+		size += lens[i];
+	}
+	job = malloc(sizeof(*job) + size);
+	if (!job) {
+		fprintf(stderr, "Cannot allocate line %d\n", cmdlineno);
+		exit(1);
+	}
+	job->lineno = cmdlineno;
+	job->argc = argc;
+	for (i = 0, p = job->line; i < argc; p += lens[i++]) {
+		memcpy(p, argv[i], lens[i]);
+		job->argv[i] = p;
+	}
+	job->argv[argc] = NULL;
+	return job;
+}
+
+static int parallel_batch(const char *name)
+{
+	enum job_class cur = JC_SERIAL;
+	struct rtnl_batch nlb;
+	struct cmdfile cf;
+	char *largv[JOB_MAX_ARGS];
+	int largc;
+
+	if (cmdfile_open(&cf, stdin))
+		return -1;
+	/* The main thread runs the lines that cannot run in parallel. */
+	if (batch_open(name, &nlb)) {
+		cmdfile_close(&cf);
+		return -1;
+	}
+	pool.name = name;
+	if (start_workers()) {
+		batch_close(&nlb);
+		cmdfile_close(&cf);
+		return -1;
+	}
+
+	cmdlineno = 0;
+	while (!should_stop() &&
+		(largc = cmdfile_next(&cf, largv, JOB_MAX_ARGS)) != -1) {
+		enum job_class class;
+		struct job *job;
+		unsigned int key;
+
+		if (largc == 0)
+			continue;	/* blank line */
+		job = new_job(largc, largv);
+
+		class = job_class(job->argc, job->argv);
+		if (class != cur) {
+			if (cur == JC_SERIAL) {
+				if (rtnl_batch_flush(&rth) < 0)
+					set_failed();
+			} else {
+				barrier_wait();
+			}
+			cur = class;
+			if (should_stop()) {
+				free(job);
+				break;
+			}
+		}
+
+		if (class == JC_SERIAL) {
+			if (batch_line(name, job->argc, job->argv, &nlb))
+				set_failed();
+			free(job);
+			continue;
+		}
+		key = job_key(find_job_cmd(job->argc, job->argv), job->argv);
+		push_job(&pool.workers[key % jobs], job);
+	}
+	cmdfile_close(&cf);
+
+	stop_workers();
+	if (batch_close(&nlb))
+		set_failed();
+	return pool.failed;
+}
+
+static int batch(const char *name)
+{
+	if (name && strcmp(name, "-") != 0) {
+		if (freopen(name, "r", stdin) == NULL) {
+			fprintf(stderr,
+				"Cannot open file \"%s\" for reading: %s\n",
+				name, strerror(errno));
+			return -1;
+		}
+	}
+
+	if (jobs > 1)
+		return parallel_batch(name);
+	return serial_batch(name);
+}
+
+/* Run the command line in the daemon listening at @path. */
+static int client(const char *path, int argc, char **argv)
+{
+	struct xipd_opts opts = {
+		.show_stats	= show_stats,
+		.show_details	= show_details,
+		.oneline	= oneline,
+		.timestamp	= timestamp,
+		.force		= force,
+		.out_format	= out_format,
+		.jobs		= jobs,
+	};
+	int sock, rc;
+
+	if (argc < 1)
+		return usage();
+	sock = xipd_connect(path);
+	if (sock < 0) {
+		fprintf(stderr, "Cannot connect to xipd at '%s': %s\n", path,
+			strerror(errno));
+		return 1;
+	}
+	fflush(stdout);
+	rc = xipd_run(sock, &opts, argc, argv, 1, 2);
+	if (rc < 0) {
+		fprintf(stderr, "Cannot run command in xipd: %s\n",
+			strerror(errno));
+		rc = 1;
+	}
+	close(sock);
+	return rc;
+}
+
 int main(int argc, char **argv)
 {
 	const char *ppal_map_file = NULL;
@@ -120,6 +644,8 @@ int main(int argc, char **argv)
 			++oneline;
 		} else if (matches(opt, "-timestamp") == 0) {
 			++timestamp;
+		} else if (matches(opt, "-tsv") == 0) {
+			out_format = OUT_TSV;
 		} else if (matches(opt, "-Version") == 0) {
 			printf("xip utility, xiaconf-ss%s\n", SNAPSHOT);
 			exit(0);
@@ -131,6 +657,54 @@ int main(int argc, char **argv)
 			if (argc <= 1)
 				return usage();
 			batch_file = argv[1];
+		} else if (matches(opt, "-replay") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			replay_file = argv[1];
+		} else if (matches(opt, "-daemon") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			daemon_socket = argv[1];
+		} else if (matches(opt, "-group") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			daemon_group = argv[1];
+		} else if (matches(opt, "-client") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			client_socket = argv[1];
+		} else if (matches(opt, "-jobs") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			jobs = atoi(argv[1]);
+			if (jobs < 1 || jobs > MAX_JOBS) {
+				fprintf(stderr, "Number of jobs must be "
+					"between 1 and %i\n", MAX_JOBS);
+				exit(1);
+			}
+		} else if (matches(opt, "-rcvbuf") == 0) {
+			argc--;
+			argv++;
+			if (argc <= 1)
+				return usage();
+			batch_rcvbuf = atoi(argv[1]);
+			if (batch_rcvbuf < 1) {
+				fprintf(stderr, "Invalid receive buffer "
+					"size \"%s\"\n", argv[1]);
+				exit(1);
+			}
+		} else if (matches(opt, "-json") == 0) {
+			out_format = OUT_JSON;
 		} else if (matches(opt, "-help") == 0) {
 			return usage();
 		} else if (matches(opt, "-ppal-map") == 0) {
@@ -149,10 +723,18 @@ int main(int argc, char **argv)
 
 	_SL_ = oneline ? "\\" : "\n" ;
 
+	/* The daemon loaded its own principal map. */
+	if (client_socket)
+		return client(client_socket, argc - 1, argv + 1);
+
 	assert(!init_ppal_map(ppal_map_file));
 
 	if (batch_file)
 		return batch(batch_file);
+	if (replay_file)
+		return xip_replay(replay_file) ? 1 : 0;
+	if (daemon_socket)
+		return xipd_serve(daemon_socket, daemon_group);
 
 	if (argc > 1) {
 		int rc;
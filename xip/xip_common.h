@@ -1,26 +1,104 @@
 #ifndef HEADER_XIP_COMMON
 #define HEADER_XIP_COMMON
 
+#include <net/xia.h>
+
+#include "output.h"
+
+struct sockaddr_nl;
+struct nlmsghdr;
+
+/* A printer of the routes that a principal keeps in a table;
+ * see xipshow.c.
+ */
+struct xip_printer {
+	const char	*ppal;		/* Name of the principal.	*/
+	__u32		tbl_id;
+	const char	*title;
+	/* Set up the filter of @print for @tbl_id and @ty. */
+	void		(*prepare)(__u32 tbl_id, xid_type_t ty);
+	int		(*print)(const struct sockaddr_nl *who,
+				 struct nlmsghdr *n, void *arg);
+};
+
 /* From xip.c */
-extern struct rtnl_handle rth;
+/* Each worker of xip -jobs has its own handle. */
+extern __thread struct rtnl_handle rth;
+/* Send @n to the kernel, and wait for its ACK; in batch mode, @n is only
+ * queued, and failures are reported with the line of the batch file.
+ */
+int xip_talk(struct nlmsghdr *n);
+/* While set, xip_talk() hands requests to this hook instead. */
+extern int (*xip_talk_hook)(struct nlmsghdr *n);
+/* Run a command line as xip would. */
+int xip_do_cmd(int argc, char **argv);
+/* RETURN true if the command line only changes the entry it names, so
+ * it does not depend on the state of the kernel, nor on other lines.
+ */
+int xip_is_entry_cmd(int argc, char **argv);
+/* RETURN the tables, as bits 1 << XRTABLE_*_INDEX, whose entries
+ * the entry commands of @object change; zero if it has none.
+ */
+unsigned int xip_entry_tables(const char *object);
+/* Attach @nlb to rth with the limits that xip -batch uses. */
+struct rtnl_batch;
+int xip_batch_begin(struct rtnl_batch *nlb,
+		    void (*err_cb)(int tag, int err, void *arg), void *arg);
+
+/* From compile.c */
+int do_compile(int argc, char **argv);
+/* Send the requests of a compiled batch file. */
+int xip_replay(const char *name);
+
+/* From dump.c */
+/* Same as rtnl_dump_filter(&rth, @filter, @fp, NULL, NULL), but with
+ * -jobs, @filter runs on several threads; it must only write records
+ * through output.h.
+ */
+int xip_dump_filter(int (*filter)(const struct sockaddr_nl *who,
+				  struct nlmsghdr *n, void *arg), FILE *fp);
 
 /* From xipad.c */
 int do_ad(int argc, char **argv);
+extern const struct xip_printer ad_printers[];
 /* From xipdst.c */
 int do_dst(int argc, char **argv);
 /* From xipether.c */
 int do_ether(int argc, char **argv);
+extern const struct xip_printer ether_printers[];
 /* From xiphid.c */
 int do_hid(int argc, char **argv);
+extern const struct xip_printer hid_printers[];
 /* From xiplpm.c */
 int do_lpm(int argc, char **argv);
+extern const struct xip_printer lpm_printers[];
+/* From xipsave.c */
+int do_save(int argc, char **argv);
+int do_restore(int argc, char **argv);
+/* From xipshow.c */
+int do_show_all(int argc, char **argv);
+/* Print routes of any principal as xip show does; @arg is the stream.
+ * Routes go between show_begin() and show_end().
+ */
+void show_begin(void);
+int show_route(const struct sockaddr_nl *who, struct nlmsghdr *n, void *arg);
+void show_end(FILE *fp);
+/* From xipsync.c */
+int do_sync(int argc, char **argv);
+
+/* From xipd.c */
+int xipd_serve(const char *path, const char *group);
 /* From xipserval.c */
 int do_serval(int argc, char **argv);
+extern const struct xip_printer serval_printers[];
 /* From xipu4id.c */
 int do_u4id(int argc, char **argv);
+extern const struct xip_printer u4id_printers[];
 /* From xipxdp.c */
 int do_xdp(int argc, char **argv);
+extern const struct xip_printer xdp_printers[];
 /* From xipzf.c */
 int do_zf(int argc, char **argv);
+extern const struct xip_printer zf_printers[];
 
 #endif /* HEADER_XIP_COMMON */
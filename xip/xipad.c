@@ -18,6 +18,7 @@ static int usage(void)
 "Usage:	xip ad { addlocal | dellocal } ID\n"
 "	xip ad addroute ID gw XID\n"
 "	xip ad delroute ID\n"
+"	xip ad get ID [ table { local | main } ]\n"
 "	xip ad show { locals | routes }\n"
 "where	ID := HEXDIGIT{20}\n"
 "	XID := PRINCIPAL '-' ID\n"
@@ -25,41 +26,6 @@ static int usage(void)
 	return -1;
 }
 
-static int modify_local(const struct xia_xid *dst, int to_add)
-{
-	struct {
-		struct nlmsghdr 	n;
-		struct rtmsg 		r;
-		char   			buf[1024];
-	} req;
-
-	memset(&req, 0, sizeof(req));
-
-	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
-
-	if (to_add) {
-		/* XXX Does one really needs all these flags? */
-		req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
-		req.n.nlmsg_type = RTM_NEWROUTE;
-	} else {
-		req.n.nlmsg_flags = NLM_F_REQUEST;
-		req.n.nlmsg_type = RTM_DELROUTE;
-	}
-
-	req.r.rtm_family = AF_XIA;
-	req.r.rtm_table = XRTABLE_LOCAL_INDEX;
-	req.r.rtm_protocol = RTPROT_BOOT;
-	req.r.rtm_type = RTN_LOCAL;
-	req.r.rtm_scope = RT_SCOPE_HOST;
-
-	req.r.rtm_dst_len = sizeof(*dst);
-	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
-
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
-		exit(2);
-	return 0;
-}
-
 static int do_local(int argc, char **argv, int to_add)
 {
 	struct xia_xid dst;
@@ -69,7 +35,7 @@ static int do_local(int argc, char **argv, int to_add)
 		return usage();
 	}
 	xrt_get_ppal_id("ad", usage, &dst, argv[0]);
-	return modify_local(&dst, to_add);
+	return xrt_modify_local(&dst, NULL, 0, to_add);
 }
 
 static int do_addlocal(int argc, char **argv)
@@ -113,16 +79,23 @@ static int do_delroute(int argc, char **argv)
 	return xrt_modify_route(&dst, NULL);
 }
 
-static struct
+static int do_get(int argc, char **argv)
 {
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
+	struct xia_xid dst;
+
+	if (argc != 1 && argc != 3) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+	xrt_get_ppal_id("ad", usage, &dst, argv[0]);
+	return xrt_get(ad_printers, usage, &dst, XRTABLE_MAIN_INDEX,
+		argc - 1, argv + 1);
+}
 
 static inline void reset_filter(void)
 {
-	memset(&filter, 0, sizeof(filter));
-	assert(!ppal_name_to_type("ad", &filter.xid_type));
+	memset(&xrt_filter, 0, sizeof(xrt_filter));
+	assert(!ppal_name_to_type("ad", &xrt_filter.xid_type));
 }
 
 /* Based on iproute2/ip/iproute.c:print_route. */
@@ -162,47 +135,30 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
-	if (tb[RTA_GATEWAY]) {
-		printf("gw ");
+	if (tb[RTA_GATEWAY])
 		assert(RTA_PAYLOAD(tb[RTA_GATEWAY]) == sizeof(struct xia_xid));
-		/* XXX It got to use @fp! */
-		print_xia_xid((const struct xia_xid *)
-			RTA_DATA(tb[RTA_GATEWAY]));
-	}
+	out_xid("gw ", "gw", tb[RTA_GATEWAY] ?
+		(const struct xia_xid *)RTA_DATA(tb[RTA_GATEWAY]) : NULL);
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, " flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags(" flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -210,16 +166,17 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 static int dump(int tbl_id)
 {
 	reset_filter();
-	filter.tb = tbl_id;
+	xrt_filter.tb = tbl_id;
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_route, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_route, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
@@ -254,11 +211,19 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer ad_printers[] = {
+	{ "ad", XRTABLE_LOCAL_INDEX, "ad locals", xrt_set_filter, print_route },
+	{ "ad", XRTABLE_MAIN_INDEX, "ad routes", xrt_set_filter,
+		xrt_print_route },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "addlocal",	do_addlocal	},
 	{ "dellocal",	do_dellocal	},
 	{ "addroute",	do_addroute	},
 	{ "delroute",	do_delroute	},
+	{ "get",	do_get		},
 	{ "show",	do_show		},
 	{ "help",	do_help		},
 	{ 0,		0		}
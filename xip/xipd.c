@@ -0,0 +1,613 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+#include "ll_map.h"
+#include "xipd.h"
+
+/* xipd: xip as a daemon
+ *
+ * The daemon loads the principal map, opens the netlink socket, and dumps
+ * the links once; a netlink subscription keeps the cache of links up to
+ * date. Every request then runs in a child forked from the daemon, so
+ * the child starts with all of this state, and a command that exits on
+ * an error only ends its child. Children write straight to the standard
+ * output and error of their clients.
+ *
+ * Commands that only change an entry (see xip_is_entry_cmd()) send
+ * nothing themselves: their children hand the requests they build to
+ * the daemon through a pipe, and the daemon sends the requests of all
+ * clients that are ready together in a netlink batch. Clients learn
+ * the outcome once the kernel acknowledges their requests; the errors
+ * of the kernel come with the reply, since the daemon must not block
+ * writing to a client. Other
+ * commands open their own netlink socket in their children.
+ *
+ * Commands change the routes of the host, so only root, and the members
+ * of the group given to xipd_serve(), may connect; the group is checked
+ * against the effective group of the client.
+ */
+
+struct client {
+	int		sock;		/* -1 marks a free slot.	*/
+	/* The request in flight; a connection runs one at a time. */
+	int		busy;
+	pid_t		pid;
+	int		pipe;		/* Requests of the child.	*/
+	char		*msgs;
+	size_t		len;
+	size_t		size;
+	int		queued;		/* Requests sent in the batch.	*/
+	int		failed;
+	/* Errors that go with the reply. */
+	char		errs[XIPD_MAX_ERRS];
+	int		errs_len;
+	int		errs_lost;
+};
+
+static struct {
+	int		listen;
+	struct rtnl_handle links;	/* Subscription to links.	*/
+	struct rtnl_batch nlb;
+	struct client	*clients;
+	int		nr_clients;
+	int		batched;	/* Clients with queued requests.*/
+	gid_t		gid;		/* Group of clients, or -1.	*/
+} daemon_state;
+
+static void close_client(struct client *c)
+{
+	close(c->sock);
+	c->sock = -1;
+}
+
+static void client_error(struct client *c, const char *fmt, ...)
+{
+	int room = sizeof(c->errs) - c->errs_len;
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(c->errs + c->errs_len, room, fmt, ap);
+	va_end(ap);
+	if (len < room)
+		c->errs_len += len;
+	else
+		c->errs_lost++;
+}
+
+static void reply(struct client *c, int status)
+{
+	struct xipd_reply r = {
+		.magic		= XIPD_MAGIC,
+		.status		= status,
+		.errs_len	= c->errs_len,
+		.errs_lost	= c->errs_lost,
+	};
+	struct iovec iov[2] = {
+		{ .iov_base = &r, .iov_len = sizeof(r) },
+		{ .iov_base = c->errs, .iov_len = c->errs_len },
+	};
+	struct msghdr msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+
+	free(c->msgs);
+	c->msgs = NULL;
+	c->len = c->size = 0;
+	c->busy = 0;
+	c->errs_len = c->errs_lost = 0;
+	if (sendmsg(c->sock, &msg, MSG_NOSIGNAL) !=
+		(ssize_t)(sizeof(r) + r.errs_len))
+		close_client(c);
+}
+
+static void batch_error(int tag, int err, void *arg)
+{
+	struct client *c = &daemon_state.clients[tag];
+
+	UNUSED(arg);
+	c->failed = 1;
+	client_error(c, "RTNETLINK answers: %s\n", strerror(-err));
+}
+
+/*
+ *	Children
+ */
+
+static int record_fd;
+
+/* Hand @n to the daemon instead of sending it. */
+static int record(struct nlmsghdr *n)
+{
+	size_t len = NLMSG_ALIGN(n->nlmsg_len);
+	const char *p = (const char *)n;
+
+	/* Requests are built in zeroed buffers, so padding is zero. */
+	while (len) {
+		ssize_t w = write(record_fd, p, len);
+		if (w < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("Cannot hand request to xipd");
+			return -1;
+		}
+		p += w;
+		len -= w;
+	}
+	return 0;
+}
+
+static void run_child(const struct xipd_request *req, char **argv,
+	int fds[3], int pipe_fd)
+{
+	int rc;
+
+	signal(SIGPIPE, SIG_DFL);
+	close(daemon_state.listen);
+	if (fchdir(fds[0]) || dup2(fds[1], 1) < 0 || dup2(fds[2], 2) < 0)
+		_exit(1);
+
+	show_stats = req->opts.show_stats;
+	show_details = req->opts.show_details;
+	oneline = req->opts.oneline;
+	timestamp = req->opts.timestamp;
+	force = req->opts.force;
+	jobs = req->opts.jobs ? req->opts.jobs : 1;
+	if (req->opts.out_format <= OUT_TSV)
+		out_format = req->opts.out_format;
+	_SL_ = oneline ? "\\" : "\n";
+
+	if (xip_is_entry_cmd(req->argc, argv)) {
+		record_fd = pipe_fd;
+		xip_talk_hook = record;
+	} else {
+		/* The socket of the daemon is shared with the daemon. */
+		rtnl_close(&rth);
+		if (rtnl_open(&rth, 0) < 0) {
+			fprintf(stderr, "Cannot open rtnetlink\n");
+			exit(1);
+		}
+	}
+	rc = xip_do_cmd(req->argc, argv);
+	exit(rc ? 1 : 0);
+}
+
+/* Parse the request in @buf, and fork its child. */
+static int start_request(struct client *c, char *buf, size_t len,
+	int fds[3])
+{
+	struct xipd_request *req = (struct xipd_request *)buf;
+	char *argv[XIPD_MAX_ARGS + 1];
+	char *p = buf + sizeof(*req), *end = buf + len;
+	int pipe_fds[2], i;
+
+	if (len < sizeof(*req) || req->magic != XIPD_MAGIC ||
+		req->version != XIPD_VERSION || req->argc > XIPD_MAX_ARGS)
+		return -1;
+	for (i = 0; i < req->argc; i++) {
+		char *nul = memchr(p, '\0', end - p);
+		if (!nul)
+			return -1;
+		argv[i] = p;
+		p = nul + 1;
+	}
+	argv[i] = NULL;
+
+	if (pipe2(pipe_fds, O_CLOEXEC)) {
+		perror("Cannot create pipe");
+		return -1;
+	}
+	fflush(stdout);
+	fflush(stderr);
+	c->pid = fork();
+	if (c->pid < 0) {
+		perror("Cannot fork");
+		close(pipe_fds[0]);
+		close(pipe_fds[1]);
+		return -1;
+	}
+	if (!c->pid) {
+		close(pipe_fds[0]);
+		run_child(req, argv, fds, pipe_fds[1]);
+	}
+
+	close(pipe_fds[1]);
+	c->pipe = pipe_fds[0];
+	c->busy = 1;
+	c->queued = 0;
+	c->failed = 0;
+	return 0;
+}
+
+static void read_request(struct client *c)
+{
+	union {
+		char		buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr	align;
+	} control;
+	char buf[XIPD_MAX_REQ];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int fds[3] = { -1, -1, -1 };
+	ssize_t n;
+	int i;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	n = recvmsg(c->sock, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN))
+		return;
+	if (n <= 0) {
+		close_client(c);
+		return;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		if (cmsg->cmsg_level == SOL_SOCKET &&
+			cmsg->cmsg_type == SCM_RIGHTS &&
+			cmsg->cmsg_len == CMSG_LEN(sizeof(fds)))
+			memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+	if (fds[0] < 0 || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+		start_request(c, buf, n, fds)) {
+		/* Malformed requests end their connections. */
+		close_client(c);
+	}
+	for (i = 0; i < 3; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+}
+
+/* The batch did not reach the kernel, or its answers were lost, so
+ * the outcome of the queued requests is unknown: fail their clients,
+ * and start a new batch.
+ */
+static void batch_failed(void)
+{
+	int i;
+
+	rtnl_batch_end(&rth);
+	for (i = 0; i < daemon_state.nr_clients; i++) {
+		struct client *c = &daemon_state.clients[i];
+		if (c->busy && c->queued && c->pipe < 0) {
+			client_error(c, "Cannot send batch, "
+				"requests may be lost\n");
+			reply(c, 1);
+		}
+	}
+	daemon_state.batched = 0;
+	if (xip_batch_begin(&daemon_state.nlb, batch_error, NULL) < 0)
+		exit(1);
+}
+
+/* Collect the requests of the child of @c; once the child is done,
+ * queue them, or answer the client.
+ */
+static void read_child(struct client *c)
+{
+	struct nlmsghdr *n;
+	size_t off;
+	ssize_t r;
+	int status;
+
+	if (c->size - c->len < 16 * 1024) {
+		size_t size = c->size ? c->size * 2 : 64 * 1024;
+		char *msgs = realloc(c->msgs, size);
+		if (!msgs) {
+			fprintf(stderr, "Cannot allocate requests\n");
+			exit(1);
+		}
+		c->msgs = msgs;
+		c->size = size;
+	}
+	r = read(c->pipe, c->msgs + c->len, c->size - c->len);
+	if (r < 0 && (errno == EINTR || errno == EAGAIN))
+		return;
+	if (r > 0) {
+		c->len += r;
+		return;
+	}
+
+	close(c->pipe);
+	c->pipe = -1;
+	while (waitpid(c->pid, &status, 0) < 0 && errno == EINTR)
+		;
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		/* The child already reported the failure. */
+		reply(c, WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+		return;
+	}
+
+	for (off = 0; off + NLMSG_HDRLEN <= c->len;
+		off += NLMSG_ALIGN(n->nlmsg_len)) {
+		n = (struct nlmsghdr *)(c->msgs + off);
+		if (n->nlmsg_len < NLMSG_HDRLEN ||
+			NLMSG_ALIGN(n->nlmsg_len) > c->len - off)
+			break;
+		c->queued++;
+		if (rtnl_batch_add(&rth, n, c - daemon_state.clients)) {
+			batch_failed();
+			return;
+		}
+	}
+	if (c->queued)
+		daemon_state.batched++;
+	else
+		reply(c, 0);
+}
+
+/* Wait for the kernel to process the queued requests of all clients,
+ * and answer them.
+ */
+static void flush(void)
+{
+	int i;
+
+	if (!daemon_state.batched)
+		return;
+	if (rtnl_batch_flush(&rth) < 0) {
+		batch_failed();
+		return;
+	}
+	for (i = 0; i < daemon_state.nr_clients; i++) {
+		struct client *c = &daemon_state.clients[i];
+		if (c->sock >= 0 && c->busy && c->queued && c->pipe < 0)
+			reply(c, c->failed);
+	}
+	daemon_state.batched = 0;
+}
+
+static int allowed(int sock)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) ||
+		len != sizeof(cred))
+		return 0;
+	return cred.uid == 0 || (daemon_state.gid != (gid_t)-1 &&
+		cred.gid == daemon_state.gid);
+}
+
+static void accept_client(void)
+{
+	struct client *c;
+	int sock, i;
+
+	sock = accept4(daemon_state.listen, NULL, NULL,
+		SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (sock < 0)
+		return;
+	if (!allowed(sock)) {
+		close(sock);
+		return;
+	}
+
+	/* Slots of clients in flight stay taken, since they are tags. */
+	for (i = 0; i < daemon_state.nr_clients; i++)
+		if (daemon_state.clients[i].sock < 0 &&
+			!daemon_state.clients[i].busy)
+			break;
+	if (i == daemon_state.nr_clients) {
+		c = realloc(daemon_state.clients,
+			(i + 1) * sizeof(*daemon_state.clients));
+		if (!c) {
+			close(sock);
+			return;
+		}
+		daemon_state.clients = c;
+		daemon_state.nr_clients++;
+	}
+	c = &daemon_state.clients[i];
+	memset(c, 0, sizeof(*c));
+	c->sock = sock;
+	c->pipe = -1;
+}
+
+/*
+ *	Links
+ */
+
+static void read_links(void)
+{
+	char buf[32 * 1024];
+	struct nlmsghdr *h;
+	ssize_t len;
+
+	while ((len = recv(daemon_state.links.fd, buf, sizeof(buf),
+		MSG_DONTWAIT)) != 0) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != ENOBUFS)
+				return;
+			/* Events were lost; dump the links again. */
+			if (rtnl_wilddump_request(&rth, AF_UNSPEC,
+				RTM_GETLINK) < 0 ||
+				rtnl_dump_filter(&rth, ll_remember_index,
+				NULL, NULL, NULL) < 0)
+				fprintf(stderr, "Cannot dump links\n");
+			continue;
+		}
+		for (h = (struct nlmsghdr *)buf; NLMSG_OK(h, len);
+			h = NLMSG_NEXT(h, len))
+			ll_remember_index(NULL, h, NULL);
+	}
+}
+
+static int open_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	mode_t mask;
+	int sock, rc;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path '%s' is too long\n", path);
+		return -1;
+	}
+	sock = xipd_connect(path);
+	if (sock >= 0) {
+		fprintf(stderr, "A daemon already listens at '%s'\n", path);
+		close(sock);
+		return -1;
+	}
+	unlink(path);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		goto fail;
+	/* Create the socket private; a chmod(2) after bind(2) would leave
+	 * it open to anyone in between.
+	 */
+	mask = umask(0177);
+	rc = bind(sock, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (rc)
+		goto fail;
+	if (daemon_state.gid != (gid_t)-1 &&
+		(chown(path, -1, daemon_state.gid) || chmod(path, 0660)))
+		goto fail;
+	if (listen(sock, 128))
+		goto fail;
+	return sock;
+
+fail:
+	fprintf(stderr, "Cannot listen at '%s': %s\n", path, strerror(errno));
+	if (sock >= 0)
+		close(sock);
+	return -1;
+}
+
+/* Parse @group, a name or a number. */
+static int parse_group(const char *group, gid_t *pgid)
+{
+	struct group *gr;
+	char *end;
+	unsigned long id;
+
+	if (!group) {
+		*pgid = -1;
+		return 0;
+	}
+	gr = getgrnam(group);
+	if (gr) {
+		*pgid = gr->gr_gid;
+		return 0;
+	}
+	id = strtoul(group, &end, 10);
+	if (!*group || *end || id >= (gid_t)-1) {
+		fprintf(stderr, "Group '%s' is unknown\n", group);
+		return -1;
+	}
+	*pgid = id;
+	return 0;
+}
+
+int xipd_serve(const char *path, const char *group)
+{
+	struct pollfd *pfds = NULL;
+	struct client **owners = NULL;
+	int size = 0;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	if (parse_group(group, &daemon_state.gid))
+		return 1;
+	if (rtnl_open(&rth, 0) < 0 ||
+		rtnl_open(&daemon_state.links, RTMGRP_LINK) < 0) {
+		fprintf(stderr, "Cannot open rtnetlink\n");
+		return 1;
+	}
+	/* Events come before the dump, so no link is missed. */
+	ll_init_map(&rth);
+
+	daemon_state.listen = open_listen(path);
+	if (daemon_state.listen < 0)
+		return 1;
+	if (xip_batch_begin(&daemon_state.nlb, batch_error, NULL) < 0)
+		return 1;
+
+	while (1) {
+		int n = 3 + 2 * daemon_state.nr_clients;
+		int i, k = 0;
+
+		if (n > size) {
+			pfds = realloc(pfds, n * sizeof(*pfds));
+			owners = realloc(owners, n * sizeof(*owners));
+			if (!pfds || !owners) {
+				fprintf(stderr, "Cannot allocate clients\n");
+				return 1;
+			}
+			size = n;
+		}
+
+		pfds[k].fd = daemon_state.listen;
+		pfds[k].events = POLLIN;
+		owners[k++] = NULL;
+		pfds[k].fd = daemon_state.links.fd;
+		pfds[k].events = POLLIN;
+		owners[k++] = NULL;
+		for (i = 0; i < daemon_state.nr_clients; i++) {
+			struct client *c = &daemon_state.clients[i];
+
+			if (c->busy && c->pipe >= 0) {
+				pfds[k].fd = c->pipe;
+				pfds[k].events = POLLIN;
+				owners[k++] = c;
+			} else if (c->sock >= 0 && !c->busy) {
+				pfds[k].fd = c->sock;
+				pfds[k].events = POLLIN;
+				owners[k++] = c;
+			}
+		}
+
+		if (poll(pfds, k, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("poll");
+			return 1;
+		}
+
+		if (pfds[1].revents)
+			read_links();
+		for (i = 2; i < k; i++) {
+			struct client *c = owners[i];
+
+			if (!pfds[i].revents)
+				continue;
+			if (c->busy)
+				read_child(c);
+			else
+				read_request(c);
+		}
+		/* Requests of all clients that got ready go together. */
+		flush();
+		if (pfds[0].revents)
+			accept_client();
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef HEADER_XIPD_H
+#define HEADER_XIPD_H
+
+/* Protocol of xipd, the daemon that xip -daemon runs.
+ *
+ * Clients connect to a SOCK_SEQPACKET Unix socket, and send one request
+ * per packet: a struct xipd_request followed by @argc arguments, each one
+ * terminated with '\0', that form the command line of xip after its
+ * options. The packet carries the descriptors of the working directory,
+ * the standard output, and the standard error of the command, in this
+ * order, as SCM_RIGHTS. Once the command finishes, the daemon answers
+ * with a struct xipd_reply followed by @errs_len bytes of errors that
+ * the daemon reports for the command, to be written to its standard
+ * error.
+ *
+ * This header and xipd_client.c only depend on the C library, so that
+ * other programs can build them in to talk to xipd.
+ */
+
+#include <stdint.h>
+
+#define XIPD_MAGIC	0x58495044	/* "XIPD" */
+#define XIPD_VERSION	2
+/* Largest request. */
+#define XIPD_MAX_REQ	(64 * 1024)
+#define XIPD_MAX_ARGS	100
+/* Largest errors of a reply. */
+#define XIPD_MAX_ERRS	(16 * 1024)
+
+/* Options of xip; see its usage. */
+struct xipd_opts {
+	uint8_t		show_stats;
+	uint8_t		show_details;
+	uint8_t		oneline;
+	uint8_t		timestamp;
+	uint8_t		force;
+	uint8_t		out_format;	/* enum out_format of output.h.	*/
+	uint16_t	jobs;
+};
+
+struct xipd_request {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	argc;
+	struct xipd_opts opts;
+};
+
+struct xipd_reply {
+	uint32_t	magic;
+	int32_t		status;		/* Exit status of the command.	*/
+	uint32_t	errs_len;
+	/* Errors that did not fit in XIPD_MAX_ERRS bytes. */
+	uint32_t	errs_lost;
+};
+
+/** xipd_connect - connect to the daemon listening at @path.
+ * RETURN
+ *	Return the socket if success; otherwise a negative number with
+ *	errno set.
+ */
+int xipd_connect(const char *path);
+
+/** xipd_run - run the command line @argv of @argc arguments in the daemon
+ *		connected to @sock, as xip would with the options @opts.
+ *		The command writes to @out_fd and @err_fd, and resolves
+ *		relative paths from the current working directory.
+ * RETURN
+ *	Return the exit status of the command, or a negative number with
+ *	errno set if the daemon could not be reached.
+ * NOTES
+ *	A connection serves any number of commands, one at a time.
+ */
+int xipd_run(int sock, const struct xipd_opts *opts, int argc, char **argv,
+	int out_fd, int err_fd);
+
+#endif /* HEADER_XIPD_H */
@@ -0,0 +1,149 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "xipd.h"
+
+int xipd_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+		int err = errno;
+		close(sock);
+		errno = err;
+		return -1;
+	}
+	return sock;
+}
+
+static int send_request(int sock, const char *buf, size_t len, int fds[3])
+{
+	union {
+		char		buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr	align;
+	} control;
+	struct iovec iov = { .iov_base = (void *)buf, .iov_len = len };
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ssize_t n;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+	do
+		n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return -1;
+	if ((size_t)n != len) {
+		errno = EMSGSIZE;
+		return -1;
+	}
+	return 0;
+}
+
+/* Errors are reported at best. */
+static void write_all(int fd, const char *buf, size_t len)
+{
+	while (len) {
+		ssize_t w = write(fd, buf, len);
+		if (w <= 0) {
+			if (w < 0 && errno == EINTR)
+				continue;
+			return;
+		}
+		buf += w;
+		len -= w;
+	}
+}
+
+int xipd_run(int sock, const struct xipd_opts *opts, int argc, char **argv,
+	int out_fd, int err_fd)
+{
+	struct xipd_request *req;
+	struct xipd_reply *reply;
+	char buf[XIPD_MAX_REQ];
+	size_t len = sizeof(*req);
+	int fds[3], i, rc;
+	ssize_t n;
+
+	if (argc < 0 || argc > XIPD_MAX_ARGS) {
+		errno = E2BIG;
+		return -1;
+	}
+	req = (struct xipd_request *)buf;
+	memset(req, 0, sizeof(*req));
+	req->magic = XIPD_MAGIC;
+	req->version = XIPD_VERSION;
+	req->argc = argc;
+	req->opts = *opts;
+	for (i = 0; i < argc; i++) {
+		size_t arg_len = strlen(argv[i]) + 1;
+
+		if (arg_len > sizeof(buf) - len) {
+			errno = E2BIG;
+			return -1;
+		}
+		memcpy(buf + len, argv[i], arg_len);
+		len += arg_len;
+	}
+
+	fds[0] = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fds[0] < 0)
+		return -1;
+	fds[1] = out_fd;
+	fds[2] = err_fd;
+	rc = send_request(sock, buf, len, fds);
+	close(fds[0]);
+	if (rc)
+		return -1;
+
+	/* The request is no longer needed; @buf takes the reply. */
+	do
+		n = recv(sock, buf, sizeof(*reply) + XIPD_MAX_ERRS, 0);
+	while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return -1;
+	reply = (struct xipd_reply *)buf;
+	if ((size_t)n < sizeof(*reply) || reply->magic != XIPD_MAGIC ||
+		reply->errs_len != n - sizeof(*reply)) {
+		/* The daemon went away, or is not xipd. */
+		errno = EPROTO;
+		return -1;
+	}
+	write_all(err_fd, buf + sizeof(*reply), reply->errs_len);
+	if (reply->errs_lost) {
+		char msg[64];
+		int len = snprintf(msg, sizeof(msg),
+			"%u more errors were not reported\n",
+			reply->errs_lost);
+		write_all(err_fd, msg, len);
+	}
+	return reply->status;
+}
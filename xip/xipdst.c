@@ -82,44 +82,43 @@ static int print_cache(const struct sockaddr_nl *who, struct nlmsghdr *n,
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
 
-	/* Print edges (key). */
-	fprintf(fp, "%sto\n", n->nlmsg_type == RTM_DELROUTE ? "Deleted " : "");
-	for (i = 0; i < XIA_OUTDEGREE_MAX; i++) {
-		fprintf(fp, "%i: ", i);
-		/* XXX It got to use @fp! */
-		print_xia_xid(dst);
-		fprintf(fp, "\n");
-		dst++;
-	}
-
-	/* Print information about DST entry. */
 	if (!tb[RTA_PROTOINFO] || RTA_PAYLOAD(tb[RTA_PROTOINFO]) !=
 		sizeof(struct xip_dst_cachinfo))
 		return -1;
 	ci = (const struct xip_dst_cachinfo *)RTA_DATA(tb[RTA_PROTOINFO]);
-	fprintf(fp, "%s, key_hash=0x%x, chosen_edge=%s\n",
-		ci->input ? "input" : "output", ci->key_hash,
-		chosen_edge_to_str(ci->chosen_edge));
-	fprintf(fp, "passthrough/sink_action=%s/%s\n",
-		action_to_str(ci->passthrough_action),
-		action_to_str(ci->sink_action));
 
 	assert(!r->rtm_src_len);
 	assert(r->rtm_flags & RTM_F_CLONED);
 
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	/* Print edges (key). */
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_text("to\n");
+	out_list_begin("edges");
+	for (i = 0; i < XIA_OUTDEGREE_MAX; i++) {
+		char label[16];
+
+		snprintf(label, sizeof(label), "%i: ", i);
+		out_item_begin();
+		out_xid(label, "xid", dst);
+		out_item_end();
+		out_text("\n");
+		dst++;
+	}
+	out_list_end();
+
+	/* Print information about DST entry. */
+	out_str("", "direction", ci->input ? "input" : "output");
+	out_hex(", key_hash=0x", "key_hash", ci->key_hash);
+	out_str(", chosen_edge=", "chosen_edge",
+		chosen_edge_to_str(ci->chosen_edge));
+	out_text("\n");
+	out_str("passthrough/sink_action=", "passthrough_action",
+		action_to_str(ci->passthrough_action));
+	out_str("/", "sink_action", action_to_str(ci->sink_action));
+	out_text("\n");
+
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -155,10 +154,11 @@ static int do_show(int argc, char **argv)
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_cache, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_cache, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 
 	return 0;
 }
@@ -190,7 +190,7 @@ static int do_flush(int argc, char **argv)
 	req.r.rtm_scope = RT_SCOPE_HOST;
 	req.r.rtm_dst_len = 0;
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
+	if (xip_talk(&req.n) < 0)
 		exit(2);
 	return 0;
 }
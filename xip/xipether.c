@@ -73,7 +73,7 @@ static int modify_local(const struct xia_xid *dst, int to_add)
 	req.r.rtm_dst_len = sizeof(*dst);
 	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
+	if (xip_talk(&req.n) < 0)
 		exit(2);
 	return 0;
 }
@@ -154,7 +154,7 @@ static int modify_neigh(struct xia_xid *dst, int to_add)
 	req.r.rtm_dst_len = sizeof(*dst);
 	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
+	if (xip_talk(&req.n) < 0)
 		exit(2);
 	return 0;
 }
@@ -211,15 +211,10 @@ static int do_delneigh(int argc, char **argv)
 	return do_Xneigh_common(argc, argv, 0);
 }
 
-static struct
-{
-	xid_type_t	xid_type;
-} filter;
-
 static inline void reset_filter(void)
 {
-	memset(&filter, 0, sizeof(filter));
-	assert(!ppal_name_to_type("ether", &filter.xid_type));
+	memset(&xrt_filter, 0, sizeof(xrt_filter));
+	assert(!ppal_name_to_type("ether", &xrt_filter.xid_type));
 }
 
 static int print_interface(const struct sockaddr_nl *who, struct nlmsghdr *n,
@@ -265,32 +260,18 @@ static int print_interface(const struct sockaddr_nl *who, struct nlmsghdr *n,
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -340,51 +321,35 @@ static int print_neigh(const struct sockaddr_nl *who, struct nlmsghdr *n,
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
 	assert(!r->rtm_src_len);
 	/* XXX It should go to be printed out in flags. */
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	/* XXX This should become a function, and removed mixed flags, that is,
-	 * it doesn't make sense to have RTNH_F_* and RTM_F_* together.
-	 */
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
-static int showinfo(rtnl_filter_t filter)
+static int showinfo(__u32 tbl_id, rtnl_filter_t print)
 {
 	reset_filter();
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, filter, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 
 	return 0;
 }
@@ -400,9 +365,9 @@ static int do_show(int argc, char **argv)
 
 	name = argv[0];
 	if (!matches(name, "interfaces")) {
-		return showinfo(print_interface);
+		return showinfo(XRTABLE_LOCAL_INDEX, print_interface);
 	} else if (!matches(name, "neighs")) {
-		return showinfo(print_neigh);
+		return showinfo(XRTABLE_MAIN_INDEX, print_neigh);
 	} else {
 		fprintf(stderr, "Unknown routing table '%s', \
 			it must be either 'interfaces', or 'neighs'\n", name);
@@ -418,6 +383,14 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer ether_printers[] = {
+	{ "ether", XRTABLE_LOCAL_INDEX, "ether interfaces", xrt_set_filter,
+		print_interface },
+	{ "ether", XRTABLE_MAIN_INDEX, "ether neighs", xrt_set_filter,
+		print_neigh },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "addif",    do_addlocal },
 	{ "delif",    do_dellocal },
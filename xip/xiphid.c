@@ -39,6 +39,7 @@ static int usage(void)
 "       xip hid showaddrs\n"
 "       xip hid { addneigh | delneigh } ID lladdr LLADDR dev DEV\n"
 "       xip hid showneighs\n"
+"       xip hid get ID [ table { local | main } ]\n"
 "where	ID := HEXDIGIT{20}\n"
 "	LLADDR := HEXDIGIT{1,2} (':' HEXDIGIT{1,2})*\n"
 "	DEV := STRING NUMBER\n");
@@ -260,7 +261,7 @@ static int modify_addr(struct xia_xid *dst, int to_add)
 	req.r.rtm_dst_len = sizeof(*dst);
 	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
+	if (xip_talk(&req.n) < 0)
 		exit(2);
 	return 0;
 }
@@ -298,15 +299,10 @@ static int do_deladdr(int argc, char **argv)
 	return do_Xaddr_common(argc, argv, 0);
 }
 
-static struct
-{
-	xid_type_t	xid_type;
-} filter;
-
 static inline void reset_filter(void)
 {
-	memset(&filter, 0, sizeof(filter));
-	assert(!ppal_name_to_type("hid", &filter.xid_type));
+	memset(&xrt_filter, 0, sizeof(xrt_filter));
+	assert(!ppal_name_to_type("hid", &xrt_filter.xid_type));
 }
 
 /* XXX This function should be componentized in a library, little variances
@@ -355,32 +351,18 @@ static int print_addr(const struct sockaddr_nl *who, struct nlmsghdr *n,
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -391,14 +373,15 @@ static int showaddrs(void)
 {
 	reset_filter();
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(XRTABLE_LOCAL_INDEX, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_addr, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_addr, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 
 	return 0;
 }
@@ -447,7 +430,7 @@ static int modify_neigh(struct xia_xid *dst, unsigned char *lladdr,
 	addattr_l(&req.n, sizeof(req), RTA_LLADDR, lladdr, lladdr_len);
 	addattr32(&req.n, sizeof(req), RTA_OIF, oif);
 
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
+	if (xip_talk(&req.n) < 0)
 		exit(2);
 	return 0;
 }
@@ -546,16 +529,14 @@ static int print_neigh(const struct sockaddr_nl *who, struct nlmsghdr *n,
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
+	out_list_begin("neighs");
 	if (tb[RTA_MULTIPATH]) {
 		struct rtnl_xia_hid_hdw_addrs *rtha =
 			RTA_DATA(tb[RTA_MULTIPATH]);
@@ -568,34 +549,25 @@ static int print_neigh(const struct sockaddr_nl *who, struct nlmsghdr *n,
 
 			assert(!lladdr_ntop(rtha->hha_ha, rtha->hha_addr_len,
 				ha, sizeof(ha)));
-			fprintf(fp, "lladdr: %s\tdev: %s\n", ha,
+			out_item_begin();
+			out_str("lladdr: ", "lladdr", ha);
+			out_str("\tdev: ", "dev",
 				ll_index_to_name(rtha->hha_ifindex));
+			out_item_end();
+			out_text("\n");
 
 			len -= NLMSG_ALIGN(rtha->hha_len);
 			rtha = RTHA_NEXT(rtha);
 		}
 	}
+	out_list_end();
 
 	assert(!r->rtm_src_len);
 	/* XXX It should go to be printed out in flags. */
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	/* XXX This should become a function, and removed mixed flags, that is,
-	 * it doesn't make sense to have RTNH_F_* and RTM_F_* together.
-	 */
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -606,14 +578,15 @@ static int showneighs(void)
 {
 	reset_filter();
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(XRTABLE_MAIN_INDEX, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_neigh, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_neigh, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 
 	return 0;
 }
@@ -628,6 +601,19 @@ static int do_showneighs(int argc, char **argv)
 	return showneighs();
 }
 
+static int do_get(int argc, char **argv)
+{
+	struct xia_xid dst;
+
+	if (argc != 1 && argc != 3) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+	xrt_get_ppal_id("hid", usage, &dst, argv[0]);
+	return xrt_get(hid_printers, usage, &dst, XRTABLE_MAIN_INDEX,
+		argc - 1, argv + 1);
+}
+
 static int do_help(int argc, char **argv)
 {
 	UNUSED(argc);
@@ -636,6 +622,12 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer hid_printers[] = {
+	{ "hid", XRTABLE_LOCAL_INDEX, "hid addrs", xrt_set_filter, print_addr },
+	{ "hid", XRTABLE_MAIN_INDEX, "hid neighs", xrt_set_filter, print_neigh },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "new",	do_newhid	},
 	{ "getpub",	do_getpub	},
@@ -652,5 +644,10 @@ static const struct cmd cmds[] = {
 int do_hid(int argc, char **argv)
 {
 	assert(!ll_init_map(&rth));
+	/* Abbreviations of getpub keep their meaning, so only the whole
+	 * word looks entries up.
+	 */
+	if (argc > 0 && !strcmp(argv[0], "get"))
+		return do_get(argc - 1, argv + 1);
 	return do_cmd(cmds, "Command", "xip hid help", argc, argv);
 }
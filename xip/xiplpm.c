@@ -20,6 +20,7 @@ static int usage(void)
 "Usage:	xip lpm { addlocal | dellocal } ID PREFIX_LEN\n"
 "	xip lpm addroute ID PREFIX_LEN gw XID\n"
 "	xip lpm delroute ID PREFIX_LEN\n"
+"	xip lpm get ID [ table { local | main } ]\n"
 "	xip lpm show { locals | routes }\n"
 "where	ID := '0x' HEXDIGIT{20} | IPV4ADDR\n"
 "	IPV4ADDR := 0-255 \".\" 0-255 \".\" 0-255 \".\" 0-255\n"
@@ -110,39 +111,7 @@ static int convert_id_to_hex(char *id, char *hexbuf)
 
 static int modify_local(const struct xia_xid *dst, __u8 prefix_len, int to_add)
 {
-	struct {
-		struct nlmsghdr 	n;
-		struct rtmsg 		r;
-		char   			buf[1024];
-	} req;
-
-	memset(&req, 0, sizeof(req));
-
-	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
-
-	if (to_add) {
-		/* XXX Does one really needs all these flags? */
-		req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
-		req.n.nlmsg_type = RTM_NEWROUTE;
-	} else {
-		req.n.nlmsg_flags = NLM_F_REQUEST;
-		req.n.nlmsg_type = RTM_DELROUTE;
-	}
-
-	req.r.rtm_family = AF_XIA;
-	req.r.rtm_table = XRTABLE_LOCAL_INDEX;
-	req.r.rtm_protocol = RTPROT_BOOT;
-	req.r.rtm_type = RTN_LOCAL;
-	req.r.rtm_scope = RT_SCOPE_HOST;
-
-	req.r.rtm_dst_len = sizeof(*dst);
-	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
-	addattr_l(&req.n, sizeof(req), RTA_PROTOINFO, &prefix_len,
-		sizeof(prefix_len));
-
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
-		exit(2);
-	return 0;
+	return xrt_modify_local(dst, &prefix_len, sizeof(prefix_len), to_add);
 }
 
 static int do_local(int argc, char **argv, int to_add)
@@ -180,44 +149,18 @@ static int do_dellocal(int argc, char **argv)
 static int modify_route(const struct xia_xid *dst, __u8 prefix_len,
 			const struct xia_xid *gw)
 {
-	int to_add = !!gw;
-	struct {
-		struct nlmsghdr 	n;
-		struct rtmsg 		r;
-		char   			buf[1024];
-	} req;
-
-	memset(&req, 0, sizeof(req));
-
-	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
-
-	if (to_add) {
-		/* XXX Does one really needs all these flags? */
-		req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
-		req.n.nlmsg_type = RTM_NEWROUTE;
-		req.r.rtm_scope = RT_SCOPE_LINK;
-	} else {
-		req.n.nlmsg_flags = NLM_F_REQUEST;
-		req.n.nlmsg_type = RTM_DELROUTE;
-		req.r.rtm_scope = RT_SCOPE_NOWHERE;
+	struct xiaconf_route rt;
+
+	memset(&rt, 0, sizeof(rt));
+	rt.tbl_id = XRTABLE_MAIN_INDEX;
+	rt.dst = *dst;
+	rt.protoinfo[0] = prefix_len;
+	rt.protoinfo_len = sizeof(prefix_len);
+	if (gw) {
+		rt.gw = *gw;
+		rt.has_gw = 1;
 	}
-
-	req.r.rtm_family = AF_XIA;
-	req.r.rtm_table = XRTABLE_MAIN_INDEX;
-	req.r.rtm_protocol = RTPROT_BOOT;
-	req.r.rtm_type = RTN_UNICAST;
-
-	req.r.rtm_dst_len = sizeof(*dst);
-	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
-	addattr_l(&req.n, sizeof(req), RTA_PROTOINFO, (__u8 *)&prefix_len,
-		sizeof((__u8)prefix_len));
-
-	if (to_add)
-		addattr_l(&req.n, sizeof(req), RTA_GATEWAY, gw, sizeof(*gw));
-
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
-		exit(2);
-	return 0;
+	return xrt_modify(gw ? XIACONF_ADD : XIACONF_DEL, &rt);
 }
 
 static int do_addroute(int argc, char **argv)
@@ -271,16 +214,28 @@ static int do_delroute(int argc, char **argv)
 	return modify_route(&dst, prefix_len, NULL);
 }
 
-static struct
+/* The kernel answers with the entry whose prefix covers ID. */
+static int do_get(int argc, char **argv)
 {
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
+	char id_in_hex[XIA_MAX_STRID_SIZE];
+	struct xia_xid dst;
+
+	if (argc != 1 && argc != 3) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+	if (convert_id_to_hex(argv[0], id_in_hex) < 0)
+		return usage();
+
+	xrt_get_ppal_id("lpm", usage, &dst, id_in_hex);
+	return xrt_get(lpm_printers, usage, &dst, XRTABLE_MAIN_INDEX,
+		argc - 1, argv + 1);
+}
 
 static inline void reset_filter(void)
 {
-	memset(&filter, 0, sizeof(filter));
-	assert(!ppal_name_to_type("lpm", &filter.xid_type));
+	memset(&xrt_filter, 0, sizeof(xrt_filter));
+	assert(!ppal_name_to_type("lpm", &xrt_filter.xid_type));
 }
 
 /* Based on iproute2/ip/iproute.c:print_route. */
@@ -320,47 +275,31 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "/%d", *(__u8 *)RTA_DATA(tb[RTA_PROTOINFO]));
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_uint("/", "prefix_len", *(__u8 *)RTA_DATA(tb[RTA_PROTOINFO]));
+	out_text("\n");
 
-	if (tb[RTA_GATEWAY]) {
-		printf("gw ");
+	if (tb[RTA_GATEWAY])
 		assert(RTA_PAYLOAD(tb[RTA_GATEWAY]) == sizeof(struct xia_xid));
-		print_xia_xid((const struct xia_xid *)
-			RTA_DATA(tb[RTA_GATEWAY]));
-	}
+	out_xid("gw ", "gw", tb[RTA_GATEWAY] ?
+		(const struct xia_xid *)RTA_DATA(tb[RTA_GATEWAY]) : NULL);
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, " flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags(" flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -368,16 +307,17 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 static int dump(int tbl_id)
 {
 	reset_filter();
-	filter.tb = tbl_id;
+	xrt_filter.tb = tbl_id;
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_route, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_route, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
@@ -410,11 +350,20 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer lpm_printers[] = {
+	{ "lpm", XRTABLE_LOCAL_INDEX, "lpm locals", xrt_set_filter,
+		print_route },
+	{ "lpm", XRTABLE_MAIN_INDEX, "lpm routes", xrt_set_filter,
+		print_route },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "addlocal",	do_addlocal	},
 	{ "dellocal",	do_dellocal	},
 	{ "addroute",	do_addroute	},
 	{ "delroute",	do_delroute	},
+	{ "get",	do_get		},
 	{ "show",	do_show		},
 	{ "help",	do_help		},
 	{ 0,		0		}
@@ -0,0 +1,483 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <net/xia_fib.h>
+#include <net/xia_dag.h>
+#include <xia_socket.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+
+/* xip save writes the routes of all principals into a snapshot, and
+ * xip restore adds them back.
+ *
+ * A snapshot holds the messages of a dump as the kernel sent them,
+ * grouped in sections by table and principal type:
+ *
+ *	struct save_header
+ *	struct save_section	[header.nr_sections]
+ *	messages of the sections, back to back
+ *
+ * Sections of the local table come first, so that restoring adds locals
+ * before the routes that may need them. Snapshots are in host byte
+ * order, as the messages themselves are; they are not meant to move
+ * between machines of different endianness.
+ */
+
+static int usage(void)
+{
+	fprintf(stderr,
+"Usage:	xip save FILE\n"
+"	xip restore [ -show ] FILE\n");
+	return -1;
+}
+
+#define SAVE_MAGIC	"XIPS"
+#define SAVE_VERSION	1
+
+struct save_header {
+	char		magic[4];
+	__u32		version;
+	__u32		nr_sections;
+	__u32		nr_msgs;
+};
+
+struct save_section {
+	__u32		tbl_id;
+	xid_type_t	ty;
+	__u32		count;		/* Messages of the section.	*/
+	__u32		reserved;
+	__u64		offset;		/* From the start of the file.	*/
+	__u64		len;		/* Bytes of the messages.	*/
+};
+
+/*
+ *	Save
+ */
+
+/* Sections being collected; there are only a few principals, so they
+ * are looked up linearly.
+ */
+struct collect {
+	struct save_section	sec;
+	char			*msgs;
+	size_t			size;
+};
+
+static struct {
+	struct collect		*secs;
+	int			nr;
+	int			size;
+	struct collect		*last;
+	__u32			nr_msgs;
+} saved;
+
+static struct collect *get_section(__u32 tbl_id, xid_type_t ty)
+{
+	struct collect *c;
+	int i;
+
+	if (saved.last && saved.last->sec.tbl_id == tbl_id &&
+		saved.last->sec.ty == ty)
+		return saved.last;
+	for (i = 0; i < saved.nr; i++) {
+		c = &saved.secs[i];
+		if (c->sec.tbl_id == tbl_id && c->sec.ty == ty)
+			return saved.last = c;
+	}
+
+	if (saved.nr >= saved.size) {
+		int size = saved.size ? saved.size * 2 : 16;
+		c = realloc(saved.secs, size * sizeof(*c));
+		if (!c)
+			return NULL;
+		saved.secs = c;
+		saved.size = size;
+	}
+	c = &saved.secs[saved.nr++];
+	memset(c, 0, sizeof(*c));
+	c->sec.tbl_id = tbl_id;
+	c->sec.ty = ty;
+	return saved.last = c;
+}
+
+static int collect_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
+	void *arg)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+	struct rtattr *tb[RTA_MAX+1];
+	const struct xia_xid *dst;
+	struct collect *c;
+	size_t msg_len = NLMSG_ALIGN(n->nlmsg_len);
+	__u32 table;
+
+	UNUSED(who);
+	UNUSED(arg);
+
+	if (n->nlmsg_type != RTM_NEWROUTE || len < 0 ||
+		r->rtm_family != AF_XIA)
+		return 0;
+
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), len);
+	table = rtnl_get_table(r, tb);
+	if (table >= XRTABLE_MAX_INDEX || !tb[RTA_DST] ||
+		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid))
+		return 0;
+	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
+
+	c = get_section(table, dst->xid_type);
+	if (!c)
+		goto nomem;
+	if (c->sec.len + msg_len > c->size) {
+		size_t size = c->size ? c->size : 64 * 1024;
+		char *msgs;
+
+		while (size < c->sec.len + msg_len)
+			size *= 2;
+		msgs = realloc(c->msgs, size);
+		if (!msgs)
+			goto nomem;
+		c->msgs = msgs;
+		c->size = size;
+	}
+	memcpy(c->msgs + c->sec.len, n, n->nlmsg_len);
+	memset(c->msgs + c->sec.len + n->nlmsg_len, 0,
+		msg_len - n->nlmsg_len);
+	c->sec.len += msg_len;
+	c->sec.count++;
+	saved.nr_msgs++;
+	return 0;
+
+nomem:
+	fprintf(stderr, "Cannot allocate memory for the snapshot\n");
+	return -1;
+}
+
+static int write_snapshot(FILE *f)
+{
+	struct save_header hdr;
+	__u64 offset;
+	__u32 tbl;
+	int i;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, SAVE_MAGIC, sizeof(hdr.magic));
+	hdr.version = SAVE_VERSION;
+	hdr.nr_sections = saved.nr;
+	hdr.nr_msgs = saved.nr_msgs;
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+		return -1;
+
+	/* Sections go in the order of their tables, and in the order of
+	 * the dump within a table.
+	 */
+	offset = sizeof(hdr) + saved.nr * sizeof(struct save_section);
+	for (tbl = 0; tbl < XRTABLE_MAX_INDEX; tbl++) {
+		for (i = 0; i < saved.nr; i++) {
+			struct save_section *sec = &saved.secs[i].sec;
+
+			if (sec->tbl_id != tbl)
+				continue;
+			sec->offset = offset;
+			offset += sec->len;
+			if (fwrite(sec, sizeof(*sec), 1, f) != 1)
+				return -1;
+		}
+	}
+	for (tbl = 0; tbl < XRTABLE_MAX_INDEX; tbl++) {
+		for (i = 0; i < saved.nr; i++) {
+			const struct collect *c = &saved.secs[i];
+
+			if (c->sec.tbl_id != tbl || !c->sec.len)
+				continue;
+			if (fwrite(c->msgs, c->sec.len, 1, f) != 1)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+int do_save(int argc, char **argv)
+{
+	const char *file;
+	FILE *f;
+	int i, ret;
+
+	if (argc != 1) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+	file = argv[0];
+
+	memset(&saved, 0, sizeof(saved));
+	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+		perror("Cannot send dump request");
+		exit(1);
+	}
+	if (rtnl_dump_filter(&rth, collect_route, NULL, NULL, NULL) < 0) {
+		fprintf(stderr, "Dump terminated\n");
+		exit(1);
+	}
+
+	f = fopen(file, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot open file '%s': %s\n", file,
+			strerror(errno));
+		exit(1);
+	}
+	ret = write_snapshot(f);
+	if (fclose(f))
+		ret = -1;
+	if (ret) {
+		fprintf(stderr, "Cannot write file '%s': %s\n", file,
+			strerror(errno));
+		unlink(file);
+	} else if (show_details) {
+		printf("%u routes saved in %d sections\n", saved.nr_msgs,
+			saved.nr);
+	}
+
+	for (i = 0; i < saved.nr; i++)
+		free(saved.secs[i].msgs);
+	free(saved.secs);
+	return ret ? 1 : 0;
+}
+
+/*
+ *	Restore
+ */
+
+static struct {
+	const char		*file;
+	char			*buf;
+	size_t			len;
+	const struct save_section *secs;
+	__u32			nr_sections;
+	/* Messages of all sections in order, so tags can index them. */
+	struct nlmsghdr		**msgs;
+	__u32			nr_msgs;
+} snap;
+
+/* Read and check the whole snapshot; RETURN zero on success. */
+static int load_snapshot(void)
+{
+	const struct save_header *hdr;
+	struct stat st;
+	FILE *f;
+	__u32 i, k = 0;
+
+	f = fopen(snap.file, "r");
+	if (!f) {
+		fprintf(stderr, "Cannot open file '%s': %s\n", snap.file,
+			strerror(errno));
+		return -1;
+	}
+	if (fstat(fileno(f), &st)) {
+		fprintf(stderr, "Cannot stat file '%s': %s\n", snap.file,
+			strerror(errno));
+		fclose(f);
+		return -1;
+	}
+	snap.len = st.st_size;
+	snap.buf = malloc(snap.len ? snap.len : 1);
+	if (!snap.buf) {
+		fprintf(stderr, "Cannot allocate memory for the snapshot\n");
+		fclose(f);
+		return -1;
+	}
+	if (fread(snap.buf, 1, snap.len, f) != snap.len) {
+		fprintf(stderr, "Cannot read file '%s'\n", snap.file);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	hdr = (const struct save_header *)snap.buf;
+	if (snap.len < sizeof(*hdr) ||
+		memcmp(hdr->magic, SAVE_MAGIC, sizeof(hdr->magic))) {
+		fprintf(stderr, "'%s' is not a snapshot of xip save\n",
+			snap.file);
+		return -1;
+	}
+	if (hdr->version != SAVE_VERSION) {
+		fprintf(stderr, "Snapshot '%s' has unknown version %u\n",
+			snap.file, hdr->version);
+		return -1;
+	}
+	if (hdr->nr_sections > (snap.len - sizeof(*hdr)) /
+		sizeof(struct save_section))
+		goto malformed;
+	snap.secs = (const struct save_section *)(hdr + 1);
+	snap.nr_sections = hdr->nr_sections;
+
+	/* Every message takes at least a header, so @nr_msgs is bounded
+	 * before it is allocated.
+	 */
+	if (hdr->nr_msgs > snap.len / NLMSG_HDRLEN)
+		goto malformed;
+	snap.msgs = malloc((hdr->nr_msgs + 1) * sizeof(*snap.msgs));
+	if (!snap.msgs) {
+		fprintf(stderr, "Cannot allocate memory for the snapshot\n");
+		return -1;
+	}
+	snap.nr_msgs = hdr->nr_msgs;
+
+	for (i = 0; i < snap.nr_sections; i++) {
+		const struct save_section *sec = &snap.secs[i];
+		__u64 off = sec->offset, end = sec->offset + sec->len;
+		__u32 j;
+
+		if (sec->tbl_id >= XRTABLE_MAX_INDEX || end < off ||
+			end > snap.len || off % NLMSG_ALIGNTO)
+			goto malformed;
+		for (j = 0; j < sec->count; j++) {
+			struct nlmsghdr *n = (struct nlmsghdr *)
+				(snap.buf + off);
+
+			if (end - off < NLMSG_LENGTH(sizeof(struct rtmsg)) ||
+				n->nlmsg_len < NLMSG_LENGTH(
+					sizeof(struct rtmsg)) ||
+				n->nlmsg_len > end - off ||
+				NLMSG_ALIGN(n->nlmsg_len) > end - off ||
+				k >= snap.nr_msgs)
+				goto malformed;
+			snap.msgs[k++] = n;
+			off += NLMSG_ALIGN(n->nlmsg_len);
+		}
+		if (off != end)
+			goto malformed;
+	}
+	if (k != snap.nr_msgs)
+		goto malformed;
+	return 0;
+
+malformed:
+	fprintf(stderr, "Snapshot '%s' is malformed\n", snap.file);
+	return -1;
+}
+
+static const struct xia_xid *msg_dst(struct nlmsghdr *n)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct rtattr *tb[RTA_MAX+1];
+
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r),
+		n->nlmsg_len - NLMSG_LENGTH(sizeof(*r)));
+	if (!tb[RTA_DST] || RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid))
+		return NULL;
+	return (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
+}
+
+static void restore_error(int tag, int err, void *arg)
+{
+	const struct xia_xid *dst = msg_dst(snap.msgs[tag]);
+	char xid[XIA_MAX_STRXID_SIZE];
+
+	UNUSED(arg);
+
+	fprintf(stderr, "RTNETLINK answers: %s\n", strerror(-err));
+	if (!dst || xia_xidtop(dst, xid, sizeof(xid)) < 0)
+		strcpy(xid, "?");
+	fprintf(stderr, "Cannot restore %s of %s\n", xid, snap.file);
+}
+
+static int show_snapshot(void)
+{
+	struct sockaddr_nl who;
+	__u32 i;
+	int err = 0;
+
+	/* As rtnl_from_file() does, messages come from the kernel. */
+	memset(&who, 0, sizeof(who));
+	who.nl_family = AF_NETLINK;
+
+	show_begin();
+	for (i = 0; i < snap.nr_msgs && err >= 0; i++)
+		err = show_route(&who, snap.msgs[i], stdout);
+	show_end(stdout);
+	return err < 0;
+}
+
+static int restore_snapshot(void)
+{
+	struct rtnl_batch nlb;
+	int own_batch = !rth.batch;
+	__u32 i, k = 0, restored = 0, skipped = 0;
+	int ret = 0;
+
+	/* Inside a batch file, the batch of the file reports failures
+	 * with the line of the restore command.
+	 */
+	if (own_batch && xip_batch_begin(&nlb, restore_error, NULL) < 0)
+		return -1;
+
+	for (i = 0; i < snap.nr_sections && !ret; i++) {
+		const struct save_section *sec = &snap.secs[i];
+		__u32 j;
+
+		/* Locals must exist before the routes are added. */
+		if (i && sec->tbl_id != snap.secs[i - 1].tbl_id &&
+			rtnl_batch_flush(&rth) < 0) {
+			ret = -1;
+			break;
+		}
+
+		for (j = 0; j < sec->count; j++, k++) {
+			struct nlmsghdr *n = snap.msgs[k];
+			struct rtmsg *r = NLMSG_DATA(n);
+
+			/* The kernel adds its own routes again. */
+			if (r->rtm_protocol == RTPROT_KERNEL) {
+				skipped++;
+				continue;
+			}
+			n->nlmsg_type = RTM_NEWROUTE;
+			n->nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
+			n->nlmsg_pid = 0;
+			if (rtnl_batch_add(&rth, n, own_batch ? (int)k :
+				cmdlineno)) {
+				ret = -1;
+				break;
+			}
+			restored++;
+		}
+	}
+
+	if (own_batch && (rtnl_batch_end(&rth) || nlb.errors))
+		ret = -1;
+	if (show_details)
+		printf("%u routes restored, %u routes of the kernel "
+			"skipped\n", restored, skipped);
+	return ret;
+}
+
+int do_restore(int argc, char **argv)
+{
+	int show = 0;
+	int ret;
+
+	if (argc == 2 && !matches(argv[0], "-show")) {
+		show = 1;
+		argc--;
+		argv++;
+	}
+	if (argc != 1) {
+		fprintf(stderr, "Wrong parameters\n");
+		return usage();
+	}
+
+	memset(&snap, 0, sizeof(snap));
+	snap.file = argv[0];
+	if (load_snapshot())
+		exit(1);
+
+	ret = show ? show_snapshot() : restore_snapshot();
+
+	free(snap.msgs);
+	free(snap.buf);
+	return ret ? 1 : 0;
+}
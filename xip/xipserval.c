@@ -38,30 +38,20 @@ static xid_type_t serval_type(const char *name)
 	return ty;
 }
 
-static struct {
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
-
-static inline void reset_filter(__u32 tb_id, xid_type_t ty)
-{
-	filter.tb = tb_id;
-	filter.xid_type = ty;
-}
-
 /* Based on iproute2/ip/iproute.c:iproute_list_flush_or_save. */
 static int dump(__u32 tbl_id, xid_type_t ty, rtnl_filter_t print)
 {
-	reset_filter(tbl_id, ty);
+	xrt_set_filter(tbl_id, ty);
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, ty) < 0) {
 		perror("Serval: Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print, stdout) < 0) {
 		fprintf(stderr, "Serval: Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
@@ -92,6 +82,8 @@ static int print_socket(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	int len = n->nlmsg_len;
 	struct rtattr *tb[RTA_MAX+1];
 	const struct xia_xid *dst;
+	const struct xia_addr *peer = NULL;
+	const struct xia_xid *peer_request = NULL;
 	__u32 table;
 
 	UNUSED(who);
@@ -120,67 +112,52 @@ static int print_socket(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "local ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("local ", "local", dst);
+	out_text("\n");
 
 	if (tb[RTA_SRC]) {
-		printf("peer ");
-
 		switch (RTA_PAYLOAD(tb[RTA_SRC])) {
 		case sizeof(struct xia_addr):
-			/* XXX It got to use @fp! */
-			print_xia_addr((const struct xia_addr *)
-				RTA_DATA(tb[RTA_SRC]));
+			peer = (const struct xia_addr *)RTA_DATA(tb[RTA_SRC]);
 			break;
 
 		case sizeof(struct xia_xid):
-			fprintf(fp, "(still a request sock) ");
-			/* XXX It got to use @fp! */
-			print_xia_xid((const struct xia_xid *)
-				RTA_DATA(tb[RTA_SRC]));
-			fprintf(fp, "\n");
+			peer_request = (const struct xia_xid *)
+				RTA_DATA(tb[RTA_SRC]);
 			break;
 
 		default:
-			fprintf(fp, "Unknown object\n");
+			out_text("peer Unknown object\n");
 			break;
 		}
 	}
-
+	out_addr("peer ", "peer", peer);
+	out_xid("peer (still a request sock) ", "peer_request",
+		peer_request);
+	if (peer_request)
+		out_text("\n");
+
+	out_str("socket state = ", "state", tb[RTA_PROTOINFO] ?
+		state_to_str(*((__u8 *)RTA_DATA(tb[RTA_PROTOINFO]))) : NULL);
 	if (tb[RTA_PROTOINFO])
-		fprintf(fp, "socket state = %s ",
-			state_to_str(*((__u8 *)RTA_DATA(tb[RTA_PROTOINFO]))));
+		out_text(" ");
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -242,6 +219,18 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer serval_printers[] = {
+	{ "serval", XRTABLE_LOCAL_INDEX, "serval sockets", xrt_set_filter,
+		print_socket },
+	{ "serval", XRTABLE_MAIN_INDEX, "serval routes", xrt_set_filter,
+		xrt_print_route },
+	{ "flowid", XRTABLE_LOCAL_INDEX, "flowid sockets", xrt_set_filter,
+		print_socket },
+	{ "flowid", XRTABLE_MAIN_INDEX, "flowid routes", xrt_set_filter,
+		xrt_print_route },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "showsockets",	do_showsockets	},
 	{ "addroute",		do_addroute	},
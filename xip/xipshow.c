@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include <string.h>
+#include <net/xia_fib.h>
+#include <net/xia_dag.h>
+#include <xia_socket.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+
+/* xip show prints the routes of all principals out of a single dump.
+ *
+ * Each route goes to the printer of its table and principal type; these
+ * printers are the same ones the show commands of each principal use,
+ * so their output does not change. A title precedes every run of routes
+ * of the same printer.
+ */
+
+static int usage(void)
+{
+	fprintf(stderr, "Usage: xip show [ all ]\n");
+	return -1;
+}
+
+static const struct xip_printer *const printer_sets[] = {
+	ad_printers,
+	ether_printers,
+	hid_printers,
+	lpm_printers,
+	serval_printers,
+	u4id_printers,
+	xdp_printers,
+	zf_printers,
+	NULL
+};
+
+/* Printers are indexed by table, and then by principal type in
+ * an open-addressing table with linear probing.
+ */
+#define PRINTER_SLOTS	64
+
+static struct {
+	xid_type_t			ty;
+	const struct xip_printer	*printer;
+} slots[XRTABLE_MAX_INDEX][PRINTER_SLOTS];
+
+static inline unsigned int type_slot(xid_type_t ty)
+{
+	return (__be32_to_cpu(ty) * 2654435761U) >> 26;
+}
+
+static const struct xip_printer *find_printer(__u32 tbl_id, xid_type_t ty)
+{
+	unsigned int i = type_slot(ty);
+
+	while (slots[tbl_id][i].printer) {
+		if (slots[tbl_id][i].ty == ty)
+			return slots[tbl_id][i].printer;
+		i = (i + 1) & (PRINTER_SLOTS - 1);
+	}
+	return NULL;
+}
+
+static void index_printers(void)
+{
+	const struct xip_printer *const *set;
+	const struct xip_printer *p;
+
+	for (set = printer_sets; *set; set++) {
+		for (p = *set; p->ppal; p++) {
+			xid_type_t ty;
+			unsigned int i;
+
+			/* Principals missing from the map have no routes. */
+			if (ppal_name_to_type(p->ppal, &ty))
+				continue;
+			if (find_printer(p->tbl_id, ty))
+				continue;
+			i = type_slot(ty);
+			while (slots[p->tbl_id][i].printer)
+				i = (i + 1) & (PRINTER_SLOTS - 1);
+			slots[p->tbl_id][i].ty = ty;
+			slots[p->tbl_id][i].printer = p;
+		}
+	}
+}
+
+static struct {
+	const struct xip_printer	*cur;
+	unsigned int			skipped;
+} state;
+
+void show_begin(void)
+{
+	index_printers();
+	memset(&state, 0, sizeof(state));
+}
+
+int show_route(const struct sockaddr_nl *who, struct nlmsghdr *n, void *arg)
+{
+	FILE *fp = (FILE*)arg;
+	struct rtmsg *r = NLMSG_DATA(n);
+	int len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+	struct rtattr *tb[RTA_MAX+1];
+	const struct xip_printer *p;
+	const struct xia_xid *dst;
+	__u32 table;
+
+	if ((n->nlmsg_type != RTM_NEWROUTE && n->nlmsg_type != RTM_DELROUTE)
+		|| len < 0 || r->rtm_family != AF_XIA)
+		return 0;
+
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), len);
+	table = rtnl_get_table(r, tb);
+	if (table >= XRTABLE_MAX_INDEX || !tb[RTA_DST] ||
+		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid)) {
+		state.skipped++;
+		return 0;
+	}
+	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
+
+	p = find_printer(table, dst->xid_type);
+	if (!p) {
+		state.skipped++;
+		return 0;
+	}
+	if (p != state.cur) {
+		p->prepare(table, dst->xid_type);
+		out_section(fp, p->title);
+		state.cur = p;
+	}
+	return p->print(who, n, arg);
+}
+
+void show_end(FILE *fp)
+{
+	out_section(fp, NULL);
+	out_flush();
+
+	if (state.skipped && show_details)
+		fprintf(stderr, "%u routes of unknown principals skipped\n",
+			state.skipped);
+}
+
+int do_show_all(int argc, char **argv)
+{
+	if (argc > 1 || (argc == 1 && matches(argv[0], "all"))) {
+		fprintf(stderr, "Wrong parameters\n");
+		return usage();
+	}
+
+	show_begin();
+	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+		perror("Cannot send dump request");
+		exit(1);
+	}
+	if (rtnl_dump_filter(&rth, show_route, stdout, NULL, NULL) < 0) {
+		fprintf(stderr, "Dump terminated\n");
+		exit(1);
+	}
+	show_end(stdout);
+	return 0;
+}
@@ -0,0 +1,476 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <net/xia_fib.h>
+#include <net/xia_dag.h>
+#include <xia_socket.h>
+#include <xiaconf.h>
+
+#include "xip_common.h"
+#include "utils.h"
+#include "libnetlink.h"
+
+/* xip sync makes the locals and routes of principals match a file.
+ *
+ * The file holds the same lines that add them in a batch file, such as:
+ *
+ *	ad addlocal ID
+ *	lpm addroute ID PREFIX_LEN gw XID
+ *
+ * Lines run as they would in a batch file, but the entries that their
+ * requests add are kept instead of being sent. Every principal that
+ * shows up in the file has the entries of the tables that its commands
+ * change replaced by those of the file; other principals and tables,
+ * such as the sockets of xdp, and the entries of the kernel are left
+ * alone. The desired entries are kept in a hash set, the current ones
+ * come from a single dump, and only the differences are sent, in a batch:
+ * entries missing from the file are deleted, new entries are added,
+ * routes whose gateway changed are replaced, and entries whose
+ * protocol-specific information changed are deleted and added again.
+ */
+
+static int usage(void)
+{
+	fprintf(stderr,
+"Usage:	xip sync FILE\n"
+"where	FILE holds lines of the form:\n"
+"	ad { addlocal ID | addroute ID gw XID }\n"
+"	lpm { addlocal ID PREFIX_LEN | addroute ID PREFIX_LEN gw XID }\n"
+"	serval addroute { service | flow } ID gw XID\n"
+"	u4id add UDP_ID [ -tunnel [ -disable_checksum ] ]\n"
+"	xdp addroute ID gw XID\n"
+"	zf { addlocal ID | addroute ID gw XID }\n"
+"	Entries of hid and ether cannot be synced.\n");
+	return -1;
+}
+
+/* Principals of the file; each command object has at most two. */
+#define MAX_PPALS	16
+
+struct entry {
+	struct xiaconf_route	rt;
+	__u8			found;		/* Present in the kernel. */
+	__u8			replace;	/* With another gateway. */
+	int			lineno;
+};
+
+struct op {
+	enum xiaconf_op		type;
+	struct xiaconf_route	rt;
+	int			lineno;
+};
+
+/* A principal of the file, and the tables that it syncs. */
+struct synced {
+	xid_type_t		type;
+	unsigned int		tables;	/* See xip_entry_tables(). */
+};
+
+static struct {
+	const char	*file;
+
+	struct synced	ppals[MAX_PPALS];
+	int		nppals;
+
+	/* Requests of the line being parsed; see capture(). */
+	struct xiaconf_route *line_rt;
+	int		line_adds;
+	int		line_others;
+
+	struct entry	*entries;
+	int		count;
+	int		size;
+
+	/* Open-addressing hash of @entries with linear probing;
+	 * slots hold an index plus one, zero marks empty slots.
+	 */
+	int		*slots;
+	unsigned int	mask;
+
+	/* Entries of the kernel to delete. */
+	struct op	*dels;
+	int		ndels;
+	int		dels_size;
+
+	struct op	*ops;		/* Ops of the batch, by tag.	*/
+} sync_state;
+
+static unsigned int entry_hash(__u32 tbl_id, const struct xia_xid *xid)
+{
+	__u32 words[sizeof(*xid) / sizeof(__u32)];
+	unsigned int h = tbl_id;
+	unsigned int i;
+
+	memcpy(words, xid, sizeof(words));
+	for (i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+		h = (h ^ words[i]) * 0x9e3779b1U;
+		h ^= h >> 15;
+	}
+	return h;
+}
+
+/* RETURN the entry of @xid in table @tbl_id, or NULL. */
+static struct entry *find_entry(__u32 tbl_id, const struct xia_xid *xid)
+{
+	unsigned int i = entry_hash(tbl_id, xid) & sync_state.mask;
+
+	while (sync_state.slots[i]) {
+		struct entry *e = &sync_state.entries[sync_state.slots[i] - 1];
+		if (e->rt.tbl_id == tbl_id &&
+			!memcmp(&e->rt.dst, xid, sizeof(*xid)))
+			return e;
+		i = (i + 1) & sync_state.mask;
+	}
+	return NULL;
+}
+
+static void *grow(void *array, int *size, size_t elem_size)
+{
+	int new_size = *size ? *size * 2 : 1024;
+
+	array = realloc(array, new_size * elem_size);
+	if (!array) {
+		fprintf(stderr, "Cannot allocate memory for sync\n");
+		exit(1);
+	}
+	*size = new_size;
+	return array;
+}
+
+static struct synced *find_synced(xid_type_t ty)
+{
+	int i;
+
+	for (i = 0; i < sync_state.nppals; i++)
+		if (sync_state.ppals[i].type == ty)
+			return &sync_state.ppals[i];
+	return NULL;
+}
+
+/* RETURN true if table @tbl_id of principal @ty is synced. */
+static int is_synced(xid_type_t ty, __u32 tbl_id)
+{
+	const struct synced *p = find_synced(ty);
+
+	return p && tbl_id < XRTABLE_MAX_INDEX && (p->tables & (1U << tbl_id));
+}
+
+/* Keep the entry that the request @n adds instead of sending it. */
+static int capture(struct nlmsghdr *n)
+{
+	if (n->nlmsg_type == RTM_NEWROUTE && (n->nlmsg_flags & NLM_F_CREATE) &&
+		!sync_state.line_adds &&
+		xiaconf_parse_route(n, sync_state.line_rt) == 1)
+		sync_state.line_adds++;
+	else
+		sync_state.line_others++;
+	return 0;
+}
+
+static int parse_line(int argc, char **argv)
+{
+	struct entry *e;
+	struct synced *p;
+	unsigned int tables;
+	int rc;
+
+	if (!xip_is_entry_cmd(argc, argv)) {
+		fprintf(stderr, "Command cannot be synced\n");
+		return -1;
+	}
+	tables = xip_entry_tables(argv[0]);
+
+	if (sync_state.count >= sync_state.size)
+		sync_state.entries = grow(sync_state.entries,
+			&sync_state.size, sizeof(*sync_state.entries));
+	e = &sync_state.entries[sync_state.count];
+	memset(e, 0, sizeof(*e));
+
+	sync_state.line_rt = &e->rt;
+	sync_state.line_adds = 0;
+	sync_state.line_others = 0;
+	xip_talk_hook = capture;
+	rc = xip_do_cmd(argc, argv);
+	xip_talk_hook = NULL;
+	if (rc)
+		return -1;
+	if (sync_state.line_adds != 1 || sync_state.line_others ||
+		e->rt.tbl_id >= XRTABLE_MAX_INDEX ||
+		!(tables & (1U << e->rt.tbl_id))) {
+		fprintf(stderr, "Command does not add an entry\n");
+		return -1;
+	}
+	e->lineno = cmdlineno;
+	sync_state.count++;
+
+	p = find_synced(e->rt.dst.xid_type);
+	if (!p) {
+		if (sync_state.nppals >= MAX_PPALS) {
+			fprintf(stderr, "Too many principals\n");
+			return -1;
+		}
+		p = &sync_state.ppals[sync_state.nppals++];
+		p->type = e->rt.dst.xid_type;
+		p->tables = 0;
+	}
+	p->tables |= tables;
+	return 0;
+}
+
+static int load_file(void)
+{
+	FILE *f = fopen(sync_state.file, "r");
+	struct cmdfile cf;
+	char *largv[100];
+	int largc, saved_lineno = cmdlineno;
+	int ret = 0;
+	unsigned int size, i;
+
+	if (!f) {
+		fprintf(stderr, "Cannot open file '%s': %s\n",
+			sync_state.file, strerror(errno));
+		return -1;
+	}
+	if (cmdfile_open(&cf, f)) {
+		fclose(f);
+		return -1;
+	}
+
+	cmdlineno = 0;
+	while ((largc = cmdfile_next(&cf, largv, 100)) != -1) {
+		if (largc == 0)
+			continue;	/* blank line */
+		if (parse_line(largc, largv)) {
+			fprintf(stderr, "Wrong line %s:%d\n",
+				sync_state.file, cmdlineno);
+			usage();
+			ret = -1;
+			break;
+		}
+	}
+	cmdfile_close(&cf);
+	fclose(f);
+	if (ret)
+		goto out;
+
+	/* Index the entries; the load factor stays below one half. */
+	for (size = 16; size < 2U * sync_state.count; size *= 2)
+		;
+	sync_state.slots = calloc(size, sizeof(*sync_state.slots));
+	if (!sync_state.slots) {
+		fprintf(stderr, "Cannot allocate memory for sync\n");
+		exit(1);
+	}
+	sync_state.mask = size - 1;
+	for (i = 0; i < (unsigned int)sync_state.count; i++) {
+		struct entry *e = &sync_state.entries[i];
+		unsigned int j;
+
+		if (find_entry(e->rt.tbl_id, &e->rt.dst)) {
+			char xid[XIA_MAX_STRXID_SIZE];
+			xia_xidtop(&e->rt.dst, xid, sizeof(xid));
+			fprintf(stderr, "%s is repeated at %s:%d\n",
+				xid, sync_state.file, e->lineno);
+			ret = -1;
+			goto out;
+		}
+		j = entry_hash(e->rt.tbl_id, &e->rt.dst) & sync_state.mask;
+		while (sync_state.slots[j])
+			j = (j + 1) & sync_state.mask;
+		sync_state.slots[j] = i + 1;
+	}
+
+out:
+	cmdlineno = saved_lineno;
+	return ret;
+}
+
+static void add_del(const struct xiaconf_route *rt)
+{
+	struct op *op;
+
+	if (sync_state.ndels >= sync_state.dels_size)
+		sync_state.dels = grow(sync_state.dels, &sync_state.dels_size,
+			sizeof(*sync_state.dels));
+	op = &sync_state.dels[sync_state.ndels++];
+	op->type = XIACONF_DEL;
+	/* Some principals need the protocol information of the entry
+	 * to find it.
+	 */
+	op->rt = *rt;
+	op->lineno = 0;
+}
+
+/* Compare a route of the kernel with the file. */
+static int compare_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
+	void *arg)
+{
+	struct xiaconf_route rt;
+	struct entry *e;
+
+	UNUSED(who);
+	UNUSED(arg);
+
+	if (xiaconf_parse_route(n, &rt) != 1 ||
+		!is_synced(rt.dst.xid_type, rt.tbl_id))
+		return 0;
+	/* The kernel adds its own routes, so they are never in the file;
+	 * see xip restore.
+	 */
+	if (rt.protocol == RTPROT_KERNEL)
+		return 0;
+
+	e = find_entry(rt.tbl_id, &rt.dst);
+	if (!e) {
+		add_del(&rt);
+		return 0;
+	}
+
+	/* Entries whose protocol information changed, such as the prefix
+	 * length of LPM entries, are deleted and added again. Entries of
+	 * the kernel without that information are left as they are.
+	 */
+	if (rt.protoinfo_len && (rt.protoinfo_len != e->rt.protoinfo_len ||
+		memcmp(rt.protoinfo, e->rt.protoinfo, rt.protoinfo_len))) {
+		add_del(&rt);
+		return 0;
+	}
+
+	e->found = 1;
+	if (rt.has_gw != e->rt.has_gw || (rt.has_gw &&
+		memcmp(&rt.gw, &e->rt.gw, sizeof(rt.gw))))
+		e->replace = 1;
+	return 0;
+}
+
+static int send_op(const struct op *op, int tag)
+{
+	union {
+		struct nlmsghdr	n;
+		char		buf[XIACONF_REQ_SIZE];
+	} req;
+
+	if (xiaconf_request(&req.n, sizeof(req), op->type, &op->rt))
+		return -1;
+	return rtnl_batch_add(&rth, &req.n, tag);
+}
+
+static void sync_error(int tag, int err, void *arg)
+{
+	const struct op *op = &sync_state.ops[tag];
+	char xid[XIA_MAX_STRXID_SIZE];
+
+	UNUSED(arg);
+
+	xia_xidtop(&op->rt.dst, xid, sizeof(xid));
+	fprintf(stderr, "RTNETLINK answers: %s\n", strerror(-err));
+	if (op->type == XIACONF_DEL)
+		fprintf(stderr, "Cannot delete %s\n", xid);
+	else
+		fprintf(stderr, "Cannot %s %s of %s:%d\n",
+			op->type == XIACONF_ADD ? "add" : "replace", xid,
+			sync_state.file, op->lineno);
+}
+
+static void add_op(int *nops, enum xiaconf_op type, const struct entry *e)
+{
+	struct op *op = &sync_state.ops[(*nops)++];
+
+	op->type = type;
+	op->rt = e->rt;
+	op->lineno = e->lineno;
+}
+
+/* Deletions go first so that an XID can move between tables; locals go
+ * before routes, as in batch files.
+ */
+static int apply(void)
+{
+	struct rtnl_batch nlb;
+	int own_batch = !rth.batch;
+	int nops = 0, adds = 0, replaces = 0;
+	int i, tbl, ret = 0;
+
+	sync_state.ops = malloc((sync_state.ndels + sync_state.count + 1) *
+		sizeof(*sync_state.ops));
+	if (!sync_state.ops) {
+		fprintf(stderr, "Cannot allocate memory for sync\n");
+		exit(1);
+	}
+	memcpy(sync_state.ops, sync_state.dels,
+		sync_state.ndels * sizeof(*sync_state.ops));
+	nops = sync_state.ndels;
+	for (tbl = XRTABLE_LOCAL_INDEX; ; tbl = XRTABLE_MAIN_INDEX) {
+		for (i = 0; i < sync_state.count; i++) {
+			const struct entry *e = &sync_state.entries[i];
+
+			if (e->rt.tbl_id != (__u32)tbl)
+				continue;
+			if (!e->found) {
+				add_op(&nops, XIACONF_ADD, e);
+				adds++;
+			} else if (e->replace) {
+				add_op(&nops, XIACONF_REPLACE, e);
+				replaces++;
+			}
+		}
+		if (tbl == XRTABLE_MAIN_INDEX)
+			break;
+	}
+
+	/* Inside a batch file, the batch of the file reports failures
+	 * with the line of the sync command.
+	 */
+	if (own_batch && xip_batch_begin(&nlb, sync_error, NULL) < 0)
+		return -1;
+	for (i = 0; i < nops; i++) {
+		if (send_op(&sync_state.ops[i], own_batch ? i : cmdlineno)) {
+			ret = -1;
+			break;
+		}
+	}
+	if (own_batch && (rtnl_batch_end(&rth) || nlb.errors))
+		ret = -1;
+
+	if (show_details)
+		printf("%d added, %d replaced, %d deleted, %d unchanged\n",
+			adds, replaces, sync_state.ndels,
+			sync_state.count - adds - replaces);
+	return ret;
+}
+
+int do_sync(int argc, char **argv)
+{
+	int ret;
+
+	if (argc != 1) {
+		fprintf(stderr, "Wrong number of parameters\n");
+		return usage();
+	}
+
+	memset(&sync_state, 0, sizeof(sync_state));
+	sync_state.file = argv[0];
+	if (load_file())
+		exit(1);
+
+	if (sync_state.nppals) {
+		if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+			perror("Cannot send dump request");
+			exit(1);
+		}
+		if (rtnl_dump_filter(&rth, compare_route, NULL, NULL,
+			NULL) < 0) {
+			fprintf(stderr, "Dump terminated\n");
+			exit(1);
+		}
+	}
+
+	ret = apply();
+
+	free(sync_state.entries);
+	free(sync_state.slots);
+	free(sync_state.dels);
+	free(sync_state.ops);
+	return ret ? 1 : 0;
+}
@@ -30,40 +30,9 @@ static int usage(void)
 static int modify_local(const struct xia_xid *dst,
 	struct local_u4id_info *lu4id_info, int to_add)
 {
-	struct {
-		struct nlmsghdr 	n;
-		struct rtmsg 		r;
-		char   			buf[1024];
-	} req;
-
-	memset(&req, 0, sizeof(req));
-
-	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
-
-	if (to_add) {
-		/* XXX Does one really needs all these flags? */
-		req.n.nlmsg_flags = NLM_F_REQUEST|NLM_F_CREATE|NLM_F_EXCL;
-		req.n.nlmsg_type = RTM_NEWROUTE;
-	} else {
-		req.n.nlmsg_flags = NLM_F_REQUEST;
-		req.n.nlmsg_type = RTM_DELROUTE;
-	}
-
-	req.r.rtm_family = AF_XIA;
-	req.r.rtm_table = XRTABLE_LOCAL_INDEX;
-	req.r.rtm_protocol = RTPROT_BOOT;
-	req.r.rtm_type = RTN_LOCAL;
-	req.r.rtm_scope = RT_SCOPE_HOST;
-
-	req.r.rtm_dst_len = sizeof(*dst);
-	addattr_l(&req.n, sizeof(req), RTA_DST, dst, sizeof(*dst));
-	if (to_add)
-		addattr_l(&req.n, sizeof(req), RTA_PROTOINFO,
-			lu4id_info, sizeof(*lu4id_info));
-
-	if (rtnl_talk(&rth, &req.n, 0, 0, NULL, NULL, NULL) < 0)
-		exit(2);
-	return 0;
+	/* Only additions carry the information. */
+	return xrt_modify_local(dst, lu4id_info,
+		to_add ? sizeof(*lu4id_info) : 0, to_add);
 }
 
 static int do_local(int argc, char **argv, int to_add)
@@ -167,16 +136,10 @@ static int do_del(int argc, char **argv)
 	return do_local(argc, argv, 0);
 }
 
-static struct
-{
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
-
 static inline void reset_filter(void)
 {
-	memset(&filter, 0, sizeof(filter));
-	assert(!ppal_name_to_type("u4id", &filter.xid_type));
+	memset(&xrt_filter, 0, sizeof(xrt_filter));
+	assert(!ppal_name_to_type("u4id", &xrt_filter.xid_type));
 }
 
 static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
@@ -220,52 +183,49 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "to ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("to ", "to", dst);
+	out_text("\n");
 
 	/* Print IP address and port representation. */
 	pxid = (__be32 *)dst->xid_id;
 	ip_addr = *pxid++;
 	ip_port = __be16_to_cpu(*(__be16 *)pxid);
-	if (inet_ntop(AF_INET, &ip_addr, ip_addr_str, INET_ADDRSTRLEN))
-		fprintf(fp, " using IP socket: %s:%d\n",ip_addr_str, ip_port);
+	if (inet_ntop(AF_INET, &ip_addr, ip_addr_str, INET_ADDRSTRLEN)) {
+		out_str(" using IP socket: ", "ip", ip_addr_str);
+		out_uint(":", "port", ip_port);
+		out_text("\n");
+	} else {
+		out_str(NULL, "ip", NULL);
+		out_str(NULL, "port", NULL);
+	}
 
 	lu4id_info = RTA_DATA(tb[RTA_PROTOINFO]);
-	fprintf(fp, " tunnel socket: %s%s\n",
-		lu4id_info->tunnel ? "yes" : "no",
-		lu4id_info->tunnel ? (lu4id_info->checksum_disabled ?
-		" (checksumming disabled)" : " (checksumming enabled)") : "");
+	out_str(" tunnel socket: ", "tunnel",
+		lu4id_info->tunnel ? "yes" : "no");
+	if (lu4id_info->tunnel)
+		out_text(lu4id_info->checksum_disabled ?
+			" (checksumming disabled)" : " (checksumming enabled)");
+	out_str(NULL, "checksum", lu4id_info->tunnel ?
+		(lu4id_info->checksum_disabled ? "disabled" : "enabled") :
+		NULL);
+	out_text("\n");
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, " flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags(" flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -273,16 +233,17 @@ static int print_route(const struct sockaddr_nl *who, struct nlmsghdr *n,
 static int dump(void)
 {
 	reset_filter();
-	filter.tb = XRTABLE_LOCAL_INDEX;
+	xrt_filter.tb = XRTABLE_LOCAL_INDEX;
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(xrt_filter.tb, xrt_filter.xid_type) < 0) {
 		perror("Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print_route, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print_route, stdout) < 0) {
 		fprintf(stderr, "Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
@@ -304,6 +265,12 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer u4id_printers[] = {
+	{ "u4id", XRTABLE_LOCAL_INDEX, "u4id locals", xrt_set_filter,
+		print_route },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "add",	do_add		},
 	{ "del",	do_del		},
@@ -22,15 +22,10 @@ static int usage(void)
 	return -1;
 }
 
-static struct {
-	__u32		tb;
-	xid_type_t	xid_type;
-} filter;
-
 static inline void reset_filter(__u32 tb_id)
 {
-	filter.tb = tb_id;
-	assert(!ppal_name_to_type("xdp", &filter.xid_type));
+	xrt_filter.tb = tb_id;
+	assert(!ppal_name_to_type("xdp", &xrt_filter.xid_type));
 }
 
 /* Based on iproute2/ip/iproute.c:iproute_list_flush_or_save. */
@@ -38,14 +33,15 @@ static int dump(__u32 tbl_id, rtnl_filter_t print)
 {
 	reset_filter(tbl_id);
 
-	if (rtnl_wilddump_request(&rth, AF_XIA, RTM_GETROUTE) < 0) {
+	if (xrt_dump_request(tbl_id, xrt_filter.xid_type) < 0) {
 		perror("XDP: Cannot send dump request");
 		exit(1);
 	}
-	if (rtnl_dump_filter(&rth, print, stdout, NULL, NULL) < 0) {
+	if (xip_dump_filter(print, stdout) < 0) {
 		fprintf(stderr, "XDP: Dump terminated\n");
 		exit(1);
 	}
+	out_flush();
 	return 0;
 }
 
@@ -85,47 +81,32 @@ static int print_socket(const struct sockaddr_nl *who, struct nlmsghdr *n,
 	table = rtnl_get_table(r, tb);
 
 	/* Filter happens here. */
-	if (filter.tb != table)
+	if (xrt_filter.tb != table)
 		return 0;
 	if (!tb[RTA_DST] ||
 		RTA_PAYLOAD(tb[RTA_DST]) != sizeof(struct xia_xid) ||
 		r->rtm_dst_len != sizeof(struct xia_xid))
 		return -1;
 	dst = (const struct xia_xid *)RTA_DATA(tb[RTA_DST]);
-	if (dst->xid_type != filter.xid_type)
+	if (dst->xid_type != xrt_filter.xid_type)
 		return 0;
 
-	if (n->nlmsg_type == RTM_DELROUTE)
-		fprintf(fp, "Deleted ");
-	fprintf(fp, "local ");
-	/* XXX It got to use @fp! */
-	print_xia_xid(dst);
-	fprintf(fp, "\n");
+	out_record_begin(fp, n->nlmsg_type == RTM_DELROUTE);
+	out_xid("local ", "local", dst);
+	out_text("\n");
 
-	if (tb[RTA_SRC]) {
-		printf("peer ");
+	if (tb[RTA_SRC])
 		assert(RTA_PAYLOAD(tb[RTA_SRC]) == sizeof(struct xia_addr));
-		/* XXX It got to use @fp! */
-		print_xia_addr((const struct xia_addr *)RTA_DATA(tb[RTA_SRC]));
-		fprintf(fp, "\n");
-	}
+	out_addr("peer ", "peer", tb[RTA_SRC] ?
+		(const struct xia_addr *)RTA_DATA(tb[RTA_SRC]) : NULL);
+	if (tb[RTA_SRC])
+		out_text("\n");
 
 	assert(!r->rtm_src_len);
 	assert(!(r->rtm_flags & RTM_F_CLONED));
 
-	fprintf(fp, "flags [");
-	if (r->rtm_flags & RTNH_F_DEAD)
-		fprintf(fp, "dead ");
-	if (r->rtm_flags & RTNH_F_ONLINK)
-		fprintf(fp, "onlink ");
-	if (r->rtm_flags & RTNH_F_PERVASIVE)
-		fprintf(fp, "pervasive ");
-	if (r->rtm_flags & RTM_F_NOTIFY)
-		fprintf(fp, "notify ");
-	fprintf(fp, "]");
-
-	fprintf(fp, "\n\n");
-	fflush(fp);
+	out_rtm_flags("flags [", r->rtm_flags);
+	out_record_end();
 	return 0;
 }
 
@@ -192,6 +173,14 @@ static int do_help(int argc, char **argv)
 	exit(1);
 }
 
+const struct xip_printer xdp_printers[] = {
+	{ "xdp", XRTABLE_LOCAL_INDEX, "xdp sockets", xrt_set_filter,
+		print_socket },
+	{ "xdp", XRTABLE_MAIN_INDEX, "xdp routes", xrt_set_filter,
+		xrt_print_route },
+	{ NULL }
+};
+
 static const struct cmd cmds[] = {
 	{ "showsockets",	do_showsockets	},
 	{ "addroute",		do_addroute	},